@@ -216,6 +216,7 @@ char* StrPair::ParseText( char* p, const char* endTag, int strFlags, int* curLin
     size_t length = strlen( endTag );
 
     // Inner loop of text parsing.
+    p = OPMLUtil::SkipWordsWithout( p, endChar, '\n' );
     while ( *p ) {
         if ( *p == endChar && strncmp( p, endTag, length ) == 0 ) {
             Set( start, p, strFlags );
@@ -224,6 +225,7 @@ char* StrPair::ParseText( char* p, const char* endTag, int strFlags, int* curLin
             ++(*curLineNumPtr);
         }
         ++p;
+        p = OPMLUtil::SkipWordsWithout( p, endChar, '\n' );
         TIOPMLASSERT( p );
     }
     return 0;
@@ -564,6 +566,110 @@ const char* OPMLUtil::GetCharacterRef( const char* p, char* value, int* length )
 }
 
 
+const char* OPMLUtil::FindAnyOf( const char* p, const char* end, char a, char b, char c )
+{
+#if TINYOPML2_SWAR
+    while ( p < end && !SwarAligned( p ) ) {
+        if ( *p == a || *p == b || *p == c ) {
+            return p;
+        }
+        ++p;
+    }
+    const SwarWord wa = SwarBroadcast( a );
+    const SwarWord wb = SwarBroadcast( b );
+    const SwarWord wc = SwarBroadcast( c );
+    while ( end - p >= static_cast<ptrdiff_t>( sizeof( SwarWord ) ) ) {
+        const SwarWord v = *reinterpret_cast<const SwarWord*>( p );
+        if ( SwarHasZero( v ^ wa ) | SwarHasZero( v ^ wb ) | SwarHasZero( v ^ wc ) ) {
+            break;
+        }
+        p += sizeof( SwarWord );
+    }
+#endif
+    while ( p < end ) {
+        if ( *p == a || *p == b || *p == c ) {
+            return p;
+        }
+        ++p;
+    }
+    return end;
+}
+
+
+#if TINYOPML2_SWAR
+TIOPML_NO_SANITIZE_ADDRESS
+#endif
+char* OPMLUtil::SkipWordsWithout( char* p, char a, char b )
+{
+#if TINYOPML2_SWAR
+    if ( SwarAligned( p ) ) {
+        const SwarWord wa = SwarBroadcast( a );
+        const SwarWord wb = SwarBroadcast( b );
+        for( ;; ) {
+            const SwarWord v = *reinterpret_cast<const SwarWord*>( p );
+            if ( SwarHasZero( v ) | SwarHasZero( v ^ wa ) | SwarHasZero( v ^ wb ) ) {
+                break;
+            }
+            p += sizeof( SwarWord );
+        }
+    }
+#else
+    (void)a;
+    (void)b;
+#endif
+    return p;
+}
+
+
+static const char* const attributeNames[OPML_ATTR_COUNT] = {
+    "",
+    "type",
+    "text",
+    "URL",
+    "guide_id",
+    "key",
+    "bitrate",
+    "reliability",
+    "formats",
+    "subtext",
+    "image",
+    "item",
+    "now_playing_id",
+    "preset_id",
+    "genre_id"
+};
+
+
+OPMLAttributeId OPMLUtil::AttributeId( const char* name )
+{
+    TIOPMLASSERT( name );
+    // the first two characters leave a single candidate, one compare decides
+    OPMLAttributeId id;
+    switch ( *name ) {
+        case 't':   id = name[1] == 'y' ? OPML_ATTR_TYPE : OPML_ATTR_TEXT;          break;
+        case 'U':   id = OPML_ATTR_URL;                                             break;
+        case 'g':   id = name[1] == 'u' ? OPML_ATTR_GUIDE_ID : OPML_ATTR_GENRE_ID;  break;
+        case 'k':   id = OPML_ATTR_KEY;                                             break;
+        case 'b':   id = OPML_ATTR_BITRATE;                                         break;
+        case 'r':   id = OPML_ATTR_RELIABILITY;                                     break;
+        case 'f':   id = OPML_ATTR_FORMATS;                                         break;
+        case 's':   id = OPML_ATTR_SUBTEXT;                                         break;
+        case 'i':   id = name[1] == 'm' ? OPML_ATTR_IMAGE : OPML_ATTR_ITEM;         break;
+        case 'n':   id = OPML_ATTR_NOW_PLAYING_ID;                                  break;
+        case 'p':   id = OPML_ATTR_PRESET_ID;                                       break;
+        default:    return OPML_ATTR_UNKNOWN;
+    }
+    return StringEqual( attributeNames[id], name ) ? id : OPML_ATTR_UNKNOWN;
+}
+
+
+const char* OPMLUtil::AttributeName( OPMLAttributeId id )
+{
+    TIOPMLASSERT( id >= 0 && id < OPML_ATTR_COUNT );
+    return attributeNames[id];
+}
+
+
 void OPMLUtil::ToStr( int v, char* buffer, int bufferSize )
 {
     TIOPML_SNPRINTF( buffer, bufferSize, "%d", v );
@@ -1066,6 +1172,17 @@ char* OPMLNode::ParseDeep( char* p, StrPair* parentEndTag, int* curLineNumPtr )
 	while( p && *p ) {
         OPMLNode* node = 0;
 
+        if ( _document->_filter ) {
+            p = _document->SkipFiltered( p );
+            if ( !p ) {
+                _document->SetError( OPML_ERROR_PARSING, _document->_parseCurLineNum, 0 );
+                break;
+            }
+            if ( !*p ) {
+                break;
+            }
+        }
+
         p = _document->Identify( p, &node );
         TIOPMLASSERT( p );
         if ( node == 0 ) {
@@ -1439,6 +1556,7 @@ char* OPMLAttribute::ParseDeep( char* p, bool processEntities, int* curLineNumPt
 void OPMLAttribute::SetName( const char* n )
 {
     _name.SetStr( n );
+    _id = static_cast<uint8_t>( OPMLUtil::AttributeId( n ) );
 }
 
 
@@ -1584,8 +1702,27 @@ OPMLElement::~OPMLElement()
 
 const OPMLAttribute* OPMLElement::FindAttribute( const char* name ) const
 {
+    const OPMLAttributeId id = OPMLUtil::AttributeId( name );
+    if ( id != OPML_ATTR_UNKNOWN ) {
+        return FindAttribute( id );
+    }
+    for( OPMLAttribute* a = _rootAttribute; a; a = a->_next ) {
+        if ( a->_id == OPML_ATTR_UNKNOWN && OPMLUtil::StringEqual( a->Name(), name ) ) {
+            return a;
+        }
+    }
+    return 0;
+}
+
+
+const OPMLAttribute* OPMLElement::FindAttribute( OPMLAttributeId id ) const
+{
+    if ( id <= OPML_ATTR_UNKNOWN || id >= OPML_ATTR_COUNT ) {
+        return 0;
+    }
+    // A byte compare per attribute, no string is touched.
     for( OPMLAttribute* a = _rootAttribute; a; a = a->_next ) {
-        if ( OPMLUtil::StringEqual( a->Name(), name ) ) {
+        if ( a->_id == id ) {
             return a;
         }
     }
@@ -1593,6 +1730,13 @@ const OPMLAttribute* OPMLElement::FindAttribute( const char* name ) const
 }
 
 
+const char* OPMLElement::Attribute( OPMLAttributeId id ) const
+{
+    const OPMLAttribute* a = FindAttribute( id );
+    return a ? a->Value() : 0;
+}
+
+
 const char* OPMLElement::Attribute( const char* name, const char* value ) const
 {
     const OPMLAttribute* a = FindAttribute( name );
@@ -1946,11 +2090,18 @@ char* OPMLElement::ParseAttributes( char* p, int* curLineNumPtr )
             const int attrLineNum = attrib->_parseLineNum;
 
             p = attrib->ParseDeep( p, _document->ProcessEntities(), curLineNumPtr );
-            if ( !p || Attribute( attrib->Name() ) ) {
+            if ( p ) {
+                attrib->_id = static_cast<uint8_t>( OPMLUtil::AttributeId( attrib->Name() ) );
+            }
+            if ( !p || ( attrib->_id != OPML_ATTR_UNKNOWN ? FindAttribute( attrib->Id() ) : FindAttribute( attrib->Name() ) ) ) {
                 DeleteAttribute( attrib );
                 _document->SetError( OPML_ERROR_PARSING_ATTRIBUTE, attrLineNum, "OPMLElement name=%s", Name() );
                 return 0;
             }
+            if ( _document->_filter && !_document->_filter->AttributeAllowed( attrib->Id() ) ) {
+                DeleteAttribute( attrib );
+                continue;
+            }
             // There is a minor bug here: if the attribute in the source opml
             // document is duplicated, it will not be detected and the
             // attribute will be doubly added. However, tracking the 'prevAttribute'
@@ -2059,12 +2210,18 @@ char* OPMLElement::ParseDeep( char* p, StrPair* parentEndTag, int* curLineNumPtr
         return 0;
     }
 
+    // SkipFiltered() matched this element just before it was created
+    const int filterNode = _document->_matchedFilterNode;
+
     p = ParseAttributes( p, curLineNumPtr );
     if ( !p || !*p || _closingType != OPEN ) {
         return p;
     }
 
+    const int parentFilterNode = _document->_filterNode;
+    _document->_filterNode = filterNode;
     p = OPMLNode::ParseDeep( p, parentEndTag, curLineNumPtr );
+    _document->_filterNode = parentFilterNode;
     return p;
 }
 
@@ -2149,7 +2306,52 @@ const char* OPMLDocument::_errorNames[OPML_ERROR_COUNT] = {
 };
 
 
-OPMLDocument::OPMLDocument( bool processEntities, Whitespace whitespaceMode ) :
+bool OPMLFilter::AddPath( const char* path )
+{
+    TIOPMLASSERT( path );
+    int parent = ROOT;
+    while ( *path ) {
+        const char* end = strchr( path, '/' );
+        const size_t len = end ? static_cast<size_t>( end - path ) : strlen( path );
+        if ( len == 0 || len >= MAX_NAME ) {
+            return false;
+        }
+        int node = Match( parent, path, len );
+        if ( node == NONE ) {
+            if ( _count == MAX_NODES ) {
+                return false;
+            }
+            node = _count++;
+            memcpy( _nodes[node].name, path, len );
+            _nodes[node].name[len] = 0;
+            _nodes[node].len = static_cast<uint8_t>( len );
+            _nodes[node].parent = static_cast<int8_t>( parent );
+        }
+        parent = node;
+        path += end ? len + 1 : len;
+    }
+    return parent != ROOT;
+}
+
+
+int OPMLFilter::Match( int parent, const char* name, size_t len ) const
+{
+    for( int i = 0; i < _count; ++i ) {
+        if ( _nodes[i].parent == parent && _nodes[i].len == len && memcmp( _nodes[i].name, name, len ) == 0 ) {
+            return i;
+        }
+    }
+    return NONE;
+}
+
+
+static void DeleteCharBuffer( char* buffer )
+{
+    delete [] buffer;
+}
+
+
+OPMLDocument::OPMLDocument( bool processEntities, Whitespace whitespaceMode, OPMLArena* arena ) :
     OPMLNode( 0 ),
     _writeBOM( false ),
     _processEntities( processEntities ),
@@ -2158,6 +2360,11 @@ OPMLDocument::OPMLDocument( bool processEntities, Whitespace whitespaceMode ) :
     _errorStr(),
     _errorLineNum( 0 ),
     _charBuffer( 0 ),
+    _charBufferDeleter( 0 ),
+    _arena( arena ),
+    _filter( 0 ),
+    _filterNode( OPMLFilter::ROOT ),
+    _matchedFilterNode( OPMLFilter::ROOT ),
     _parseCurLineNum( 0 ),
 	_parsingDepth(0),
     _unlinked(),
@@ -2168,6 +2375,10 @@ OPMLDocument::OPMLDocument( bool processEntities, Whitespace whitespaceMode ) :
 {
     // avoid VC++ C4355 warning about 'this' in initializer list (C4355 is off by default in VS2012+)
     _document = this;
+    _elementPool.SetArena( arena );
+    _attributePool.SetArena( arena );
+    _textPool.SetArena( arena );
+    _commentPool.SetArena( arena );
 }
 
 
@@ -2202,8 +2413,11 @@ void OPMLDocument::Clear()
 #endif
     ClearError();
 
-    delete [] _charBuffer;
+    if ( _charBufferDeleter ) {
+        _charBufferDeleter( _charBuffer );
+    }
     _charBuffer = 0;
+    _charBufferDeleter = 0;
 	_parsingDepth = 0;
 
 #if 0
@@ -2221,6 +2435,15 @@ void OPMLDocument::Clear()
         TIOPMLASSERT( _commentPool.CurrentAllocs()   == _commentPool.Untracked() );
     }
 #endif
+
+    if ( _arena ) {
+        // every node is gone, drop the free lists into the arena along with it
+        _elementPool.Clear();
+        _attributePool.Clear();
+        _textPool.Clear();
+        _commentPool.Clear();
+        _arena->Reset();
+    }
 }
 
 
@@ -2370,6 +2593,7 @@ OPMLError OPMLDocument::LoadFile( FILE* fp )
     const size_t size = static_cast<size_t>(filelength);
     TIOPMLASSERT( _charBuffer == 0 );
     _charBuffer = new char[size+1];
+    _charBufferDeleter = DeleteCharBuffer;
     const size_t read = fread( _charBuffer, 1, size, fp );
     if ( read != size ) {
         SetError( OPML_ERROR_FILE_READ_ERROR, 0, 0 );
@@ -2426,24 +2650,161 @@ OPMLError OPMLDocument::Parse( const char* p, size_t len )
     }
     TIOPMLASSERT( _charBuffer == 0 );
     _charBuffer = new char[ len+1 ];
+    _charBufferDeleter = DeleteCharBuffer;
     memcpy( _charBuffer, p, len );
     _charBuffer[len] = 0;
 
     Parse();
     if ( Error() ) {
-        // clean up now essentially dangling memory.
-        // and the parse fail can put objects in the
-        // pools that are dead and inaccessible.
-        DeleteChildren();
-        _elementPool.Clear();
-        _attributePool.Clear();
-        _textPool.Clear();
-        _commentPool.Clear();
+        DiscardParsedNodes();
     }
     return _errorID;
 }
 
 
+OPMLError OPMLDocument::ParseInPlace( char* p, size_t len, OPMLBufferDeleter deleter )
+{
+    Clear();
+
+    TIOPMLASSERT( _charBuffer == 0 );
+    _charBuffer = p;
+    _charBufferDeleter = p ? deleter : 0;
+
+    if ( len == 0 || !p || !*p ) {
+        SetError( OPML_ERROR_EMPTY_DOCUMENT, 0, 0 );
+        return _errorID;
+    }
+    _charBuffer[len] = 0;
+
+    Parse();
+    if ( Error() ) {
+        DiscardParsedNodes();
+    }
+    return _errorID;
+}
+
+
+char* OPMLDocument::SkipFiltered( char* p )
+{
+    for( ;; ) {
+        // leading whitespace belongs to a text node, unless markup follows
+        char* q = OPMLUtil::SkipWhiteSpace( p, 0 );
+        if ( *q != '<' || q[1] == '/' || q[1] == '?' ) {
+            return p;
+        }
+
+        char* end = 0;
+        if ( OPMLUtil::StringEqual( q, "<!--", 4 ) ) {
+            end = strstr( q + 4, "-->" );
+            if ( end ) {
+                end += 3;
+            }
+        }
+        else if ( q[1] == '!' ) {
+            return p;
+        }
+        else {
+            char* name = q + 1;
+            char* nameEnd = name;
+            while ( *nameEnd && OPMLUtil::IsNameChar( (unsigned char) *nameEnd ) ) {
+                ++nameEnd;
+            }
+            const int match = _filter->Match( _filterNode, name, nameEnd - name );
+            if ( match != OPMLFilter::NONE ) {
+                _matchedFilterNode = match;
+                return p;
+            }
+            end = SkipElement( q );
+        }
+        if ( !end ) {
+            return 0;
+        }
+        for( ; p < end; ++p ) {
+            if ( *p == '\n' ) {
+                ++_parseCurLineNum;
+            }
+        }
+    }
+}
+
+
+/*
+	Steps over the element starting at p and all of its content, following
+	only the nesting of tags. Returns the first character after it, or null
+	if the document ends first.
+*/
+char* OPMLDocument::SkipElement( char* p )
+{
+    int depth = 0;
+    while ( *p ) {
+        if ( *p != '<' ) {
+            ++p;
+            continue;
+        }
+        const char* close = ">";
+        if ( OPMLUtil::StringEqual( p, "<!--", 4 ) ) {
+            close = "-->";
+        }
+        else if ( OPMLUtil::StringEqual( p, "<![CDATA[", 9 ) ) {
+            close = "]]>";
+        }
+        if ( p[1] == '!' || p[1] == '?' ) {
+            p = strstr( p + 2, close );
+            if ( !p ) {
+                return 0;
+            }
+            p += strlen( close );
+            continue;
+        }
+
+        // a tag, attribute values may contain '>'
+        const bool closing = p[1] == '/';
+        char quote = 0;
+        char* q = p + 1;
+        for( ; *q; ++q ) {
+            if ( quote ) {
+                if ( *q == quote ) {
+                    quote = 0;
+                }
+            }
+            else if ( *q == '\"' || *q == '\'' ) {
+                quote = *q;
+            }
+            else if ( *q == '>' ) {
+                break;
+            }
+        }
+        if ( !*q ) {
+            return 0;
+        }
+        if ( closing ) {
+            --depth;
+        }
+        else if ( q[-1] != '/' ) {
+            ++depth;
+        }
+        p = q + 1;
+        if ( depth <= 0 ) {
+            return p;
+        }
+    }
+    return 0;
+}
+
+
+void OPMLDocument::DiscardParsedNodes()
+{
+    // clean up now essentially dangling memory.
+    // and the parse fail can put objects in the
+    // pools that are dead and inaccessible.
+    DeleteChildren();
+    _elementPool.Clear();
+    _attributePool.Clear();
+    _textPool.Clear();
+    _commentPool.Clear();
+}
+
+
 void OPMLDocument::Print( OPMLPrinter* streamer ) const
 {
     if ( streamer ) {
@@ -2521,6 +2882,7 @@ void OPMLDocument::Parse()
     TIOPMLASSERT( _charBuffer );
     _parseCurLineNum = 1;
     _parseLineNum = 1;
+    _filterNode = OPMLFilter::ROOT;
     char* p = _charBuffer;
     p = OPMLUtil::SkipWhiteSpace( p, &_parseCurLineNum );
     p = const_cast<char*>( OPMLUtil::ReadBOM( p, &_writeBOM ) );
@@ -2984,4 +3346,328 @@ bool OPMLPrinter::Visit( const OPMLUnknown& unknown )
     return true;
 }
 
+
+// --------- OPMLStreamParser ----------- //
+
+OPMLStreamParser::OPMLStreamParser( OPMLStreamHandler* handler, bool processEntities ) :
+    _handler( handler ),
+    _processEntities( processEntities ),
+    _state( TEXT ),
+    _quote( 0 ),
+    _stopped( false ),
+    _seenElement( false ),
+    _errorID( OPML_SUCCESS ),
+    _bytesFed( 0 ),
+    _tag(),
+    _names(),
+    _nameStarts(),
+    _spans(),
+    _attributes()
+{
+    TIOPMLASSERT( handler );
+    _tail[0] = _tail[1] = 0;
+}
+
+
+void OPMLStreamParser::Reset()
+{
+    _state = TEXT;
+    _quote = 0;
+    _tail[0] = _tail[1] = 0;
+    _stopped = false;
+    _seenElement = false;
+    _errorID = OPML_SUCCESS;
+    _bytesFed = 0;
+    _tag.Clear();
+    _names.Clear();
+    _nameStarts.Clear();
+    _spans.Clear();
+    _attributes.Clear();
+}
+
+
+OPMLError OPMLStreamParser::SetError( OPMLError error )
+{
+    TIOPMLASSERT( error > OPML_SUCCESS && error < OPML_ERROR_COUNT );
+    _errorID = error;
+    return _errorID;
+}
+
+
+OPMLError OPMLStreamParser::Feed( const char* data, size_t len )
+{
+    if ( _errorID != OPML_SUCCESS || _stopped ) {
+        return _errorID;
+    }
+    TIOPMLASSERT( data || len == 0 );
+    _bytesFed += len;
+
+    const char* p = data;
+    const char* const end = data + len;
+
+    while ( p < end && !_stopped ) {
+        switch ( _state ) {
+        case TEXT: {
+            // Text content is of no interest in OPML; jump to the next tag.
+            const char* lt = static_cast<const char*>( memchr( p, '<', end - p ) );
+            if ( !lt ) {
+                p = end;
+                break;
+            }
+            p = lt + 1;
+            _tag.Clear();
+            _state = MARKUP;
+            break;
+        }
+        case MARKUP:
+            if ( *p == '?' ) {
+                ++p;
+                _tail[0] = _tail[1] = 0;
+                _state = DECLARATION;
+            }
+            else if ( *p == '!' ) {
+                ++p;
+                _tag.Push( '!' );
+                _state = BANG;
+            }
+            else {
+                _quote = 0;
+                _state = TAG;
+            }
+            break;
+
+        case TAG: {
+            const char* q = p;
+            while ( q < end ) {
+                if ( _quote ) {
+                    const char* close = static_cast<const char*>( memchr( q, _quote, end - q ) );
+                    if ( !close ) {
+                        q = end;
+                        break;
+                    }
+                    _quote = 0;
+                    q = close + 1;
+                    continue;
+                }
+                q = OPMLUtil::FindAnyOf( q, end, '>', '\"', '\'' );
+                if ( q == end || *q == '>' ) {
+                    break;
+                }
+                _quote = *q++;
+            }
+            const int n = static_cast<int>( q - p );
+            if ( _tag.Size() + n > MAX_TAG_SIZE ) {
+                return SetError( OPML_ERROR_PARSING_ELEMENT );
+            }
+            memcpy( _tag.PushArr( n ), p, n );
+            if ( q == end ) {
+                p = end;
+                break;
+            }
+            p = q + 1;
+            _state = TEXT;
+            if ( DispatchTag() != OPML_SUCCESS ) {
+                return _errorID;
+            }
+            break;
+        }
+        case BANG: {
+            // These strings define the matching patterns, see OPMLDocument::Identify()
+            static const char* commentHeader	= { "!--" };
+            static const char* cdataHeader		= { "![CDATA[" };
+            static const int commentHeaderLen	= 3;
+            static const int cdataHeaderLen		= 8;
+
+            const char c = *p++;
+            if ( c == '>' ) {
+                _state = TEXT;
+                break;
+            }
+            _tag.Push( c );
+            const int n = _tag.Size();
+            const bool maybeComment = n <= commentHeaderLen && strncmp( _tag.Mem(), commentHeader, n ) == 0;
+            const bool maybeCData = n <= cdataHeaderLen && strncmp( _tag.Mem(), cdataHeader, n ) == 0;
+            _tail[0] = _tail[1] = 0;
+            if ( maybeComment && n == commentHeaderLen ) {
+                _state = COMMENT;
+            }
+            else if ( maybeCData && n == cdataHeaderLen ) {
+                _state = CDATA;
+            }
+            else if ( !maybeComment && !maybeCData ) {
+                _state = DTD;
+            }
+            break;
+        }
+        case COMMENT:
+        case CDATA:
+        case DECLARATION:
+        case DTD: {
+            const char c = *p++;
+            bool done = false;
+            if ( c == '>' ) {
+                switch ( _state ) {
+                case COMMENT:       done = _tail[0] == '-' && _tail[1] == '-'; break;
+                case CDATA:         done = _tail[0] == ']' && _tail[1] == ']'; break;
+                case DECLARATION:   done = _tail[1] == '?'; break;
+                default:            done = true; break;
+                }
+            }
+            if ( done ) {
+                _state = TEXT;
+            }
+            else {
+                _tail[0] = _tail[1];
+                _tail[1] = c;
+            }
+            break;
+        }
+        }
+    }
+    return _errorID;
+}
+
+
+OPMLError OPMLStreamParser::Finish()
+{
+    if ( _errorID != OPML_SUCCESS || _stopped ) {
+        return _errorID;
+    }
+    switch ( _state ) {
+    case TEXT:          break;
+    case MARKUP:
+    case TAG:           return SetError( OPML_ERROR_PARSING_ELEMENT );
+    case BANG:
+    case COMMENT:       return SetError( OPML_ERROR_PARSING_COMMENT );
+    case CDATA:         return SetError( OPML_ERROR_PARSING_CDATA );
+    case DECLARATION:   return SetError( OPML_ERROR_PARSING_DECLARATION );
+    case DTD:           return SetError( OPML_ERROR_PARSING_UNKNOWN );
+    }
+    if ( !_seenElement ) {
+        return SetError( OPML_ERROR_EMPTY_DOCUMENT );
+    }
+    if ( !_nameStarts.Empty() ) {
+        return SetError( OPML_ERROR_PARSING_ELEMENT );
+    }
+    return _errorID;
+}
+
+
+//
+// Called with the bytes between '<' and '>' of an element tag in _tag.
+// All strings are terminated and entity processed in place, then handed
+// to the handler; _tag is reused for the next tag afterwards.
+//
+OPMLError OPMLStreamParser::DispatchTag()
+{
+    _tag.Push( 0 );
+    char* p = OPMLUtil::SkipWhiteSpace( _tag.Mem(), 0 );
+
+    if ( *p == '/' ) {
+        StrPair name;
+        p = name.ParseName( p + 1 );
+        if ( !p || *OPMLUtil::SkipWhiteSpace( p, 0 ) ) {
+            return SetError( OPML_ERROR_PARSING_ELEMENT );
+        }
+        if ( _nameStarts.Empty() ) {
+            return SetError( OPML_ERROR_MISMATCHED_ELEMENT );
+        }
+        const char* closing = name.GetStr();
+        const int start = _nameStarts.Pop();
+        if ( !OPMLUtil::StringEqual( &_names[start], closing ) ) {
+            return SetError( OPML_ERROR_MISMATCHED_ELEMENT );
+        }
+        _names.PopArr( _names.Size() - start );
+        if ( !_handler->EndElement( closing, _nameStarts.Size() ) ) {
+            _stopped = true;
+        }
+        return OPML_SUCCESS;
+    }
+
+    StrPair name;
+    p = name.ParseName( p );
+    if ( !p ) {
+        return SetError( OPML_ERROR_PARSING_ELEMENT );
+    }
+    // Scan the whole tag before terminating any string: terminating writes
+    // over the character that follows it.
+    bool closed = false;
+    _spans.Clear();
+
+    for( ;; ) {
+        p = OPMLUtil::SkipWhiteSpace( p, 0 );
+        if ( !*p ) {
+            break;
+        }
+        if ( OPMLUtil::IsNameStartChar( (unsigned char) *p ) ) {
+            Span attrName = { p, 0 };
+            while ( *p && OPMLUtil::IsNameChar( (unsigned char) *p ) ) {
+                ++p;
+            }
+            attrName.end = p;
+            p = OPMLUtil::SkipWhiteSpace( p, 0 );
+            if ( *p != '=' ) {
+                return SetError( OPML_ERROR_PARSING_ATTRIBUTE );
+            }
+            p = OPMLUtil::SkipWhiteSpace( p + 1, 0 );
+            if ( *p != '\"' && *p != '\'' ) {
+                return SetError( OPML_ERROR_PARSING_ATTRIBUTE );
+            }
+            Span attrValue = { p + 1, strchr( p + 1, *p ) };
+            if ( !attrValue.end ) {
+                return SetError( OPML_ERROR_PARSING_ATTRIBUTE );
+            }
+            p = attrValue.end + 1;
+            _spans.Push( attrName );
+            _spans.Push( attrValue );
+        }
+        else if ( *p == '/' && *(p+1) == 0 ) {
+            closed = true;
+            break;
+        }
+        else {
+            return SetError( OPML_ERROR_PARSING_ELEMENT );
+        }
+    }
+
+    const char* elementName = name.GetStr();
+    const int valueFlags = _processEntities ? StrPair::ATTRIBUTE_VALUE : StrPair::ATTRIBUTE_VALUE_LEAVE_ENTITIES;
+    _attributes.Clear();
+    for( int i = 0; i < _spans.Size(); i += 2 ) {
+        StrPair attrName, attrValue;
+        attrName.Set( _spans[i].start, _spans[i].end, StrPair::ATTRIBUTE_NAME );
+        attrValue.Set( _spans[i+1].start, _spans[i+1].end, valueFlags );
+        const char* n = attrName.GetStr();
+        const OPMLStreamAttribute attribute = { n, attrValue.GetStr(), OPMLUtil::AttributeId( n ) };
+        for( int j = 0; j < _attributes.Size(); ++j ) {
+            if ( OPMLUtil::StringEqual( _attributes[j].name, attribute.name ) ) {
+                return SetError( OPML_ERROR_PARSING_ATTRIBUTE );
+            }
+        }
+        _attributes.Push( attribute );
+    }
+
+    const int depth = _nameStarts.Size();
+    if ( depth >= TINYOPML2_MAX_ELEMENT_DEPTH ) {
+        return SetError( OPML_ELEMENT_DEPTH_EXCEEDED );
+    }
+    _seenElement = true;
+
+    if ( !_handler->StartElement( elementName, _attributes.Mem(), _attributes.Size(), depth ) ) {
+        _stopped = true;
+        return OPML_SUCCESS;
+    }
+    if ( closed ) {
+        if ( !_handler->EndElement( elementName, depth ) ) {
+            _stopped = true;
+        }
+        return OPML_SUCCESS;
+    }
+
+    const int len = static_cast<int>( strlen( elementName ) ) + 1;
+    _nameStarts.Push( _names.Size() );
+    memcpy( _names.PushArr( len ), elementName, len );
+    return OPML_SUCCESS;
+}
+
 }   // namespace tinyopml
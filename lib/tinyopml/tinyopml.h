@@ -107,6 +107,23 @@ static const int TIOPML2_PATCH_VERSION = 0;
 // so there needs to be a limit in place.
 static const int TINYOPML2_MAX_ELEMENT_DEPTH = 100;
 
+// Scan text a machine word at a time (4 bytes on Xtensa, 8 on x86-64)
+// when looking for delimiters. Needs the GCC/Clang may_alias attribute.
+// Off unless asked for: Browse pages are dense with tags, the runs between
+// delimiters are short, and on the corpus the byte loops were faster.
+#if !defined(TINYOPML2_SWAR)
+#   define TINYOPML2_SWAR 0
+#elif TINYOPML2_SWAR && !defined(__GNUC__)
+#   error "TINYOPML2_SWAR needs GCC or Clang"
+#endif
+
+#if TINYOPML2_SWAR
+// Aligned word loads may look at the bytes following the null terminator
+// of a string. They stay within its word, so never cross a page boundary,
+// but address sanitizers flag them.
+#   define TIOPML_NO_SANITIZE_ADDRESS __attribute__((no_sanitize_address))
+#endif
+
 namespace tinyopml
 {
 class OPMLDocument;
@@ -316,6 +333,58 @@ private:
 };
 
 
+/*
+	A caller supplied chunk of memory (static, PSRAM...) handed out by
+	bumping a pointer. Nothing is freed individually, Reset() releases
+	everything at once. Used by the pools of an OPMLDocument, one document
+	at a time.
+*/
+class OPMLArena
+{
+public:
+    OPMLArena( void* buffer, size_t size ) : _mem( static_cast<char*>( buffer ) ), _size( size ), _used( 0 ), _peak( 0 ) {}
+
+    // Returns 0 once the arena is exhausted.
+    void* Alloc( size_t size ) {
+        // keep every allocation aligned for the largest scalar type
+        const uintptr_t start = ( reinterpret_cast<uintptr_t>( _mem + _used ) + ( ALIGN - 1 ) ) & ~static_cast<uintptr_t>( ALIGN - 1 );
+        const size_t offset = start - reinterpret_cast<uintptr_t>( _mem );
+        if ( offset > _size || size > _size - offset ) {
+            return 0;
+        }
+        _used = offset + size;
+        if ( _used > _peak ) {
+            _peak = _used;
+        }
+        return _mem + offset;
+    }
+    void Reset() {
+        _used = 0;
+    }
+
+    size_t Size() const {
+        return _size;
+    }
+    size_t Used() const {
+        return _used;
+    }
+    size_t Peak() const {
+        return _peak;
+    }
+
+private:
+    OPMLArena( const OPMLArena& ); // not supported
+    void operator=( const OPMLArena& ); // not supported
+
+    enum { ALIGN = 8 };
+
+    char*  _mem;
+    size_t _size;
+    size_t _used;
+    size_t _peak;
+};
+
+
 /*
 	Parent virtual class of a pool for fast allocation
 	and deallocation of objects.
@@ -340,7 +409,7 @@ template< int ITEM_SIZE >
 class MemPoolT : public MemPool
 {
 public:
-    MemPoolT() : _blockPtrs(), _root(0), _currentAllocs(0), _nAllocs(0), _maxAllocs(0), _nUntracked(0)	{}
+    MemPoolT() : _blockPtrs(), _root(0), _arena(0), _currentAllocs(0), _nAllocs(0), _maxAllocs(0), _nUntracked(0)	{}
     ~MemPoolT() {
         MemPoolT< ITEM_SIZE >::Clear();
     }
@@ -365,7 +434,21 @@ public:
         return _currentAllocs;
     }
 
+    // Carve new items out of 'arena' rather than heap blocks, falling back
+    // to the heap when it is exhausted. Clear() must be called before the
+    // arena is reset.
+    void SetArena( OPMLArena* arena ) {
+        _arena = arena;
+    }
+
     virtual void* Alloc() {
+        if ( !_root && _arena ) {
+            Item* item = static_cast<Item*>( _arena->Alloc( sizeof( Item ) ) );
+            if ( item ) {
+                item->next = 0;
+                _root = item;
+            }
+        }
         if ( !_root ) {
             // Need a new block.
             Block* block = new Block();
@@ -443,6 +526,7 @@ private:
     };
     DynArray< Block*, 10 > _blockPtrs;
     Item* _root;
+    OPMLArena* _arena;
 
     int _currentAllocs;
     int _nAllocs;
@@ -538,6 +622,31 @@ enum OPMLError {
 };
 
 
+/*
+	Well-known OPML and TuneIn outline attribute names. They are interned
+	when an attribute is parsed, so looking one up is an integer compare.
+*/
+enum OPMLAttributeId {
+    OPML_ATTR_UNKNOWN = 0,
+    OPML_ATTR_TYPE,
+    OPML_ATTR_TEXT,
+    OPML_ATTR_URL,
+    OPML_ATTR_GUIDE_ID,
+    OPML_ATTR_KEY,
+    OPML_ATTR_BITRATE,
+    OPML_ATTR_RELIABILITY,
+    OPML_ATTR_FORMATS,
+    OPML_ATTR_SUBTEXT,
+    OPML_ATTR_IMAGE,
+    OPML_ATTR_ITEM,
+    OPML_ATTR_NOW_PLAYING_ID,
+    OPML_ATTR_PRESET_ID,
+    OPML_ATTR_GENRE_ID,
+
+	OPML_ATTR_COUNT
+};
+
+
 /*
 	Utility functionality.
 */
@@ -552,6 +661,10 @@ public:
                 ++(*curLineNumPtr);
             }
             ++p;
+#if TINYOPML2_SWAR
+            // indentation
+            p = SkipSpaceWords( p );
+#endif
         }
         TIOPMLASSERT( p );
         return p;
@@ -603,7 +716,41 @@ public:
         return ( p & 0x80 ) != 0;
     }
 
+    // First of [p, end) that is a, b or c, end if there is none.
+    static const char* FindAnyOf( const char* p, const char* end, char a, char b, char c );
+    // Skips the aligned words of p holding none of a, b or the terminator,
+    // p is returned as is if it isn't word aligned.
+    static char* SkipWordsWithout( char* p, char a, char b );
+
+#if TINYOPML2_SWAR
+    typedef uintptr_t __attribute__((__may_alias__)) SwarWord;
+
+    static SwarWord SwarBroadcast( unsigned char c ) {
+        return ( ~static_cast<SwarWord>( 0 ) / 0xff ) * c;
+    }
+    // Non zero if any byte of v is zero.
+    static SwarWord SwarHasZero( SwarWord v ) {
+        return ( v - SwarBroadcast( 0x01 ) ) & ~v & SwarBroadcast( 0x80 );
+    }
+    static bool SwarAligned( const void* p ) {
+        return ( reinterpret_cast<uintptr_t>( p ) & ( sizeof( SwarWord ) - 1 ) ) == 0;
+    }
+    TIOPML_NO_SANITIZE_ADDRESS static const char* SkipSpaceWords( const char* p ) {
+        if ( SwarAligned( p ) ) {
+            while ( *reinterpret_cast<const SwarWord*>( p ) == SwarBroadcast( ' ' ) ) {
+                p += sizeof( SwarWord );
+            }
+        }
+        return p;
+    }
+#endif
+
     static const char* ReadBOM( const char* p, bool* hasBOM );
+
+    // interns a well-known attribute name, OPML_ATTR_UNKNOWN for any other
+    static OPMLAttributeId AttributeId( const char* name );
+    static const char* AttributeName( OPMLAttributeId id );
+
     // p is the starting location,
     // the UTF-8 value of the entity will be placed in value, and length filled in.
     static const char* GetCharacterRef( const char* p, char* value, int* length );
@@ -1140,6 +1287,9 @@ public:
     /// The value of the attribute.
     const char* Value() const;
 
+    /// The interned name of the attribute, OPML_ATTR_UNKNOWN if it isn't a well-known one.
+    OPMLAttributeId Id() const { return static_cast<OPMLAttributeId>( _id ); }
+
     /// Gets the line number the attribute is in, if the document was parsed from a file.
     int GetLineNum() const { return _parseLineNum; }
 
@@ -1233,7 +1383,7 @@ public:
 private:
     enum { BUF_SIZE = 200 };
 
-    OPMLAttribute() : _name(), _value(),_parseLineNum( 0 ), _next( 0 ), _memPool( 0 ) {}
+    OPMLAttribute() : _name(), _value(), _id( OPML_ATTR_UNKNOWN ), _parseLineNum( 0 ), _next( 0 ), _memPool( 0 ) {}
     virtual ~OPMLAttribute()	{}
 
     OPMLAttribute( const OPMLAttribute& );	// not supported
@@ -1244,6 +1394,7 @@ private:
 
     mutable StrPair _name;
     mutable StrPair _value;
+    uint8_t         _id;
     int             _parseLineNum;
     OPMLAttribute*   _next;
     MemPool*        _memPool;
@@ -1300,6 +1451,15 @@ public:
     */
     const char* Attribute( const char* name, const char* value=0 ) const;
 
+    /** Same as Attribute( const char* ), for a well-known attribute. The
+    	lookup compares interned ids instead of strings.
+
+    	@verbatim
+    	const char* url = ele->Attribute( OPML_ATTR_URL );
+    	@endverbatim
+    */
+    const char* Attribute( OPMLAttributeId id ) const;
+
     /** Given an attribute name, IntAttribute() returns the value
     	of the attribute interpreted as an integer. The default
         value will be returned if the attribute isn't present,
@@ -1509,6 +1669,8 @@ public:
     }
     /// Query a specific attribute in the list.
     const OPMLAttribute* FindAttribute( const char* name ) const;
+    /// Query a well-known attribute in the list.
+    const OPMLAttribute* FindAttribute( OPMLAttributeId id ) const;
 
     /** Convenience function for easy access to the text inside an element. Although easy
     	and concise, GetText() is limited compared to getting the OPMLText child
@@ -1701,6 +1863,61 @@ enum Whitespace {
 };
 
 
+/// Releases a character buffer once the OPMLDocument parsed from it is done with it.
+typedef void (*OPMLBufferDeleter)( char* buffer );
+
+
+/**
+	Restricts the DOM an OPMLDocument builds to the parts the application
+	reads. Elements are kept by path and attributes by id:
+
+	@verbatim
+	OPMLFilter filter;
+	filter.AddPath( "opml/body/outline" );
+	filter.AddAttribute( OPML_ATTR_TYPE );
+	filter.AddAttribute( OPML_ATTR_URL );
+	doc.SetFilter( &filter );
+	@endverbatim
+
+	An element is kept if it is on one of the paths, together with its text.
+	Any other subtree is stepped over by the tokenizer without creating nodes
+	and without checking it beyond the nesting of its tags. Comments are
+	dropped. With no attribute added, every attribute is kept.
+*/
+class TINYOPML2_LIB OPMLFilter
+{
+public:
+    OPMLFilter() : _count( 0 ), _attributes( 0 ) {}
+
+    /// Keep the elements on a '/' separated path, starting at the root element.
+    bool AddPath( const char* path );
+    /// Keep a well-known attribute, everything else is dropped.
+    void AddAttribute( OPMLAttributeId id ) {
+        _attributes |= 1u << id;
+    }
+
+    enum { ROOT = -1, NONE = -2 };
+
+    /// The filter node of the element 'name' under 'parent', NONE if it is not kept.
+    int Match( int parent, const char* name, size_t len ) const;
+    bool AttributeAllowed( OPMLAttributeId id ) const {
+        return _attributes == 0 || ( ( _attributes >> id ) & 1 ) != 0;
+    }
+
+private:
+    enum { MAX_NODES = 16, MAX_NAME = 16 };
+
+    struct Node {
+        char name[MAX_NAME];
+        uint8_t len;
+        int8_t parent;
+    };
+    Node     _nodes[MAX_NODES];
+    int      _count;
+    uint32_t _attributes;
+};
+
+
 /** A Document binds together all the functionality.
 	It can be saved, loaded, and printed to the screen.
 	All Nodes are connected and allocated to a Document.
@@ -1717,8 +1934,14 @@ class TINYOPML2_LIB OPMLDocument : public OPMLNode
     friend class OPMLDeclaration;
     friend class OPMLUnknown;
 public:
-    /// constructor
-    OPMLDocument( bool processEntities = true, Whitespace whitespaceMode = PRESERVE_WHITESPACE );
+    /** constructor
+
+    	If an 'arena' is given, all the nodes of the document are allocated
+    	from it and Clear() releases them by resetting the arena, instead of
+    	returning blocks to the heap. The arena may be reused by the next
+    	document once this one is deleted, but not shared by two at once.
+    */
+    OPMLDocument( bool processEntities = true, Whitespace whitespaceMode = PRESERVE_WHITESPACE, OPMLArena* arena = 0 );
     ~OPMLDocument();
 
     virtual OPMLDocument* ToDocument()				{
@@ -1742,6 +1965,27 @@ public:
     */
     OPMLError Parse( const char* opml, size_t nBytes=static_cast<size_t>(-1) );
 
+    /**
+    	Parse an OPML document inside a mutable buffer, without copying it.
+    	The buffer must hold nBytes+1 chars: the one after the document is
+    	overwritten with the null terminator. Parsing is destructive, the
+    	strings of the DOM point into the buffer.
+
+    	The document takes ownership of the buffer and calls 'deleter' on it
+    	when it is cleared or deleted, even if parsing fails. With a null
+    	'deleter' the caller keeps the buffer, which must then outlive the
+    	document.
+    */
+    OPMLError ParseInPlace( char* opml, size_t nBytes, OPMLBufferDeleter deleter );
+
+    /**
+    	Only build the parts of the document 'filter' keeps, for the
+    	following parses. The filter must outlive them, null removes it.
+    */
+    void SetFilter( const OPMLFilter* filter ) {
+        _filter = filter;
+    }
+
     /**
     	Load an OPML file from disk.
     	Returns OPML_SUCCESS (0) on success, or
@@ -1931,6 +2175,11 @@ private:
     mutable StrPair	_errorStr;
     int             _errorLineNum;
     char*			_charBuffer;
+    OPMLBufferDeleter _charBufferDeleter;
+    OPMLArena*		_arena;
+    const OPMLFilter* _filter;
+    int				_filterNode;		// of the element whose children are parsed
+    int				_matchedFilterNode;	// of the element about to be parsed
     int				_parseCurLineNum;
 	int				_parsingDepth;
 	// Memory tracking does add some overhead.
@@ -1949,6 +2198,9 @@ private:
 	static const char* _errorNames[OPML_ERROR_COUNT];
 
     void Parse();
+    void DiscardParsedNodes();
+    char* SkipFiltered( char* p );
+    char* SkipElement( char* p );
 
     void SetError( OPMLError error, int lineNum, const char* format, ... );
 
@@ -2364,6 +2616,274 @@ private:
 };
 
 
+/// A name/value pair handed to an OPMLStreamHandler. Both pointers are only
+/// valid for the duration of the callback.
+struct OPMLStreamAttribute
+{
+    const char* name;
+    const char* value;
+    OPMLAttributeId id;
+};
+
+
+/**
+	Receives the events produced by OPMLStreamParser. Unlike the OPMLVisitor,
+	no DOM exists: the element name and attributes are only valid for the
+	duration of the call and must be copied if they need to outlive it.
+
+	If you return 'false' from a callback, the parser stops consuming input;
+	the remaining bytes of the current and any further Feed() are ignored.
+
+	'depth' is the nesting level of the element, the root element is at 0.
+*/
+class TINYOPML2_LIB OPMLStreamHandler
+{
+public:
+    virtual ~OPMLStreamHandler() {}
+
+    /// Called for every opening (or self-closing) tag.
+    virtual bool StartElement( const char* /*name*/, const OPMLStreamAttribute* /*attributes*/, int /*attributeCount*/, int /*depth*/ ) {
+        return true;
+    }
+    /// Called for every closing tag, and right after StartElement() for a self-closing one.
+    virtual bool EndElement( const char* /*name*/, int /*depth*/ ) {
+        return true;
+    }
+};
+
+
+/**
+	A push-mode, incremental OPML tokenizer. The document is handed over in
+	arbitrary chunks, as they arrive from the network, and the handler is
+	called as soon as a tag is complete:
+
+	@verbatim
+	OPMLStreamParser parser( &handler );
+	while( (n = read( buf, sizeof(buf) )) > 0 ) {
+		if ( parser.Feed( buf, n ) != OPML_SUCCESS ) break;
+	}
+	parser.Finish();
+	@endverbatim
+
+	Only the tag currently being read is buffered, so memory use is bounded
+	by the longest tag rather than by the document. Text content, comments,
+	CDATA, declarations and DTDs are skipped; OPML carries its data in
+	attributes. Attribute values get the same entity and newline processing
+	as OPMLDocument::Parse() would apply.
+*/
+class TINYOPML2_LIB OPMLStreamParser
+{
+public:
+    OPMLStreamParser( OPMLStreamHandler* handler, bool processEntities = true );
+
+    /// Push the next 'len' bytes of the document.
+    OPMLError Feed( const char* data, size_t len );
+    /** Signal the end of the document. Fails if a tag or an element is still
+        open, or if no element was seen at all.
+    */
+    OPMLError Finish();
+    /// Forget all state and start over with a new document.
+    void Reset();
+
+    /// Return the errorID.
+    OPMLError ErrorID() const {
+        return _errorID;
+    }
+    /// True if the handler asked to stop.
+    bool Stopped() const {
+        return _stopped;
+    }
+    /// Number of bytes handed to Feed() so far.
+    size_t BytesFed() const {
+        return _bytesFed;
+    }
+
+    /// Longest tag (in bytes, between the angle brackets) that is accepted.
+    enum { MAX_TAG_SIZE = 4 * 1024 };
+
+private:
+    OPMLStreamParser( const OPMLStreamParser& );	// not supported
+    void operator=( const OPMLStreamParser& );	// not supported
+
+    enum State {
+        TEXT,       // between tags, looking for '<'
+        MARKUP,     // just read '<'
+        TAG,        // inside an element tag
+        BANG,       // '<!', deciding between comment, CDATA and DTD
+        COMMENT,    // until "-->"
+        CDATA,      // until "]]>"
+        DECLARATION,// until "?>"
+        DTD         // until '>'
+    };
+
+    struct Span {
+        char* start;
+        char* end;
+    };
+
+    OPMLError DispatchTag();
+    OPMLError SetError( OPMLError error );
+
+    OPMLStreamHandler*  _handler;
+    bool                _processEntities;
+    State               _state;
+    char                _quote;
+    char                _tail[2];
+    bool                _stopped;
+    bool                _seenElement;
+    OPMLError           _errorID;
+    size_t              _bytesFed;
+
+    DynArray< char, 256 > _tag;
+    DynArray< char, 64 > _names;        // '\0' separated names of the open elements
+    DynArray< int, 16 > _nameStarts;    // offset of each open element name in _names
+    DynArray< Span, 32 > _spans;
+    DynArray< OPMLStreamAttribute, 16 > _attributes;
+};
+
+
+/*
+	Compile-time binding of well-known attributes to the fields of a struct.
+	Declare the struct and its attribute table once:
+
+	@verbatim
+	struct Station {
+		char     text[64];
+		const char* url;
+		uint16_t bitrate;
+		uint8_t  reliability;
+	};
+	typedef OPMLBinding< Station,
+		OPML_FIELD( Station, OPML_ATTR_TEXT, text ),
+		OPML_FIELD( Station, OPML_ATTR_URL, url ),
+		OPML_FIELD( Station, OPML_ATTR_BITRATE, bitrate ),
+		OPML_FIELD( Station, OPML_ATTR_RELIABILITY, reliability ) > StationBinding;
+
+	Station station = {};
+	StationBinding::Extract( attributes, attributeCount, &station );
+	@endverbatim
+
+	The extractor is generated from the table: every attribute costs a
+	chain of integer compares on its interned id, no string compares.
+	Fields may be char arrays (copied, truncated to fit), const char*
+	(pointing at the value, only valid as long as it is), bool, integers
+	(parsed, clamped to the field type) and floating point. A value that
+	doesn't parse leaves the field untouched.
+*/
+template< size_t N >
+inline void OPMLBindValue( char (&field)[N], const char* value )
+{
+    size_t i = 0;
+    for( ; i < N - 1 && value[i]; ++i ) {
+        field[i] = value[i];
+    }
+    field[i] = 0;
+}
+
+inline void OPMLBindValue( const char*& field, const char* value )
+{
+    field = value;
+}
+
+inline void OPMLBindValue( bool& field, const char* value )
+{
+    OPMLUtil::ToBool( value, &field );
+}
+
+inline void OPMLBindValue( float& field, const char* value )
+{
+    OPMLUtil::ToFloat( value, &field );
+}
+
+inline void OPMLBindValue( double& field, const char* value )
+{
+    OPMLUtil::ToDouble( value, &field );
+}
+
+template< class I >
+inline void OPMLBindInteger( I& field, const char* value, int64_t lo, int64_t hi )
+{
+    int64_t v = 0;
+    if ( OPMLUtil::ToInt64( value, &v ) ) {
+        field = static_cast<I>( v < lo ? lo : ( v > hi ? hi : v ) );
+    }
+}
+
+inline void OPMLBindValue( signed char& field, const char* value )		{ OPMLBindInteger( field, value, SCHAR_MIN, SCHAR_MAX ); }
+inline void OPMLBindValue( unsigned char& field, const char* value )	{ OPMLBindInteger( field, value, 0, UCHAR_MAX ); }
+inline void OPMLBindValue( short& field, const char* value )			{ OPMLBindInteger( field, value, SHRT_MIN, SHRT_MAX ); }
+inline void OPMLBindValue( unsigned short& field, const char* value )	{ OPMLBindInteger( field, value, 0, USHRT_MAX ); }
+inline void OPMLBindValue( int& field, const char* value )				{ OPMLBindInteger( field, value, INT_MIN, INT_MAX ); }
+inline void OPMLBindValue( unsigned& field, const char* value )			{ OPMLBindInteger( field, value, 0, UINT_MAX ); }
+inline void OPMLBindValue( long& field, const char* value )				{ OPMLBindInteger( field, value, LONG_MIN > INT64_MIN ? LONG_MIN : INT64_MIN, LONG_MAX < INT64_MAX ? LONG_MAX : INT64_MAX ); }
+inline void OPMLBindValue( unsigned long& field, const char* value )	{ OPMLBindInteger( field, value, 0, ULONG_MAX < INT64_MAX ? ULONG_MAX : INT64_MAX ); }
+
+
+/// One row of an OPMLBinding table, see OPML_FIELD().
+template< class T, OPMLAttributeId ID, class F, F T::*FIELD >
+struct OPMLField
+{
+    enum { id = ID };
+
+    static void Set( T* out, const char* value ) {
+        OPMLBindValue( out->*FIELD, value );
+    }
+};
+
+#define OPML_FIELD( Type, id, member ) tinyopml::OPMLField< Type, id, decltype( Type::member ), &Type::member >
+
+
+template< class T, class... Fields >
+struct OPMLFieldDispatch;
+
+template< class T >
+struct OPMLFieldDispatch< T >
+{
+    static bool Set( T*, int, const char* ) {
+        return false;
+    }
+};
+
+template< class T, class Field, class... Rest >
+struct OPMLFieldDispatch< T, Field, Rest... >
+{
+    static bool Set( T* out, int id, const char* value ) {
+        if ( id == Field::id ) {
+            Field::Set( out, value );
+            return true;
+        }
+        return OPMLFieldDispatch< T, Rest... >::Set( out, id, value );
+    }
+};
+
+
+template< class T, class... Fields >
+struct OPMLBinding
+{
+    /// Fill 'out' from the attributes of a stream event, returns the number of bound attributes found.
+    static int Extract( const OPMLStreamAttribute* attributes, int count, T* out ) {
+        int found = 0;
+        for( int i = 0; i < count; ++i ) {
+            if ( attributes[i].id != OPML_ATTR_UNKNOWN && OPMLFieldDispatch< T, Fields... >::Set( out, attributes[i].id, attributes[i].value ) ) {
+                ++found;
+            }
+        }
+        return found;
+    }
+
+    /// Fill 'out' from the attributes of an element, returns the number of bound attributes found.
+    static int Extract( const OPMLElement* element, T* out ) {
+        int found = 0;
+        for( const OPMLAttribute* a = element->FirstAttribute(); a; a = a->Next() ) {
+            if ( a->Id() != OPML_ATTR_UNKNOWN && OPMLFieldDispatch< T, Fields... >::Set( out, a->Id(), a->Value() ) ) {
+                ++found;
+            }
+        }
+        return found;
+    }
+};
+
+
 }	// tinyopml
 
 #if defined(_MSC_VER)
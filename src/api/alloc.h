@@ -0,0 +1,16 @@
+#ifndef API_ALLOC_H
+#define API_ALLOC_H
+
+#include <stdlib.h>
+
+// pages and buffers go to PSRAM on boards that have it
+#ifdef BOARD_HAS_PSRAM
+#include "esp32-hal-psram.h"
+#define alloc ps_malloc
+#define ralloc ps_realloc
+#else
+#define alloc malloc
+#define ralloc realloc
+#endif
+
+#endif
@@ -0,0 +1,32 @@
+#include "fetchstats.h"
+
+static const char *names[FETCH_METRICS] = {"dns", "connect", "ttfb", "transfer", "parse", "extract", "wire", "body"};
+
+void FetchStats::Record(const FetchTimings &timings)
+{
+    for (uint8_t i = 0; i < FETCH_METRICS; i++)
+    {
+        if (timings.Has((FetchMetric)i))
+            metrics[i].Add(timings.value[i]);
+    }
+    last = timings;
+    requests++;
+}
+
+void FetchStats::Clear()
+{
+    for (uint8_t i = 0; i < FETCH_METRICS; i++)
+        metrics[i].Clear();
+    last = FetchTimings();
+    requests = 0;
+}
+
+const char *FetchStats::Name(FetchMetric metric)
+{
+    return metric < FETCH_METRICS ? names[metric] : "";
+}
+
+const char *FetchStats::Unit(FetchMetric metric)
+{
+    return metric >= FETCH_WIRE_BYTES ? "B" : "us";
+}
@@ -0,0 +1,61 @@
+#ifndef API_FETCHSTATS_H
+#define API_FETCHSTATS_H
+
+#include "histogram.h"
+
+enum FetchMetric
+{
+    FETCH_DNS,        // resolving the host, when a connection is opened
+    FETCH_CONNECT,    // the TCP handshake, when a connection is opened
+    FETCH_TTFB,       // sending the request until the response headers are in
+    FETCH_TRANSFER,   // receiving (and inflating) the body, parsing left out
+    FETCH_PARSE,      // tokenizing the OPML, extraction left out
+    FETCH_EXTRACT,    // the handler turning outlines into menu items
+    FETCH_WIRE_BYTES, // the body as received
+    FETCH_BODY_BYTES, // the body as parsed, after inflating
+    FETCH_METRICS
+};
+
+/**
+ * What one request measured: durations in microseconds, sizes in bytes.
+ * Metrics that do not apply to the request, like the body of a 304 or the
+ * connect of a reused connection, are left unset and not recorded.
+ */
+struct FetchTimings
+{
+    uint32_t value[FETCH_METRICS];
+    uint16_t measured; // bit per metric
+
+    void Set(FetchMetric metric, uint32_t _value)
+    {
+        value[metric] = _value;
+        measured |= 1 << metric;
+    }
+    bool Has(FetchMetric metric) const { return measured & (1 << metric); }
+};
+
+/**
+ * A histogram per metric over all requests recorded, plus the last request
+ * as it was measured.
+ */
+class FetchStats
+{
+public:
+    void Record(const FetchTimings &);
+    void Clear();
+
+    uint32_t Requests() const { return requests; }
+    const Histogram &Get(FetchMetric metric) const { return metrics[metric]; }
+    const FetchTimings &Last() const { return last; }
+
+    static const char *Name(FetchMetric);
+    // "us" or "B"
+    static const char *Unit(FetchMetric);
+
+private:
+    Histogram metrics[FETCH_METRICS];
+    FetchTimings last = {};
+    uint32_t requests = 0;
+};
+
+#endif
@@ -0,0 +1,505 @@
+#include "flashcache.h"
+
+#include <ctype.h>
+#include <time.h>
+
+#define FLASH_CACHE_MAGIC 0x56504954 // "TIPV", pages with their HTTP validators
+// anything earlier means the clock has not been set from NTP yet
+#define FLASH_CACHE_MIN_TIME 1600000000UL
+
+FlashCache::FlashCache(fs::FS &_fs, size_t _budget, uint16_t _max_pages, uint32_t _ttl, const char *_dir)
+{
+    this->fs = &_fs;
+    this->dir = _dir;
+    snprintf(this->tmp, sizeof(this->tmp), "%s/.tmp", _dir);
+    this->budget = _budget;
+    this->max_pages = _max_pages;
+    this->ttl = _ttl;
+}
+
+uint32_t FlashCache::now()
+{
+    time_t t = time(NULL);
+    return (t < (time_t)FLASH_CACHE_MIN_TIME) ? 0 : (uint32_t)t;
+}
+
+bool FlashCache::path(const char *key, char *buffer, size_t size, const char *extension)
+{
+    size_t len = strlen(key);
+    if (len == 0 || len > FLASH_CACHE_MAX_KEY_LEN)
+        return false;
+
+    // guide_ids are plain alphanumerics, anything else is not worth a file name
+    for (size_t i = 0; i < len; i++)
+    {
+        char c = key[i];
+        if (!isalnum((unsigned char)c) && c != '_' && c != '-')
+            return false;
+    }
+
+    return snprintf(buffer, size, "%s/%s.%s", dir, key, extension) < (int)size;
+}
+
+bool FlashCache::readHeader(fs::File &file, Header *header)
+{
+    return file.read((uint8_t *)header, sizeof(Header)) == sizeof(Header) &&
+           header->magic == FLASH_CACHE_MAGIC &&
+           header->version == MENU_LIST_FORMAT_VERSION &&
+           file.size() == sizeof(Header) + header->count * sizeof(UIMenuItem) + header->strings_size;
+}
+
+// opens a stored page and reads its header, leaving the file positioned after it
+bool FlashCache::openHeader(const char *key, const char *mode, fs::File *file, Header *header)
+{
+    char name[32];
+    if (!path(key, name, sizeof(name)) || !fs->exists(name))
+        return false;
+
+    *file = fs->open(name, mode);
+    if (!*file)
+        return false;
+    if (!readHeader(*file, header))
+    {
+        file->close();
+        return false;
+    }
+    return true;
+}
+
+bool FlashCache::Validators(const char *key, PageValidators *validators)
+{
+    fs::File file;
+    Header header;
+    if (!openHeader(key, FILE_READ, &file, &header))
+        return false;
+    file.close();
+
+    *validators = header.validators;
+    // never trust what comes from flash to be terminated
+    validators->etag[sizeof(validators->etag) - 1] = 0;
+    validators->last_modified[sizeof(validators->last_modified) - 1] = 0;
+    return true;
+}
+
+bool FlashCache::Touch(const char *key)
+{
+    fs::File file;
+    Header header;
+    if (!openHeader(key, "r+", &file, &header))
+        return false;
+
+    header.saved_at = now();
+    bool ok = file.seek(0) && file.write((const uint8_t *)&header, sizeof(header)) == sizeof(header);
+    file.close();
+    return ok;
+}
+
+UIMenuList *FlashCache::Load(const char *key, bool *stale)
+{
+    char name[32];
+    if (!path(key, name, sizeof(name)) || !fs->exists(name))
+        return NULL;
+
+    fs::File file = fs->open(name, FILE_READ);
+    if (!file)
+        return NULL;
+
+    Header header;
+    if (!readHeader(file, &header))
+    {
+        ESP_LOGW(TAG, "%s is corrupt, removing", name);
+        file.close();
+        fs->remove(name);
+        return NULL;
+    }
+
+    UIMenuList *page = new UIMenuList();
+    bool ok = true;
+    if (header.strings_size > 0)
+    {
+        char *strings = page->RestoreStrings(header.strings_size);
+        ok = strings != NULL && file.read((uint8_t *)strings, header.strings_size) == header.strings_size;
+    }
+    for (uint16_t i = 0; ok && i < header.count; i++)
+    {
+        UIMenuItem item;
+        ok = file.read((uint8_t *)&item, sizeof(item)) == sizeof(item) && page->RestoreItem(item);
+    }
+    file.close();
+
+    if (!ok)
+    {
+        ESP_LOGW(TAG, "%s could not be restored", name);
+        page->Release();
+        fs->remove(name);
+        return NULL;
+    }
+
+    uint32_t t = now();
+    *stale = header.saved_at == 0 || t == 0 || t - header.saved_at > ttl;
+    ESP_LOGD(TAG, "%s loaded, %d items%s", name, page->Count(), *stale ? ", stale" : "");
+    return page;
+}
+
+// moves a string offset from a span [lo, hi) of the stored blob to where the span is put
+static bool rebase(uint16_t *offset, uint32_t lo, uint32_t hi, uint32_t at)
+{
+    if (*offset == 0)
+        return true;
+    if (*offset < lo || *offset >= hi)
+        return false;
+    *offset = *offset - lo + at;
+    return true;
+}
+
+UIMenuList *FlashCache::LoadWindow(const char *key, uint16_t first, uint16_t count, uint16_t *total)
+{
+    return load(key, NULL, first, count, total);
+}
+
+UIMenuList *FlashCache::LoadItems(const char *key, const uint16_t *indices, uint16_t count, uint16_t *total)
+{
+    return load(key, indices, 0, count, total);
+}
+
+/**
+ * Where the strings of the items end, given the highest offset among them:
+ * past the terminator of the string there
+ */
+bool FlashCache::stringsEnd(fs::File &file, const Header &header, uint32_t last, uint32_t *end)
+{
+    if (last >= header.strings_size || !file.seek(sizeof(Header) + last))
+        return false;
+
+    char chunk[32];
+    for (uint32_t at = last; at < header.strings_size; at += sizeof(chunk))
+    {
+        size_t n = header.strings_size - at < sizeof(chunk) ? header.strings_size - at : sizeof(chunk);
+        if (file.read((uint8_t *)chunk, n) != n)
+            return false;
+        const char *nul = (const char *)memchr(chunk, 0, n);
+        if (nul != NULL)
+        {
+            *end = at + (nul - chunk) + 1;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Reads the items at the given ascending indices, or from first on if there
+ * are none, a run of consecutive items at a time: their records in one read,
+ * their strings in another. A run's strings span from the lowest offset of
+ * its items to the end of the string at the highest one, whatever order the
+ * items are in.
+ */
+UIMenuList *FlashCache::load(const char *key, const uint16_t *indices, uint16_t first, uint16_t count, uint16_t *total)
+{
+    *total = 0;
+    char name[32];
+    if (!path(key, name, sizeof(name)) || !fs->exists(name))
+        return NULL;
+
+    fs::File file = fs->open(name, FILE_READ);
+    if (!file)
+        return NULL;
+
+    Header header;
+    if (!readHeader(file, &header) || count == 0 || (indices ? indices[0] : first) >= header.count)
+    {
+        file.close();
+        return NULL;
+    }
+    *total = header.count;
+    if (indices == NULL && count > header.count - first)
+        count = header.count - first;
+
+    struct Run
+    {
+        uint16_t at; // of the run's first item among those read
+        uint16_t length;
+        uint32_t lo; // the run's strings in the stored blob
+        uint32_t hi;
+    };
+    UIMenuItem *items = (UIMenuItem *)malloc(count * sizeof(UIMenuItem));
+    Run *runs = (Run *)malloc(count * sizeof(Run));
+    uint16_t run_count = 0;
+    uint32_t strings_size = 1; // offset 0, the empty string
+    bool ok = items != NULL && runs != NULL;
+    for (uint16_t i = 0; ok && i < count;)
+    {
+        uint16_t index = indices ? indices[i] : first + i;
+        uint16_t length = 1;
+        while (i + length < count && (indices ? indices[i + length] : first + i + length) == index + length)
+            length++;
+        ok = index + length <= header.count && (i == 0 || index > (indices ? indices[i - 1] : first + i - 1)) &&
+             file.seek(sizeof(Header) + header.strings_size + index * sizeof(UIMenuItem)) &&
+             file.read((uint8_t *)&items[i], length * sizeof(UIMenuItem)) == length * sizeof(UIMenuItem);
+
+        Run *run = &runs[run_count++];
+        run->at = i;
+        run->length = length;
+        run->lo = header.strings_size;
+        uint32_t last = 0;
+        for (uint16_t j = i; ok && j < i + length; j++)
+        {
+            // a section's url field is its item count, not a string
+            const uint16_t offsets[] = {items[j].id, items[j].text, (uint16_t)(items[j].type == SECTION ? 0 : items[j].url), items[j].subtext};
+            for (uint8_t k = 0; k < 4; k++)
+            {
+                if (offsets[k] == 0)
+                    continue;
+                if (offsets[k] < run->lo)
+                    run->lo = offsets[k];
+                if (offsets[k] > last)
+                    last = offsets[k];
+            }
+        }
+        run->hi = run->lo; // all strings of the run are empty
+        if (ok && last > 0)
+            ok = stringsEnd(file, header, last, &run->hi);
+        strings_size += run->hi - run->lo;
+        i += length;
+    }
+
+    UIMenuList *page = NULL;
+    if (ok)
+    {
+        page = new UIMenuList();
+        char *strings = page->RestoreStrings(strings_size);
+        ok = strings != NULL;
+        if (ok)
+            strings[0] = 0;
+        uint32_t at = 1;
+        for (uint16_t r = 0; ok && r < run_count; r++)
+        {
+            Run *run = &runs[r];
+            uint32_t size = run->hi - run->lo;
+            ok = size == 0 || (file.seek(sizeof(Header) + run->lo) && file.read((uint8_t *)strings + at, size) == size);
+            for (uint16_t i = run->at; ok && i < run->at + run->length; i++)
+            {
+                UIMenuItem item = items[i];
+                ok = rebase(&item.id, run->lo, run->hi, at) && rebase(&item.text, run->lo, run->hi, at) &&
+                     rebase(&item.subtext, run->lo, run->hi, at) &&
+                     (item.type == SECTION || rebase(&item.url, run->lo, run->hi, at)) && page->RestoreItem(item);
+            }
+            at += size;
+        }
+    }
+    free(items);
+    free(runs);
+    file.close();
+
+    if (!ok)
+    {
+        ESP_LOGW(TAG, "%s: %u items from %u could not be restored", name, count, indices ? indices[0] : first);
+        if (page != NULL)
+            page->Release();
+        return NULL;
+    }
+
+    ESP_LOGD(TAG, "%s: %u items from %u of %u loaded in %u runs, %u bytes", name, count, indices ? indices[0] : first,
+             header.count, run_count, (unsigned)page->MemoryUsage());
+    return page;
+}
+
+/**
+ * An item with its strings moved to where they go when the blob is written
+ * in item order, from the given offset on, which is advanced past them. A
+ * URL that reuses the id's bytes keeps doing so.
+ */
+static UIMenuItem repack(const UIMenuList *page, uint16_t index, uint32_t *at)
+{
+    const UIMenuItem *stored = page->Item(index);
+    UIMenuItem item = *stored;
+    uint16_t *fields[] = {&item.id, &item.text, &item.url, &item.subtext};
+    for (uint8_t j = 0; j < 4; j++)
+    {
+        if (*fields[j] == 0 || (fields[j] == &item.url && (item.type == SECTION || stored->url == stored->id)))
+            continue;
+        uint32_t len = strlen(page->Strings() + *fields[j]) + 1;
+        *fields[j] = *at;
+        *at += len;
+    }
+    if (item.type != SECTION && stored->url != 0 && stored->url == stored->id)
+        item.url = item.id;
+    return item;
+}
+
+bool FlashCache::Store(const char *key, const UIMenuList *page, const PageValidators *validators)
+{
+    // the page being read in windows stays, this one goes aside until Unpin()
+    char name[32];
+    if (!path(key, name, sizeof(name), strcmp(key, pinned) == 0 ? "new" : "pg"))
+        return false;
+
+    // the blob is written in item order rather than in the order the strings
+    // came in, a sorted page included, so that a window's strings are together
+    uint32_t strings_size = 1;
+    for (uint16_t i = 0; i < page->Count(); i++)
+        repack(page, i, &strings_size);
+    if (strings_size > MENU_LIST_MAX_STRINGS)
+        return false;
+
+    Header header = {
+        .magic = FLASH_CACHE_MAGIC,
+        .version = MENU_LIST_FORMAT_VERSION,
+        .count = page->Count(),
+        .strings_size = strings_size,
+        .saved_at = now(),
+        .validators = {},
+    };
+    if (validators != NULL)
+        header.validators = *validators;
+    size_t size = sizeof(Header) + header.count * sizeof(UIMenuItem) + header.strings_size;
+    if (size > budget)
+        return false;
+
+    if (fs->exists(name))
+        fs->remove(name);
+    if (!makeRoom(size, name))
+        return false;
+
+    // write aside and rename, so a power cut never leaves a half written page
+    fs::File file = fs->open(tmp, FILE_WRITE);
+    if (!file)
+        return false;
+
+    bool ok = file.write((const uint8_t *)&header, sizeof(header)) == sizeof(header) &&
+              file.write((const uint8_t *)"", 1) == 1;
+    uint32_t at = 1;
+    for (uint16_t i = 0; ok && i < header.count; i++)
+    {
+        const UIMenuItem *stored = page->Item(i);
+        UIMenuItem item = repack(page, i, &at);
+        const uint16_t from[] = {stored->id, stored->text, stored->url, stored->subtext};
+        const uint16_t to[] = {item.id, item.text, item.url, item.subtext};
+        for (uint8_t j = 0; ok && j < 4; j++)
+        {
+            // the url of a section or one sharing the id's bytes has none of its own
+            if (to[j] == 0 || (j == 2 && (item.type == SECTION || item.url == item.id)))
+                continue;
+            const char *value = page->Strings() + from[j];
+            size_t len = strlen(value) + 1;
+            ok = file.write((const uint8_t *)value, len) == len;
+        }
+    }
+    at = 1;
+    for (uint16_t i = 0; ok && i < header.count; i++)
+    {
+        UIMenuItem item = repack(page, i, &at);
+        ok = file.write((const uint8_t *)&item, sizeof(item)) == sizeof(item);
+    }
+    file.close();
+
+    if (!ok || !fs->rename(tmp, name))
+    {
+        ESP_LOGW(TAG, "unable to write %s", name);
+        fs->remove(tmp);
+        return false;
+    }
+
+    ESP_LOGD(TAG, "%s stored, %u bytes", name, (unsigned)size);
+    return true;
+}
+
+void FlashCache::Remove(const char *key)
+{
+    char name[32];
+    if (path(key, name, sizeof(name)))
+        fs->remove(name);
+}
+
+void FlashCache::Clear()
+{
+    // removing while iterating is not safe on every file system, one at a time
+    for (;;)
+    {
+        char name[32] = {0};
+        fs::File files = fs->open(dir);
+        fs::File file = files ? files.openNextFile() : fs::File();
+        if (!file)
+            return;
+        fullName(file, name, sizeof(name));
+        file.close();
+        files.close();
+        if (!fs->remove(name))
+            break;
+    }
+    pinned[0] = 0;
+}
+
+void FlashCache::Pin(const char *key)
+{
+    Unpin();
+    if (strlen(key) < sizeof(pinned))
+        strcpy(pinned, key);
+}
+
+void FlashCache::Unpin()
+{
+    if (!pinned[0])
+        return;
+
+    char name[32];
+    char newer[32];
+    if (path(pinned, name, sizeof(name)) && path(pinned, newer, sizeof(newer), "new") && fs->exists(newer))
+    {
+        fs->remove(name);
+        if (!fs->rename(newer, name))
+            fs->remove(newer);
+    }
+    pinned[0] = 0;
+}
+
+// depending on the core version name() is either the full path or the base name
+void FlashCache::fullName(fs::File &file, char *buffer, size_t size)
+{
+    if (file.name()[0] == '/')
+        strlcpy(buffer, file.name(), size);
+    else
+        snprintf(buffer, size, "%s/%s", dir, file.name());
+}
+
+bool FlashCache::makeRoom(size_t needed, const char *keep)
+{
+    char pinned_name[32] = "";
+    if (pinned[0])
+        path(pinned, pinned_name, sizeof(pinned_name));
+    for (;;)
+    {
+        size_t used = 0;
+        uint16_t pages = 0;
+        uint32_t oldest_at = UINT32_MAX;
+        char oldest[32] = {0};
+
+        fs::File files = fs->open(dir);
+        for (fs::File file = files.openNextFile(); file; file = files.openNextFile())
+        {
+            char name[32];
+            fullName(file, name, sizeof(name));
+            if (strcmp(name, tmp) == 0 || strcmp(name, keep) == 0)
+                continue;
+
+            Header header;
+            uint32_t saved_at = readHeader(file, &header) ? header.saved_at : 0;
+            used += file.size();
+            pages++;
+            // the pinned page counts against the budget, it is just not evicted
+            if (saved_at < oldest_at && strcmp(name, pinned_name) != 0)
+            {
+                oldest_at = saved_at;
+                strlcpy(oldest, name, sizeof(oldest));
+            }
+        }
+
+        if (used + needed <= budget && pages < max_pages)
+            return true;
+        if (!oldest[0])
+            return false;
+
+        ESP_LOGD(TAG, "evicting %s", oldest);
+        fs->remove(oldest);
+    }
+}
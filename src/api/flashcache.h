@@ -0,0 +1,91 @@
+#ifndef API_FLASHCACHE_H
+#define API_FLASHCACHE_H
+
+#include <FS.h>
+#include "menulist.h"
+
+#define FLASH_CACHE_DIR "/cache"
+#define FLASH_CACHE_MAX_KEY_LEN 20
+
+/** HTTP validators of a stored page, empty if the server sent none */
+struct PageValidators
+{
+    char etag[64];
+    char last_modified[32]; // e.g. "Wed, 21 Oct 2015 07:28:00 GMT"
+};
+
+/**
+ * Persistent cache of parsed pages in a flash file system. Pages are stored
+ * in their in-memory layout (header, items, string blob), so loading one is
+ * two reads and a validation pass, no OPML involved.
+ *
+ * Pages older than the TTL (or saved before the clock was set) are still
+ * returned, flagged as stale: showing them while offline beats showing
+ * nothing. They are the first to go when room is needed.
+ *
+ * The blob is stored in item order, even for a page sorted after parsing, so
+ * the strings of consecutive items are consecutive and a window of a long
+ * page can be read on its own, without loading the rest of it.
+ *
+ * Pages are stored with the ETag and Last-Modified they were served with, so
+ * that a stale page can be revalidated rather than downloaded again.
+ *
+ * Each cache keeps to a directory of its own, FLASH_CACHE_DIR unless told
+ * otherwise; the name has to be short, file names are at most 31 chars.
+ */
+class FlashCache
+{
+public:
+    FlashCache(fs::FS &, size_t, uint16_t, uint32_t, const char * = FLASH_CACHE_DIR);
+
+    // returns a new page (caller owns the reference) or NULL
+    UIMenuList *Load(const char *, bool *);
+    // a new page holding only items [first, first + count) of a stored one,
+    // with their strings; the stored page's item count goes to the last argument
+    UIMenuList *LoadWindow(const char *, uint16_t, uint16_t, uint16_t *);
+    // the same for the items at the given indices, which have to be ascending
+    UIMenuList *LoadItems(const char *, const uint16_t *, uint16_t, uint16_t *);
+    bool Store(const char *, const UIMenuList *, const PageValidators * = NULL);
+    void Remove(const char *);
+    // the validators of a stored page, false if there is none
+    bool Validators(const char *, PageValidators *);
+    // mark a stored page as fresh, once the server confirmed it is current
+    bool Touch(const char *);
+    // remove every stored page
+    void Clear();
+    // keep a page's file as it is while it is read in windows: it is not
+    // evicted, and a newer copy stored meanwhile takes its place on Unpin()
+    void Pin(const char *);
+    void Unpin();
+
+private:
+    struct Header
+    {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t count;
+        uint32_t strings_size;
+        uint32_t saved_at; // unix time, 0 if the clock was not set
+        PageValidators validators;
+    };
+
+    const char *TAG = "flash-cache";
+    fs::FS *fs;
+    const char *dir;
+    char tmp[24]; // where a page is written before it is renamed into place
+    char pinned[FLASH_CACHE_MAX_KEY_LEN + 1] = {0};
+    size_t budget;
+    uint16_t max_pages;
+    uint32_t ttl;
+
+    bool path(const char *, char *, size_t, const char * = "pg");
+    bool readHeader(fs::File &, Header *);
+    bool openHeader(const char *, const char *, fs::File *, Header *);
+    bool makeRoom(size_t, const char *);
+    UIMenuList *load(const char *, const uint16_t *, uint16_t, uint16_t, uint16_t *);
+    bool stringsEnd(fs::File &, const Header &, uint32_t, uint32_t *);
+    void fullName(fs::File &, char *, size_t);
+    static uint32_t now();
+};
+
+#endif
@@ -0,0 +1,66 @@
+#include "histogram.h"
+
+#include <string.h>
+
+Histogram::Histogram()
+{
+    Clear();
+}
+
+void Histogram::Clear()
+{
+    memset(buckets, 0, sizeof(buckets));
+    count = 0;
+    sum = 0;
+    min = UINT32_MAX;
+    max = 0;
+}
+
+uint8_t Histogram::bucketOf(uint32_t value)
+{
+    uint8_t i = 0;
+    while (value != 0 && i < HISTOGRAM_BUCKETS - 1)
+    {
+        value >>= 1;
+        i++;
+    }
+    return i;
+}
+
+uint32_t Histogram::BucketFloor(uint8_t i)
+{
+    return i == 0 ? 0 : (uint32_t)1 << (i - 1);
+}
+
+void Histogram::Add(uint32_t value)
+{
+    buckets[bucketOf(value)]++;
+    count++;
+    sum += value;
+    if (value < min)
+        min = value;
+    if (value > max)
+        max = value;
+}
+
+uint32_t Histogram::Percentile(uint8_t percent) const
+{
+    if (count == 0)
+        return 0;
+
+    // the rank of the sample, rounded up so that p100 is the largest one
+    uint32_t rank = (uint32_t)(((uint64_t)count * percent + 99) / 100);
+    if (rank == 0)
+        rank = 1;
+    uint32_t seen = 0;
+    for (uint8_t i = 0; i < HISTOGRAM_BUCKETS - 1; i++)
+    {
+        seen += buckets[i];
+        if (seen >= rank)
+        {
+            uint32_t ceiling = BucketFloor(i + 1) - 1;
+            return ceiling < max ? ceiling : max;
+        }
+    }
+    return max;
+}
@@ -0,0 +1,45 @@
+#ifndef API_HISTOGRAM_H
+#define API_HISTOGRAM_H
+
+#include <stdint.h>
+
+// bucket 0 holds zeros, bucket i values from 2^(i-1) up to 2^i - 1, the
+// last one everything above; 2^24 microseconds is about 17 seconds
+#define HISTOGRAM_BUCKETS 26
+
+/**
+ * Fixed-size histogram with power of two buckets. Recording is constant
+ * time and allocates nothing; percentiles are only as exact as a bucket,
+ * count, sum, min and max are exact.
+ */
+class Histogram
+{
+public:
+    Histogram();
+
+    void Add(uint32_t);
+    void Clear();
+
+    uint32_t Count() const { return count; }
+    uint64_t Sum() const { return sum; }
+    uint32_t Min() const { return count ? min : 0; }
+    uint32_t Max() const { return max; }
+    uint32_t Mean() const { return count ? (uint32_t)(sum / count) : 0; }
+    // the upper end of the bucket holding the given percentile, at most Max()
+    uint32_t Percentile(uint8_t) const;
+
+    uint32_t Bucket(uint8_t i) const { return buckets[i]; }
+    // the smallest value going into a bucket
+    static uint32_t BucketFloor(uint8_t);
+
+private:
+    uint32_t buckets[HISTOGRAM_BUCKETS];
+    uint32_t count;
+    uint64_t sum;
+    uint32_t min;
+    uint32_t max;
+
+    static uint8_t bucketOf(uint32_t);
+};
+
+#endif
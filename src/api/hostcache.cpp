@@ -0,0 +1,143 @@
+#include "hostcache.h"
+
+#include <string.h>
+
+HostCache::HostCache(host_resolver _resolver, uint32_t _ttl)
+{
+    this->resolver = _resolver;
+    this->ttl = _ttl;
+    memset(entries, 0, sizeof(entries));
+}
+
+HostCache::Entry *HostCache::find(const char *host)
+{
+    for (uint8_t i = 0; i < HOST_CACHE_SLOTS; i++)
+    {
+        if (entries[i].host[0] && strcmp(entries[i].host, host) == 0)
+            return &entries[i];
+    }
+    return NULL;
+}
+
+// a free slot, or else the one resolved longest ago; NULL if the name does not fit
+HostCache::Entry *HostCache::slotFor(const char *host)
+{
+    if (strlen(host) >= HOST_CACHE_NAME_LEN)
+        return NULL;
+
+    Entry *e = &entries[0];
+    for (uint8_t i = 0; i < HOST_CACHE_SLOTS && e->host[0]; i++)
+    {
+        if (!entries[i].host[0] || entries[i].resolved_at - e->resolved_at > 0x7fffffff)
+            e = &entries[i];
+    }
+    strcpy(e->host, host);
+    return e;
+}
+
+bool HostCache::fresh(const Entry *e, uint32_t now) const
+{
+    return !e->expired && now - e->resolved_at < ttl;
+}
+
+uint32_t HostCache::dueIn(const Entry *e, uint32_t now) const
+{
+    if (!e->host[0])
+        return UINT32_MAX;
+
+    uint32_t refresh_after = ttl - ttl / 4;
+    uint32_t age = now - e->resolved_at;
+    uint32_t by_age = (e->expired || age >= refresh_after) ? 0 : refresh_after - age;
+    // after a failure the resolver is given a rest before it is asked again
+    uint32_t retry_after = ttl / 8;
+    uint32_t since_try = now - e->tried_at;
+    uint32_t by_retry = since_try >= retry_after ? 0 : retry_after - since_try;
+    return by_age > by_retry ? by_age : by_retry;
+}
+
+bool HostCache::Lookup(const char *host, uint32_t *address, uint32_t now)
+{
+    Entry *e = find(host);
+    if (e != NULL && fresh(e, now))
+    {
+        hits++;
+        *address = e->address;
+        return true;
+    }
+
+    // the last attempt failed, the resolver gets a rest before it is asked again
+    if (e != NULL && e->tried_at != e->resolved_at && now - e->tried_at < ttl / 8)
+    {
+        fallbacks++;
+        *address = e->address;
+        return true;
+    }
+
+    misses++;
+    uint32_t resolved;
+    if (resolver(host, &resolved))
+    {
+        if (e == NULL)
+            e = slotFor(host);
+        if (e != NULL)
+        {
+            e->address = resolved;
+            e->resolved_at = e->tried_at = now;
+            e->expired = false;
+        }
+        *address = resolved;
+        return true;
+    }
+
+    failures++;
+    if (e == NULL)
+        return false;
+
+    e->tried_at = now;
+    fallbacks++;
+    *address = e->address;
+    return true;
+}
+
+void HostCache::Expire(const char *host)
+{
+    Entry *e = find(host);
+    if (e != NULL)
+        e->expired = true;
+}
+
+void HostCache::Refresh(uint32_t now)
+{
+    for (uint8_t i = 0; i < HOST_CACHE_SLOTS; i++)
+    {
+        Entry *e = &entries[i];
+        if (dueIn(e, now) != 0)
+            continue;
+
+        e->tried_at = now;
+        uint32_t resolved;
+        if (resolver(e->host, &resolved))
+        {
+            e->address = resolved;
+            e->resolved_at = now;
+            e->expired = false;
+            refreshes++;
+        }
+        else
+        {
+            failures++;
+        }
+    }
+}
+
+uint32_t HostCache::RefreshIn(uint32_t now) const
+{
+    uint32_t next = UINT32_MAX;
+    for (uint8_t i = 0; i < HOST_CACHE_SLOTS; i++)
+    {
+        uint32_t due = dueIn(&entries[i], now);
+        if (due < next)
+            next = due;
+    }
+    return next;
+}
@@ -0,0 +1,66 @@
+#ifndef API_HOSTCACHE_H
+#define API_HOSTCACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define HOST_CACHE_SLOTS 4
+#define HOST_CACHE_NAME_LEN 64
+
+// resolves a host name to an IPv4 address, false on failure
+typedef bool (*host_resolver)(const char *, uint32_t *);
+
+/**
+ * Small cache of resolved host addresses. An address is used for the time
+ * to live without asking the resolver; in the last quarter of it Refresh()
+ * renews it in the background, so lookups keep hitting. When the resolver
+ * fails the last known address is used rather than none, and it is not
+ * asked again for an eighth of the time to live. Times are in milliseconds
+ * since boot, passed in by the caller.
+ */
+class HostCache
+{
+public:
+    HostCache(host_resolver, uint32_t);
+
+    // the address of the host, resolved now if not known or expired
+    bool Lookup(const char *, uint32_t *, uint32_t);
+    // resolve again on the next lookup, the address stays as a fallback
+    void Expire(const char *);
+    // renews addresses close to expiry, for an idle task to call
+    void Refresh(uint32_t);
+    // milliseconds until Refresh() has anything to do, UINT32_MAX if never
+    uint32_t RefreshIn(uint32_t) const;
+
+    uint32_t hits = 0;
+    uint32_t misses = 0;
+    uint32_t refreshes = 0;
+    uint32_t failures = 0;
+    // lookups answered with an expired address because the resolver failed,
+    // or failed a moment ago
+    uint32_t fallbacks = 0;
+
+private:
+    struct Entry
+    {
+        char host[HOST_CACHE_NAME_LEN]; // empty while the slot is free
+        uint32_t address;
+        uint32_t resolved_at;
+        uint32_t tried_at; // the last attempt, spaces out retries after failures
+        bool expired;
+    };
+
+    host_resolver resolver;
+    uint32_t ttl;
+    Entry entries[HOST_CACHE_SLOTS];
+
+    Entry *find(const char *);
+    Entry *slotFor(const char *);
+    bool fresh(const Entry *, uint32_t) const;
+    uint32_t dueIn(const Entry *, uint32_t) const;
+
+    HostCache(const HostCache &);
+    HostCache &operator=(const HostCache &);
+};
+
+#endif
@@ -0,0 +1,222 @@
+#include "inflatestream.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include "alloc.h"
+
+#define GZIP_ID1 0x1f
+#define GZIP_ID2 0x8b
+#define GZIP_CM_DEFLATE 8
+#define GZIP_FHCRC 0x02
+#define GZIP_FEXTRA 0x04
+#define GZIP_FNAME 0x08
+#define GZIP_FCOMMENT 0x10
+#define GZIP_TRAILER_SIZE 8
+
+InflateStream::InflateStream()
+{
+}
+
+InflateStream::~InflateStream()
+{
+    release();
+}
+
+bool InflateStream::Begin(Print *_downstream, Format _format)
+{
+    this->downstream = _downstream;
+    this->format = _format;
+    if (inflater == NULL)
+    {
+        inflater = (tinfl_decompressor *)alloc(sizeof(tinfl_decompressor));
+        if (inflater != NULL)
+            memset(inflater, 0, sizeof(tinfl_decompressor));
+    }
+    if (window == NULL)
+        window = (uint8_t *)alloc(TINFL_LZ_DICT_SIZE);
+    if (inflater == NULL || window == NULL)
+    {
+        state = FAILED;
+        return false;
+    }
+
+    tinfl_init(inflater);
+    // a zlib stream has no gzip header, its own header is handled by tinfl
+    state = (_format == GZIP) ? HEADER : BODY;
+    window_pos = 0;
+    header_pos = 0;
+    skip = 0;
+    bytes_in = 0;
+    bytes_out = 0;
+    return true;
+}
+
+void InflateStream::End()
+{
+#if !INFLATE_KEEP_BUFFERS
+    release();
+#endif
+}
+
+void InflateStream::release()
+{
+    // a body cut short leaves no decompressor state behind
+    if (inflater != NULL)
+        tinfl_init(inflater);
+    free(inflater);
+    free(window);
+    inflater = NULL;
+    window = NULL;
+}
+
+size_t InflateStream::write(uint8_t c)
+{
+    return write(&c, 1);
+}
+
+size_t InflateStream::write(const uint8_t *buffer, size_t size)
+{
+    if (state == FAILED || inflater == NULL)
+        return 0;
+
+    bytes_in += size;
+    const uint8_t *p = buffer;
+    const uint8_t *end = buffer + size;
+    while (p < end && state != FAILED)
+    {
+        if (state == BODY)
+            p += inflate(p, end - p);
+        else if (state == TRAILER || state == DONE)
+        {
+            // CRC32 and size of the gzip trailer, the parser catches real damage
+            size_t n = end - p;
+            if (n > skip)
+                n = skip;
+            skip -= n;
+            p += n;
+            if (skip == 0)
+                state = DONE;
+            if (p < end && state == DONE)
+                p = end; // trailing garbage, ignored
+        }
+        else
+            p += parseHeader(p, end - p);
+    }
+    return (state == FAILED) ? 0 : size;
+}
+
+/**
+ * The optional gzip header fields come in a fixed order, each present if its flag is set
+ */
+InflateStream::State InflateStream::nextHeaderField(State after)
+{
+    uint8_t flags = gzip_header[3];
+    if (after < EXTRA_LEN && (flags & GZIP_FEXTRA))
+        return EXTRA_LEN;
+    if (after < NAME && (flags & GZIP_FNAME))
+        return NAME;
+    if (after < COMMENT && (flags & GZIP_FCOMMENT))
+        return COMMENT;
+    if (after < HEADER_CRC && (flags & GZIP_FHCRC))
+    {
+        skip = 2;
+        return HEADER_CRC;
+    }
+    return BODY;
+}
+
+/**
+ * Walks the gzip member header (RFC 1952), returns the bytes consumed
+ */
+size_t InflateStream::parseHeader(const uint8_t *p, size_t size)
+{
+    size_t used = 0;
+    while (used < size && state != BODY && state != FAILED)
+    {
+        uint8_t c = p[used++];
+        switch (state)
+        {
+        case HEADER:
+            gzip_header[header_pos++] = c;
+            if (header_pos < sizeof(gzip_header))
+                break;
+            if (gzip_header[0] != GZIP_ID1 || gzip_header[1] != GZIP_ID2 || gzip_header[2] != GZIP_CM_DEFLATE)
+            {
+                state = FAILED;
+                break;
+            }
+            header_pos = 0;
+            state = nextHeaderField(HEADER);
+            break;
+
+        case EXTRA_LEN:
+            skip = (header_pos == 0) ? c : (skip | (c << 8));
+            if (++header_pos == 2)
+                state = skip ? EXTRA : nextHeaderField(EXTRA);
+            break;
+
+        case EXTRA:
+            if (--skip == 0)
+                state = nextHeaderField(EXTRA);
+            break;
+
+        case NAME:
+        case COMMENT:
+            if (c == 0)
+                state = nextHeaderField(state);
+            break;
+
+        case HEADER_CRC:
+            if (--skip == 0)
+                state = BODY;
+            break;
+
+        default:
+            break;
+        }
+    }
+    return used;
+}
+
+/**
+ * Runs the inflater over the input, returns the bytes consumed
+ */
+size_t InflateStream::inflate(const uint8_t *p, size_t size)
+{
+    size_t used = 0;
+    mz_uint32 flags = TINFL_FLAG_HAS_MORE_INPUT | ((format == ZLIB) ? TINFL_FLAG_PARSE_ZLIB_HEADER : 0);
+
+    for (;;)
+    {
+        size_t in_bytes = size - used;
+        size_t out_bytes = TINFL_LZ_DICT_SIZE - window_pos;
+        tinfl_status status = tinfl_decompress(inflater, p + used, &in_bytes, window, window + window_pos, &out_bytes, flags);
+        used += in_bytes;
+
+        if (out_bytes > 0)
+        {
+            if (downstream->write(window + window_pos, out_bytes) != out_bytes)
+            {
+                state = FAILED;
+                return used;
+            }
+            bytes_out += out_bytes;
+            window_pos = (window_pos + out_bytes) & (TINFL_LZ_DICT_SIZE - 1);
+        }
+
+        if (status == TINFL_STATUS_DONE)
+        {
+            skip = (format == GZIP) ? GZIP_TRAILER_SIZE : 0;
+            state = skip ? TRAILER : DONE;
+            return used;
+        }
+        if (status < 0)
+        {
+            state = FAILED;
+            return used;
+        }
+        // keep going while the window is full and more output is pending
+        if (status == TINFL_STATUS_NEEDS_MORE_INPUT)
+            return used;
+    }
+}
@@ -0,0 +1,92 @@
+#ifndef API_INFLATESTREAM_H
+#define API_INFLATESTREAM_H
+
+#include <Stream.h>
+#include "rom/miniz.h"
+
+#ifndef INFLATE_KEEP_BUFFERS
+#ifdef BOARD_HAS_PSRAM
+#define INFLATE_KEEP_BUFFERS 1
+#else
+#define INFLATE_KEEP_BUFFERS 0
+#endif
+#endif
+
+/**
+ * Stream sink decompressing a gzip or zlib ("deflate") body on the fly and
+ * writing the result to another Print, e.g. the OPML parser sink.
+ *
+ * Memory is fixed: the ROM inflater state plus one deflate window
+ * (TINFL_LZ_DICT_SIZE, 32 KB, the largest a server may use), allocated by
+ * Begin(). The window doubles as the output buffer. With PSRAM they are
+ * kept for the next bodies, one object serving all responses; without it
+ * End() hands the 43 KB back to the heap after each body.
+ */
+class InflateStream : public Stream
+{
+public:
+    enum Format
+    {
+        GZIP,
+        ZLIB,
+    };
+
+    InflateStream();
+    ~InflateStream();
+
+    // starts a new body, false if there is no memory for the buffers
+    bool Begin(Print *, Format);
+    // the body is done with, frees the buffers unless INFLATE_KEEP_BUFFERS
+    void End();
+
+    size_t write(uint8_t) override;
+    size_t write(const uint8_t *, size_t) override;
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+    void flush() override {}
+
+    // the compressed stream ended properly
+    bool Done() const { return state == DONE; }
+    bool Failed() const { return state == FAILED; }
+    size_t BytesIn() const { return bytes_in; }
+    size_t BytesOut() const { return bytes_out; }
+
+private:
+    enum State
+    {
+        HEADER,
+        EXTRA_LEN,
+        EXTRA,
+        NAME,
+        COMMENT,
+        HEADER_CRC,
+        BODY,
+        TRAILER,
+        DONE,
+        FAILED,
+    };
+
+    Print *downstream = NULL;
+    Format format = GZIP;
+    State state = FAILED;
+    tinfl_decompressor *inflater = NULL;
+    uint8_t *window = NULL;
+    size_t window_pos = 0;
+
+    uint8_t gzip_header[10];
+    uint8_t header_pos = 0;
+    uint16_t skip = 0;
+    size_t bytes_in = 0;
+    size_t bytes_out = 0;
+
+    size_t parseHeader(const uint8_t *, size_t);
+    State nextHeaderField(State);
+    size_t inflate(const uint8_t *, size_t);
+    void release();
+
+    InflateStream(const InflateStream &);
+    InflateStream &operator=(const InflateStream &);
+};
+
+#endif
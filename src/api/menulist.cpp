@@ -0,0 +1,316 @@
+#include "menulist.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// longest first, the first match wins
+static const char *const URL_PREFIXES[] = {
+    "",
+    "http://opml.radiotime.com/Tune.ashx?id=",
+    "http://opml.radiotime.com/Browse.ashx?",
+    "http://opml.radiotime.com/",
+    "http://",
+};
+static const uint8_t URL_PREFIXES_COUNT = sizeof(URL_PREFIXES) / sizeof(URL_PREFIXES[0]);
+
+UIMenuList::UIMenuList()
+{
+}
+
+UIMenuList::~UIMenuList()
+{
+    for (uint16_t i = 0; i < blocks_count; i++)
+        free(blocks[i]);
+    free(blocks);
+    free(strings);
+}
+
+void UIMenuList::Retain()
+{
+    __atomic_add_fetch(&refs, 1, __ATOMIC_RELAXED);
+}
+
+void UIMenuList::Release()
+{
+    if (__atomic_sub_fetch(&refs, 1, __ATOMIC_ACQ_REL) == 0)
+        delete this;
+}
+
+bool UIMenuList::addString(const char *value, uint16_t *offset)
+{
+    size_t len = strlen(value);
+    if (len == 0)
+    {
+        *offset = 0;
+        return true;
+    }
+
+    if (strings_size + len + 1 > MENU_LIST_MAX_STRINGS)
+        return false;
+
+    if (strings_size + len + 1 > strings_capacity)
+    {
+        size_t new_capacity = strings_capacity ? strings_capacity * 2 : 512;
+        while (new_capacity < strings_size + len + 1)
+            new_capacity *= 2;
+        if (new_capacity > MENU_LIST_MAX_STRINGS)
+            new_capacity = MENU_LIST_MAX_STRINGS;
+        char *grown = (char *)ralloc(strings, new_capacity);
+        if (grown == NULL)
+            return false;
+        strings = grown;
+        strings_capacity = new_capacity;
+    }
+
+    if (strings_size == 0)
+        strings[strings_size++] = 0; // offset 0 is the empty string
+
+    *offset = strings_size;
+    memcpy(strings + strings_size, value, len + 1);
+    strings_size += len + 1;
+    return true;
+}
+
+UIMenuItem *UIMenuList::nextSlot()
+{
+    if (count == UINT16_MAX)
+        return NULL;
+
+    uint16_t block = count / MENU_LIST_BLOCK_ITEMS;
+    if (block == blocks_count)
+    {
+        if (blocks_count == blocks_capacity)
+        {
+            uint16_t new_capacity = blocks_capacity ? blocks_capacity * 2 : 4;
+            Block **grown = (Block **)ralloc(blocks, sizeof(Block *) * new_capacity);
+            if (grown == NULL)
+                return NULL;
+            blocks = grown;
+            blocks_capacity = new_capacity;
+        }
+
+        Block *b = (Block *)alloc(sizeof(Block));
+        if (b == NULL)
+            return NULL;
+        blocks[blocks_count++] = b;
+    }
+
+    return &blocks[block]->items[count % MENU_LIST_BLOCK_ITEMS];
+}
+
+bool UIMenuList::Append(UIMenuItemType type, const char *id, const char *text, const char *url, const UIStationInfo *station)
+{
+    UIMenuItem *slot = nextSlot();
+    if (slot == NULL)
+        return false;
+
+    UIMenuItem entry;
+    entry.type = type;
+    entry.url_prefix = 0;
+    for (uint8_t i = 1; i < URL_PREFIXES_COUNT; i++)
+    {
+        size_t len = strlen(URL_PREFIXES[i]);
+        if (strncmp(url, URL_PREFIXES[i], len) == 0)
+        {
+            entry.url_prefix = i;
+            url += len;
+            break;
+        }
+    }
+
+    if (!addString(id, &entry.id) || !addString(text, &entry.text))
+        return false;
+
+    // Tune.ashx?id=<guide_id> is by far the most common audio URL
+    if (entry.id != 0 && strcmp(url, strings + entry.id) == 0)
+        entry.url = entry.id;
+    else if (!addString(url, &entry.url))
+        return false;
+
+    entry.subtext = 0;
+    entry.bitrate = 0;
+    entry.reliability = 0;
+    entry.formats = 0;
+    if (station != NULL)
+    {
+        if (!addString(station->subtext, &entry.subtext))
+            return false;
+        entry.bitrate = station->bitrate;
+        entry.reliability = station->reliability;
+        entry.formats = station->formats;
+    }
+
+    *slot = entry;
+    count++;
+    return true;
+}
+
+UIMenuItem *UIMenuList::itemAt(uint16_t index) const
+{
+    return &blocks[index / MENU_LIST_BLOCK_ITEMS]->items[index % MENU_LIST_BLOCK_ITEMS];
+}
+
+void UIMenuList::MoveLast(uint16_t index)
+{
+    if (index + 1 >= count)
+        return;
+
+    UIMenuItem last = *itemAt(count - 1);
+    for (uint16_t i = count - 1; i > index; i--)
+        *itemAt(i) = *itemAt(i - 1);
+    *itemAt(index) = last;
+}
+
+char *UIMenuList::RestoreStrings(size_t size)
+{
+    if (count != 0 || strings != NULL || size > MENU_LIST_MAX_STRINGS)
+        return NULL;
+
+    strings = (char *)alloc(size);
+    if (strings != NULL)
+        strings_size = strings_capacity = size;
+    return strings;
+}
+
+bool UIMenuList::RestoreItem(const UIMenuItem &entry)
+{
+    if (entry.type > SECTION || entry.url_prefix >= URL_PREFIXES_COUNT)
+        return false;
+
+    // every offset must point at a string that is terminated within the blob
+    const uint16_t offsets[] = {entry.id, entry.text, (uint16_t)(entry.type == SECTION ? 0 : entry.url), entry.subtext};
+    for (uint8_t i = 0; i < 4; i++)
+    {
+        if (offsets[i] == 0)
+            continue;
+        if (offsets[i] >= strings_size || memchr(strings + offsets[i], 0, strings_size - offsets[i]) == NULL)
+            return false;
+    }
+
+    UIMenuItem *slot = nextSlot();
+    if (slot == NULL)
+        return false;
+    *slot = entry;
+    count++;
+    return true;
+}
+
+bool UIMenuList::SetSection(uint16_t index, uint16_t children)
+{
+    if (index >= count || children > count - index - 1)
+        return false;
+
+    UIMenuItem *i = itemAt(index);
+    i->type = SECTION;
+    i->url_prefix = 0;
+    i->url = children;
+    return true;
+}
+
+void UIMenuList::Shrink()
+{
+    if (strings == NULL || strings_size == strings_capacity)
+        return;
+
+    char *shrunk = (char *)ralloc(strings, strings_size);
+    if (shrunk != NULL)
+    {
+        strings = shrunk;
+        strings_capacity = strings_size;
+    }
+}
+
+UIMenuList *UIMenuList::Copy(uint16_t first) const
+{
+    UIMenuList *copy = new UIMenuList();
+    char *blob = copy->RestoreStrings(strings_size);
+    if (strings_size > 0 && blob == NULL)
+    {
+        copy->Release();
+        return NULL;
+    }
+    memcpy(blob, strings, strings_size);
+
+    for (uint16_t i = 0; i < count && i < first; i++)
+    {
+        if (!copy->RestoreItem(*Item(i)))
+        {
+            copy->Release();
+            return NULL;
+        }
+    }
+    return copy;
+}
+
+const UIMenuItem *UIMenuList::Item(uint16_t index) const
+{
+    if (index >= count)
+        return NULL;
+    return itemAt(index);
+}
+
+UIMenuItemType UIMenuList::Type(uint16_t index) const
+{
+    const UIMenuItem *i = Item(index);
+    return i ? (UIMenuItemType)i->type : UNKNOWN;
+}
+
+const char *UIMenuList::Id(uint16_t index) const
+{
+    const UIMenuItem *i = Item(index);
+    return (i && i->id) ? strings + i->id : "";
+}
+
+const char *UIMenuList::Text(uint16_t index) const
+{
+    const UIMenuItem *i = Item(index);
+    return (i && i->text) ? strings + i->text : "";
+}
+
+size_t UIMenuList::Url(uint16_t index, char *buffer, size_t size) const
+{
+    const UIMenuItem *i = Item(index);
+    if (i == NULL || i->type == SECTION)
+    {
+        if (size > 0)
+            buffer[0] = 0;
+        return 0;
+    }
+    return snprintf(buffer, size, "%s%s", URL_PREFIXES[i->url_prefix], i->url ? strings + i->url : "");
+}
+
+const char *UIMenuList::Subtext(uint16_t index) const
+{
+    const UIMenuItem *i = Item(index);
+    return (i && i->subtext) ? strings + i->subtext : "";
+}
+
+uint16_t UIMenuList::Bitrate(uint16_t index) const
+{
+    const UIMenuItem *i = Item(index);
+    return i ? i->bitrate : 0;
+}
+
+uint8_t UIMenuList::Reliability(uint16_t index) const
+{
+    const UIMenuItem *i = Item(index);
+    return i ? i->reliability : 0;
+}
+
+uint8_t UIMenuList::Formats(uint16_t index) const
+{
+    const UIMenuItem *i = Item(index);
+    return i ? i->formats : 0;
+}
+
+uint16_t UIMenuList::Children(uint16_t index) const
+{
+    const UIMenuItem *i = Item(index);
+    return (i && i->type == SECTION) ? i->url : 0;
+}
+
+size_t UIMenuList::MemoryUsage() const
+{
+    return sizeof(UIMenuList) + blocks_capacity * sizeof(Block *) + blocks_count * sizeof(Block) + strings_capacity;
+}
@@ -0,0 +1,141 @@
+#ifndef API_MENULIST_H
+#define API_MENULIST_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "alloc.h"
+
+#define MENU_LIST_BLOCK_ITEMS 32
+#define MENU_LIST_MAX_STRINGS UINT16_MAX
+// bump when UIMenuItem or the URL prefix table changes, invalidates serialized pages
+#define MENU_LIST_FORMAT_VERSION 3
+
+enum UIMenuItemType
+{
+    LINK,
+    AUDIO,
+    UNKNOWN,
+    SECTION // groups the items following it, see UIMenuList::Children()
+};
+
+// stream formats of a station, as a bit mask
+enum UIStreamFormat
+{
+    FORMAT_MP3 = 1 << 0,
+    FORMAT_AAC = 1 << 1,
+    FORMAT_OGG = 1 << 2,
+    FORMAT_WMA = 1 << 3,
+    FORMAT_HLS = 1 << 4,
+    FORMAT_FLAC = 1 << 5,
+    FORMAT_OTHER = 1 << 7,
+};
+
+/** What TuneIn tells about a station beyond its name, all optional */
+struct UIStationInfo
+{
+    const char *subtext; // usually what is playing
+    uint16_t bitrate;    // kbit/s, 0 if unknown
+    uint8_t reliability; // 0-100, 0 if unknown
+    uint8_t formats;     // UIStreamFormat bits, 0 if unknown
+};
+
+/**
+ * A menu entry: offsets of zero-terminated strings in the owning page's blob.
+ * Offset 0 is always the empty string. A section has no URL, its url field
+ * holds the number of items nested in it instead.
+ */
+struct UIMenuItem
+{
+    uint8_t type;
+    uint8_t url_prefix; // index into the well-known URL prefix table
+    uint16_t id;
+    uint16_t text;
+    uint16_t url; // the URL without its prefix, or a section's item count
+    uint16_t subtext;
+    uint16_t bitrate;
+    uint8_t reliability;
+    uint8_t formats;
+};
+
+/**
+ * One page of menu items. Strings of all items are packed into a single
+ * blob, URL prefixes shared by most TuneIn outlines are stored once as a
+ * table index, and a URL suffix identical to the guide_id reuses its bytes.
+ * Items live in fixed-size blocks that are never moved, so growing the
+ * list does not reallocate (and temporarily double) what is already there.
+ *
+ * Nested outlines are flattened in document order: a section is followed by
+ * the items nested in it, sections within sections included.
+ */
+class UIMenuList
+{
+public:
+    UIMenuList();
+
+    // pages are shared (e.g. by the UI and the page cache), the creator
+    // holds the first reference and the last Release() deletes the page
+    void Retain();
+    void Release();
+
+    bool Append(UIMenuItemType, const char *, const char *, const char *, const UIStationInfo * = NULL);
+    // move the last item to the given index, shifting the ones from there on
+    void MoveLast(uint16_t);
+    // turn an item into a section made of the given number of items after it
+    bool SetSection(uint16_t, uint16_t);
+    // release the unused tail of the string blob once the page is complete
+    void Shrink();
+    // a separate page with the first items appended so far, all of them by
+    // default, NULL when out of memory
+    UIMenuList *Copy(uint16_t = 0xffff) const;
+
+    uint16_t Count() const { return count; }
+    UIMenuItemType Type(uint16_t) const;
+    const char *Id(uint16_t) const;
+    const char *Text(uint16_t) const;
+    // writes the full URL to the buffer, returns its length (like snprintf)
+    size_t Url(uint16_t, char *, size_t) const;
+    const char *Subtext(uint16_t) const;
+    uint16_t Bitrate(uint16_t) const;
+    uint8_t Reliability(uint16_t) const;
+    uint8_t Formats(uint16_t) const;
+    // items nested in a section, 0 for anything else; may reach past the end
+    // of a window of a page
+    uint16_t Children(uint16_t) const;
+
+    size_t MemoryUsage() const;
+
+    // raw access for serialization, see FlashCache
+    const UIMenuItem *Item(uint16_t) const;
+    const char *Strings() const { return strings; }
+    size_t StringsSize() const { return strings_size; }
+    // the blob has to be restored first, items are validated against it
+    char *RestoreStrings(size_t);
+    bool RestoreItem(const UIMenuItem &);
+
+private:
+    ~UIMenuList();
+
+    struct Block
+    {
+        UIMenuItem items[MENU_LIST_BLOCK_ITEMS];
+    };
+
+    Block **blocks = NULL;
+    uint16_t blocks_count = 0;
+    uint16_t blocks_capacity = 0;
+    uint16_t count = 0;
+    uint16_t refs = 1;
+
+    char *strings = NULL;
+    size_t strings_size = 0;
+    size_t strings_capacity = 0;
+
+    UIMenuItem *nextSlot();
+    UIMenuItem *itemAt(uint16_t) const;
+    bool addString(const char *, uint16_t *);
+
+    UIMenuList(const UIMenuList &);
+    UIMenuList &operator=(const UIMenuList &);
+};
+
+#endif
@@ -0,0 +1,154 @@
+#include "menutree.h"
+
+#include <stdlib.h>
+
+UIMenuTree::UIMenuTree()
+{
+}
+
+UIMenuTree::~UIMenuTree()
+{
+    free(sections);
+}
+
+void UIMenuTree::Clear()
+{
+    free(sections);
+    sections = NULL;
+    count = 0;
+}
+
+bool UIMenuTree::Build(const UIMenuList *page, bool keep)
+{
+    uint16_t found = 0;
+    for (uint16_t i = 0; i < page->Count(); i++)
+    {
+        if (page->Type(i) == SECTION)
+            found++;
+    }
+    Section *built = (found == 0) ? NULL : (Section *)alloc(found * sizeof(Section));
+    if (found > 0 && built == NULL)
+    {
+        Clear();
+        return false;
+    }
+
+    uint16_t built_count = 0;
+    for (uint16_t i = 0; i < page->Count(); i++)
+    {
+        if (page->Type(i) != SECTION)
+            continue;
+        // a section never reaches past the end of the page
+        uint16_t children = page->Children(i);
+        if (children > page->Count() - i - 1)
+            children = page->Count() - i - 1;
+        built[built_count++] = {i, children, keep && Expanded(i)};
+    }
+
+    Clear();
+    sections = built;
+    count = built_count;
+    return true;
+}
+
+/**
+ * The items hidden are those of collapsed sections, except for sections
+ * nested in one that is collapsed already: sections are in item order and
+ * a nested one starts before the end of the range its parent hides.
+ */
+uint16_t UIMenuTree::Rows(uint16_t total) const
+{
+    uint32_t hidden_end = 0;
+    uint16_t rows = total;
+    for (uint16_t i = 0; i < count; i++)
+    {
+        const Section &s = sections[i];
+        if (s.item < hidden_end || s.expanded)
+            continue;
+        rows -= (s.children < rows) ? s.children : rows;
+        hidden_end = (uint32_t)s.item + 1 + s.children;
+    }
+    return rows;
+}
+
+uint16_t UIMenuTree::ItemAt(uint16_t row) const
+{
+    uint32_t item = row;
+    uint32_t hidden_end = 0;
+    for (uint16_t i = 0; i < count; i++)
+    {
+        const Section &s = sections[i];
+        if (s.item < hidden_end || s.expanded)
+            continue;
+        if (s.item >= item)
+            break;
+        item += s.children;
+        hidden_end = (uint32_t)s.item + 1 + s.children;
+    }
+    return (item > UINT16_MAX) ? UINT16_MAX : item;
+}
+
+uint16_t UIMenuTree::RowOf(uint16_t item) const
+{
+    uint16_t row = item;
+    uint32_t hidden_end = 0;
+    for (uint16_t i = 0; i < count; i++)
+    {
+        const Section &s = sections[i];
+        if (s.item < hidden_end || s.expanded)
+            continue;
+        if (s.item >= item)
+            break;
+        if (item <= (uint32_t)s.item + s.children)
+            return row - (item - s.item);
+        row -= s.children;
+        hidden_end = (uint32_t)s.item + 1 + s.children;
+    }
+    return row;
+}
+
+uint8_t UIMenuTree::Depth(uint16_t item) const
+{
+    uint8_t depth = 0;
+    for (uint16_t i = 0; i < count && sections[i].item < item; i++)
+    {
+        if (item <= (uint32_t)sections[i].item + sections[i].children && depth < UINT8_MAX)
+            depth++;
+    }
+    return depth;
+}
+
+UIMenuTree::Section *UIMenuTree::find(uint16_t item) const
+{
+    uint16_t lo = 0;
+    uint16_t hi = count;
+    while (lo < hi)
+    {
+        uint16_t mid = lo + (hi - lo) / 2;
+        if (sections[mid].item < item)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return (lo < count && sections[lo].item == item) ? &sections[lo] : NULL;
+}
+
+bool UIMenuTree::IsSection(uint16_t item) const
+{
+    return find(item) != NULL;
+}
+
+bool UIMenuTree::Expanded(uint16_t item) const
+{
+    Section *s = find(item);
+    return s != NULL && s->expanded;
+}
+
+bool UIMenuTree::Toggle(uint16_t item)
+{
+    Section *s = find(item);
+    if (s == NULL)
+        return false;
+    s->expanded = !s->expanded;
+    return true;
+}
@@ -0,0 +1,57 @@
+#ifndef API_MENUTREE_H
+#define API_MENUTREE_H
+
+#include "menulist.h"
+
+/**
+ * Which sections of a page are expanded, and the rows that leaves on screen.
+ * Only the sections are recorded (item index and length), so mapping rows to
+ * items needs neither the items themselves nor a row per item: a long page
+ * can be held as a window and still be browsed as a tree. Sections start
+ * collapsed, a page shows its groups first; expanding one needs nothing
+ * fetched.
+ */
+class UIMenuTree
+{
+public:
+    UIMenuTree();
+    ~UIMenuTree();
+
+    // take the sections of a page, all collapsed, or as they were for items
+    // that were sections before when 'keep' (a page continued); false when
+    // out of memory, the page is then shown flat
+    bool Build(const UIMenuList *, bool = false);
+    void Clear();
+    uint16_t Sections() const { return count; }
+
+    // rows shown of a page of the given length
+    uint16_t Rows(uint16_t) const;
+    uint16_t ItemAt(uint16_t) const;
+    // the row of an item, or of the collapsed section hiding it
+    uint16_t RowOf(uint16_t) const;
+    // number of sections the item is nested in
+    uint8_t Depth(uint16_t) const;
+
+    bool IsSection(uint16_t) const;
+    bool Expanded(uint16_t) const;
+    // expand a collapsed section or collapse an expanded one
+    bool Toggle(uint16_t);
+
+private:
+    struct Section
+    {
+        uint16_t item;
+        uint16_t children;
+        bool expanded;
+    };
+
+    Section *sections = NULL;
+    uint16_t count = 0;
+
+    Section *find(uint16_t) const;
+
+    UIMenuTree(const UIMenuTree &);
+    UIMenuTree &operator=(const UIMenuTree &);
+};
+
+#endif
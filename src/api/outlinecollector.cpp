@@ -0,0 +1,167 @@
+#include "outlinecollector.h"
+
+#include <string.h>
+#include <strings.h>
+
+static const struct
+{
+    const char *name;
+    uint8_t format;
+} STREAM_FORMATS[] = {
+    {"mp3", FORMAT_MP3},
+    {"aac", FORMAT_AAC},
+    {"ogg", FORMAT_OGG},
+    {"wma", FORMAT_WMA},
+    {"hls", FORMAT_HLS},
+    {"flac", FORMAT_FLAC},
+};
+
+/**
+ * Turn a formats attribute ("mp3", "aac,mp3", ...) into UIStreamFormat bits
+ */
+uint8_t OutlineCollector::ParseFormats(const char *formats)
+{
+    uint8_t bits = 0;
+    while (*formats)
+    {
+        formats += strspn(formats, ", ");
+        size_t len = strcspn(formats, ",");
+        size_t name_len = len;
+        while (name_len > 0 && formats[name_len - 1] == ' ')
+            name_len--;
+
+        if (name_len > 0)
+        {
+            uint8_t format = FORMAT_OTHER;
+            for (uint8_t i = 0; i < sizeof(STREAM_FORMATS) / sizeof(STREAM_FORMATS[0]); i++)
+            {
+                if (strlen(STREAM_FORMATS[i].name) == name_len && strncasecmp(formats, STREAM_FORMATS[i].name, name_len) == 0)
+                {
+                    format = STREAM_FORMATS[i].format;
+                    break;
+                }
+            }
+            bits |= format;
+        }
+        formats += len;
+    }
+    return bits;
+}
+
+bool OutlineCollector::ByReliability(const UIMenuItem &a, const UIMenuItem &b)
+{
+    if (a.reliability != b.reliability)
+        return a.reliability > b.reliability;
+    return a.bitrate > b.bitrate;
+}
+
+bool OutlineCollector::StartElement(const char *name, const OPMLStreamAttribute *attributes, int attributeCount, int depth)
+{
+    if (cancelled != NULL && *cancelled)
+        return false;
+    if (depth == 1 && strcmp(name, "body") == 0)
+        in_body = true;
+    if (depth < 2 || !in_body || strcmp(name, "outline") != 0)
+        return true;
+
+    OutlineAttributes outline = {"", "", "", "", "", "", 0, 0};
+    OutlineBinding::Extract(attributes, attributeCount, &outline);
+
+    UIMenuItemType type = UNKNOWN;
+    if (strcmp(outline.type, "link") == 0)
+        type = LINK;
+    else if (strcmp(outline.type, "audio") == 0)
+        type = AUDIO;
+
+    UIStationInfo station = {outline.subtext, outline.bitrate, outline.reliability, ParseFormats(outline.formats)};
+    if (type == AUDIO && ((station.formats != 0 && (station.formats & accept_formats) == 0) ||
+                          (max_bitrate != 0 && station.bitrate > max_bitrate)))
+    {
+        dropped++;
+        return true;
+    }
+
+    if (!items->Append(type, outline.guide_id, outline.text, outline.url, &station))
+    {
+        out_of_memory = true;
+        return false;
+    }
+
+    // whether it is a section is known once it is closed
+    bool tracked = (depth == 2 + open_count && open_count < OUTLINE_MAX_DEPTH);
+    // stations are only sorted among their siblings
+    if (!tracked || type != AUDIO)
+        run_start = items->Count();
+    else if (open_count > 0 && run_start <= open[open_count - 1])
+        run_start = open[open_count - 1] + 1;
+    if (tracked)
+        open[open_count++] = items->Count() - 1;
+    return true;
+}
+
+bool OutlineCollector::EndElement(const char *name, int depth)
+{
+    if (depth == 1 && strcmp(name, "body") == 0)
+        in_body = false;
+
+    if (open_count > 0 && depth == 1 + open_count && strcmp(name, "outline") == 0)
+    {
+        uint16_t index = open[--open_count];
+        uint16_t children = items->Count() - index - 1;
+        if (children > 0)
+        {
+            items->SetSection(index, children);
+            run_start = items->Count();
+        }
+        else if (before != NULL && items->Type(index) == AUDIO)
+        {
+            sortLast();
+        }
+    }
+
+    if (first_items_callback != NULL)
+    {
+        uint16_t count = settled();
+        if (count >= first_items)
+        {
+            first_items_callback(items, count, first_items_arg);
+            first_items_callback = NULL;
+        }
+    }
+    return true;
+}
+
+/**
+ * The items that no later outline can move or turn into a section: those
+ * before the run of stations still being sorted and before the first
+ * outline not closed yet
+ */
+uint16_t OutlineCollector::settled() const
+{
+    uint16_t count = (before != NULL) ? run_start : items->Count();
+    if (open_count > 0 && open[0] < count)
+        count = open[0];
+    return count;
+}
+
+/**
+ * Move the station just closed, the last item, into place among the stations
+ * since run_start, which are in order already
+ */
+void OutlineCollector::sortLast()
+{
+    uint16_t last = items->Count() - 1;
+    const UIMenuItem &item = *items->Item(last);
+    uint16_t lo = run_start;
+    uint16_t hi = last;
+    // after all those it does not go before, so equal stations keep their order
+    while (lo < hi)
+    {
+        uint16_t mid = lo + (hi - lo) / 2;
+        if (before(item, *items->Item(mid)))
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+    items->MoveLast(lo);
+}
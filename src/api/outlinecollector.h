@@ -0,0 +1,106 @@
+#ifndef API_OUTLINECOLLECTOR_H
+#define API_OUTLINECOLLECTOR_H
+
+#include <tinyopml.h>
+#include "menulist.h"
+
+using namespace tinyopml;
+
+// outlines nested deeper are kept, as items of the deepest section
+#define OUTLINE_MAX_DEPTH 8
+
+/** The outline attributes a menu entry is made of, valid during the parser callback */
+struct OutlineAttributes
+{
+    const char *type;
+    const char *guide_id;
+    const char *text;
+    const char *url;
+    const char *subtext;
+    const char *formats;
+    uint16_t bitrate;
+    uint8_t reliability;
+};
+
+typedef OPMLBinding<OutlineAttributes,
+                    OPML_FIELD(OutlineAttributes, OPML_ATTR_TYPE, type),
+                    OPML_FIELD(OutlineAttributes, OPML_ATTR_GUIDE_ID, guide_id),
+                    OPML_FIELD(OutlineAttributes, OPML_ATTR_TEXT, text),
+                    OPML_FIELD(OutlineAttributes, OPML_ATTR_URL, url),
+                    OPML_FIELD(OutlineAttributes, OPML_ATTR_SUBTEXT, subtext),
+                    OPML_FIELD(OutlineAttributes, OPML_ATTR_FORMATS, formats),
+                    OPML_FIELD(OutlineAttributes, OPML_ATTR_BITRATE, bitrate),
+                    OPML_FIELD(OutlineAttributes, OPML_ATTR_RELIABILITY, reliability)>
+    OutlineBinding;
+
+/**
+ * Collects the outline elements of opml/body straight into a UIMenuList,
+ * keeping only the attributes the UI needs. An outline with outlines nested
+ * in it (Browse groups results by "stations", "shows" and so on this way)
+ * becomes a section followed by its items.
+ *
+ * Stations can be filtered and ordered as they come in: a station is sorted
+ * into the run of stations before it once its outline closes, so the page
+ * is complete and in order when the response ends, no second pass needed.
+ */
+class OutlineCollector : public OPMLStreamHandler
+{
+public:
+    OutlineCollector(UIMenuList *_items, volatile bool *_cancelled) : items(_items), cancelled(_cancelled) {}
+
+    bool out_of_memory = false;
+    uint16_t dropped = 0; // stations left out by Accept()
+
+    // keep only stations in one of the formats and up to the bitrate (0 for
+    // any); stations that do not tell are kept
+    void Accept(uint8_t formats, uint16_t max_bitrate)
+    {
+        this->accept_formats = formats;
+        this->max_bitrate = max_bitrate;
+    }
+
+    // keep consecutive stations of a section in the order of 'before'
+    void OrderBy(bool (*before)(const UIMenuItem &, const UIMenuItem &))
+    {
+        this->before = before;
+    }
+
+    // most reliable first, then highest bitrate
+    static bool ByReliability(const UIMenuItem &, const UIMenuItem &);
+    static uint8_t ParseFormats(const char *);
+
+    // have 'callback' see the page once the first 'count' outlines are in
+    // and settled, so that they can be shown before the rest of the response
+    // arrives; it is passed how many items are in their final place and
+    // shape, at least 'count', those past them may still change
+    void OnFirstItems(uint16_t count, void (*callback)(const UIMenuList *, uint16_t, void *), void *arg)
+    {
+        this->first_items = count;
+        this->first_items_callback = callback;
+        this->first_items_arg = arg;
+    }
+
+    bool StartElement(const char *, const OPMLStreamAttribute *, int, int) override;
+    bool EndElement(const char *, int) override;
+
+private:
+    UIMenuList *items;
+    volatile bool *cancelled;
+    bool in_body = false;
+    uint16_t open[OUTLINE_MAX_DEPTH]; // items of the outlines not closed yet
+    uint8_t open_count = 0;
+
+    uint8_t accept_formats = 0xff;
+    uint16_t max_bitrate = 0;
+    bool (*before)(const UIMenuItem &, const UIMenuItem &) = NULL;
+    uint16_t run_start = 0; // first of the stations the next one may be sorted among
+
+    void sortLast();
+    uint16_t settled() const;
+
+    uint16_t first_items = 0;
+    void (*first_items_callback)(const UIMenuList *, uint16_t, void *) = NULL;
+    void *first_items_arg = NULL;
+};
+
+#endif
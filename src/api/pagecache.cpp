@@ -0,0 +1,129 @@
+#include "pagecache.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+PageCache::PageCache(size_t _budget, uint32_t _ttl)
+{
+    this->budget = _budget;
+    this->ttl = _ttl;
+}
+
+PageCache::~PageCache()
+{
+    Clear();
+}
+
+PageCache::Entry *PageCache::find(const char *key)
+{
+    for (Entry *e = head; e != NULL; e = e->next)
+    {
+        if (strcmp(e->key, key) == 0)
+            return e;
+    }
+    return NULL;
+}
+
+void PageCache::unlink(Entry *e)
+{
+    if (e->prev)
+        e->prev->next = e->next;
+    else
+        head = e->next;
+    if (e->next)
+        e->next->prev = e->prev;
+    else
+        tail = e->prev;
+    e->prev = e->next = NULL;
+}
+
+void PageCache::pushFront(Entry *e)
+{
+    e->prev = NULL;
+    e->next = head;
+    if (head)
+        head->prev = e;
+    head = e;
+    if (tail == NULL)
+        tail = e;
+}
+
+void PageCache::drop(Entry *e)
+{
+    unlink(e);
+    size -= e->size;
+    count--;
+    e->page->Release();
+    free(e);
+}
+
+UIMenuList *PageCache::Get(const char *key, uint32_t now, bool *expired)
+{
+    Entry *e = find(key);
+    if (e == NULL)
+    {
+        misses++;
+        return NULL;
+    }
+
+    hits++;
+    bool old = ttl != 0 && now - e->stored_at > ttl;
+    if (old)
+        stale++;
+    if (expired != NULL)
+        *expired = old;
+    if (e != head)
+    {
+        unlink(e);
+        pushFront(e);
+    }
+    e->page->Retain();
+    return e->page;
+}
+
+bool PageCache::Contains(const char *key)
+{
+    return find(key) != NULL;
+}
+
+void PageCache::Put(const char *key, UIMenuList *page, uint32_t now)
+{
+    Remove(key);
+
+    size_t page_size = page->MemoryUsage();
+    if (page_size > budget)
+        return;
+
+    while (size + page_size > budget && tail != NULL)
+    {
+        drop(tail);
+        evictions++;
+    }
+
+    size_t key_len = strlen(key);
+    Entry *e = (Entry *)malloc(sizeof(Entry) + key_len);
+    if (e == NULL)
+        return;
+
+    memcpy(e->key, key, key_len + 1);
+    e->size = page_size;
+    e->stored_at = now;
+    e->page = page;
+    page->Retain();
+    pushFront(e);
+    size += page_size;
+    count++;
+}
+
+void PageCache::Remove(const char *key)
+{
+    Entry *e = find(key);
+    if (e != NULL)
+        drop(e);
+}
+
+void PageCache::Clear()
+{
+    while (head != NULL)
+        drop(head);
+}
@@ -0,0 +1,68 @@
+#ifndef API_PAGECACHE_H
+#define API_PAGECACHE_H
+
+#include "menulist.h"
+
+/**
+ * Bounded LRU cache of parsed pages keyed by guide_id. The budget is in
+ * bytes as reported by UIMenuList::MemoryUsage(); the least recently used
+ * pages are evicted until a new page fits. Pages are reference counted,
+ * so evicting a page the UI still shows does not free it under its feet.
+ * A page older than the time to live is still returned, flagged as stale,
+ * for the caller to show while it revalidates it. Times are in milliseconds
+ * since boot, passed in by the caller.
+ */
+class PageCache
+{
+public:
+    // budget in bytes, time to live in milliseconds (0 for pages never stale)
+    PageCache(size_t, uint32_t = 0);
+    ~PageCache();
+
+    // returns a retained page (caller must Release() it) or NULL, and
+    // whether it was put longer than the time to live ago
+    UIMenuList *Get(const char *, uint32_t = 0, bool * = NULL);
+    // lookup without touching the LRU order or the counters
+    bool Contains(const char *);
+    void Put(const char *, UIMenuList *, uint32_t = 0);
+    void Remove(const char *);
+    void Clear();
+    void SetTtl(uint32_t _ttl) { ttl = _ttl; }
+
+    size_t Size() const { return size; }
+    size_t Budget() const { return budget; }
+    uint16_t Count() const { return count; }
+
+    uint32_t hits = 0;
+    uint32_t misses = 0;
+    uint32_t evictions = 0;
+    uint32_t stale = 0; // hits on pages past their time to live
+
+private:
+    struct Entry
+    {
+        Entry *prev;
+        Entry *next;
+        UIMenuList *page;
+        size_t size;
+        uint32_t stored_at;
+        char key[1]; // allocated to fit
+    };
+
+    size_t budget;
+    uint32_t ttl;
+    size_t size = 0;
+    uint16_t count = 0;
+    Entry *head = NULL; // most recently used
+    Entry *tail = NULL;
+
+    Entry *find(const char *);
+    void unlink(Entry *);
+    void pushFront(Entry *);
+    void drop(Entry *);
+
+    PageCache(const PageCache &);
+    PageCache &operator=(const PageCache &);
+};
+
+#endif
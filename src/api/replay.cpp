@@ -0,0 +1,299 @@
+#include "replay.h"
+
+#define REPLAY_MAGIC 0x31505254 // "TRP1"
+
+const ReplayProfile replay_profiles[REPLAY_PROFILES] = {
+    {"recorded", 0, 0},
+    {"lan", 5, 1000000},
+    {"wifi", 40, 200000},
+    {"weak", 250, 16000},
+};
+
+// the file a URL is recorded in, named after its FNV-1a hash
+static void path(const char *url, char *buffer, size_t size)
+{
+    uint32_t hash = 2166136261u;
+    for (const char *c = url; *c; c++)
+    {
+        hash ^= (uint8_t)*c;
+        hash *= 16777619u;
+    }
+    snprintf(buffer, size, "%s/%08x.rsp", REPLAY_DIR, (unsigned)hash);
+}
+
+/**
+ * Stream sink writing to another one and to a file, timing both so that
+ * what is left of the transfer is the network's
+ */
+class TeeStream : public Stream
+{
+public:
+    TeeStream(Stream *_sink, fs::File *_file) : sink(_sink), file(_file) {}
+
+    size_t write(uint8_t c) override
+    {
+        return write(&c, 1);
+    }
+
+    size_t write(const uint8_t *buffer, size_t size) override
+    {
+        uint32_t started = micros();
+        if (file->write(buffer, size) != size)
+            failed = true;
+        size_t written = sink->write(buffer, size);
+        if (written != size)
+            failed = true;
+        elapsed += micros() - started;
+        length += size;
+        return written;
+    }
+
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+    void flush() override {}
+
+    uint32_t elapsed = 0;
+    uint32_t length = 0;
+    bool failed = false; // the file is incomplete or the sink stopped the transfer
+
+private:
+    Stream *sink;
+    fs::File *file;
+};
+
+RecordingTransport::RecordingTransport(ApiTransport *_inner, fs::FS &_fs)
+{
+    this->inner = _inner;
+    this->fs = &_fs;
+    memset(&response, 0, sizeof(response));
+}
+
+void RecordingTransport::Begin(const char *url)
+{
+    memset(&response, 0, sizeof(response));
+    // a URL too long to keep is not recorded
+    if (strlen(url) < sizeof(response.url))
+        strcpy(response.url, url);
+    inner->Begin(url);
+}
+
+void RecordingTransport::AddHeader(const char *name, const char *value)
+{
+    if (strcasecmp(name, "If-None-Match") == 0 || strcasecmp(name, "If-Modified-Since") == 0)
+        return;
+    inner->AddHeader(name, value);
+}
+
+void RecordingTransport::SetAcceptEncoding(const char *encoding)
+{
+    inner->SetAcceptEncoding(encoding);
+}
+
+int RecordingTransport::Get(FetchTimings *timings)
+{
+    int code = inner->Get(timings);
+    response.status = code;
+    response.ttfb_us = timings->Has(FETCH_TTFB) ? timings->value[FETCH_TTFB] : 0;
+    if (code != HTTP_CODE_OK)
+        return code;
+
+    String encoding = inner->Header("Content-Encoding");
+    String etag = inner->Header("ETag");
+    String last_modified = inner->Header("Last-Modified");
+    if (encoding.length() < (int)sizeof(response.encoding))
+        strcpy(response.encoding, encoding.c_str());
+    if (etag.length() < (int)sizeof(response.validators.etag))
+        strcpy(response.validators.etag, etag.c_str());
+    if (last_modified.length() < (int)sizeof(response.validators.last_modified))
+        strcpy(response.validators.last_modified, last_modified.c_str());
+    return code;
+}
+
+String RecordingTransport::Header(const char *name)
+{
+    return inner->Header(name);
+}
+
+int RecordingTransport::WriteToStream(Stream *stream)
+{
+    if (response.status != HTTP_CODE_OK || !response.url[0])
+        return inner->WriteToStream(stream);
+
+    char name[32];
+    path(response.url, name, sizeof(name));
+    fs::File file = fs->open(name, FILE_WRITE);
+    // the header goes in last, when the body's length and timing are known
+    if (!file || file.write((const uint8_t *)&response, sizeof(response)) != sizeof(response))
+    {
+        ESP_LOGW(TAG, "unable to write %s", name);
+        if (file)
+            file.close();
+        return inner->WriteToStream(stream);
+    }
+
+    TeeStream tee(stream, &file);
+    uint32_t started = micros();
+    int written = inner->WriteToStream(&tee);
+    uint32_t elapsed = micros() - started;
+    if (written < 0 || tee.failed)
+    {
+        file.close();
+        fs->remove(name);
+        return written;
+    }
+
+    response.magic = REPLAY_MAGIC;
+    response.transfer_us = elapsed - tee.elapsed;
+    response.length = tee.length;
+    bool saved = file.seek(0) && file.write((const uint8_t *)&response, sizeof(response)) == sizeof(response);
+    file.close();
+    if (!saved)
+    {
+        fs->remove(name);
+        return written;
+    }
+
+    recorded++;
+    ESP_LOGD(TAG, "%s recorded to %s, %u bytes", response.url, name, (unsigned)response.length);
+    return written;
+}
+
+void RecordingTransport::End(bool keep)
+{
+    inner->End(keep);
+}
+
+ReplayTransport::ReplayTransport(fs::FS &_fs, const ReplayProfile *_profile)
+{
+    this->fs = &_fs;
+    this->profile = _profile;
+    this->url[0] = 0;
+    memset(&response, 0, sizeof(response));
+}
+
+ReplayTransport::~ReplayTransport()
+{
+    if (file)
+        file.close();
+}
+
+bool ReplayTransport::open(const char *_url, fs::File *_file, RecordedResponse *_response)
+{
+    char name[32];
+    path(_url, name, sizeof(name));
+    if (!fs->exists(name))
+        return false;
+
+    *_file = fs->open(name, FILE_READ);
+    if (!*_file)
+        return false;
+
+    // another URL with the same hash, or a recording cut short
+    if (_file->read((uint8_t *)_response, sizeof(RecordedResponse)) != sizeof(RecordedResponse) ||
+        _response->magic != REPLAY_MAGIC ||
+        strncmp(_response->url, _url, sizeof(_response->url)) != 0 ||
+        _file->size() != sizeof(RecordedResponse) + _response->length)
+    {
+        _file->close();
+        return false;
+    }
+    return true;
+}
+
+bool ReplayTransport::Has(const char *_url)
+{
+    fs::File f;
+    RecordedResponse r;
+    if (!open(_url, &f, &r))
+        return false;
+    f.close();
+    return true;
+}
+
+void ReplayTransport::Begin(const char *_url)
+{
+    if (file)
+        file.close();
+    found = false;
+    strlcpy(url, _url, sizeof(url));
+}
+
+void ReplayTransport::AddHeader(const char *, const char *)
+{
+}
+
+void ReplayTransport::SetAcceptEncoding(const char *)
+{
+}
+
+int ReplayTransport::Get(FetchTimings *timings)
+{
+    uint32_t started = micros();
+    found = open(url, &file, &response);
+    bool as_recorded = profile->latency_ms == 0 && profile->bytes_per_second == 0;
+    uint32_t latency = as_recorded ? (found ? response.ttfb_us / 1000 : 0) : profile->latency_ms;
+    if (latency > 0)
+        delay(latency);
+    timings->Set(FETCH_TTFB, micros() - started);
+    if (!found)
+    {
+        missing++;
+        return HTTP_CODE_NOT_FOUND;
+    }
+
+    replayed++;
+    return response.status;
+}
+
+String ReplayTransport::Header(const char *name)
+{
+    if (!found)
+        return String();
+    if (strcasecmp(name, "Content-Encoding") == 0)
+        return String(response.encoding);
+    if (strcasecmp(name, "ETag") == 0)
+        return String(response.validators.etag);
+    if (strcasecmp(name, "Last-Modified") == 0)
+        return String(response.validators.last_modified);
+    return String();
+}
+
+int ReplayTransport::WriteToStream(Stream *stream)
+{
+    if (!found)
+        return HTTPC_ERROR_CONNECTION_LOST;
+
+    bool as_recorded = profile->latency_ms == 0 && profile->bytes_per_second == 0;
+    uint8_t buffer[REPLAY_CHUNK];
+    uint32_t started = millis();
+    uint32_t sent = 0;
+    while (sent < response.length)
+    {
+        size_t chunk = response.length - sent < REPLAY_CHUNK ? response.length - sent : REPLAY_CHUNK;
+        if (file.read(buffer, chunk) != chunk)
+            return HTTPC_ERROR_CONNECTION_LOST;
+        if (stream->write(buffer, chunk) != chunk)
+            return HTTPC_ERROR_STREAM_WRITE;
+        sent += chunk;
+
+        // the body arrives at the profile's rate, or as fast as it was recorded;
+        // the network keeps sending while the sink works, as with a TCP window
+        uint64_t due = 0;
+        if (profile->bytes_per_second)
+            due = (uint64_t)sent * 1000 / profile->bytes_per_second;
+        else if (as_recorded)
+            due = (uint64_t)response.transfer_us * sent / response.length / 1000;
+        uint32_t elapsed = millis() - started;
+        if (due > elapsed)
+            delay(due - elapsed);
+    }
+    return sent;
+}
+
+void ReplayTransport::End(bool)
+{
+    if (file)
+        file.close();
+    found = false;
+}
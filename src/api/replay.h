@@ -0,0 +1,107 @@
+#ifndef API_REPLAY_H
+#define API_REPLAY_H
+
+#include <FS.h>
+#include "transport.h"
+#include "flashcache.h"
+
+#define REPLAY_DIR "/rec"
+#define REPLAY_MAX_URL_LEN 128
+#define REPLAY_CHUNK 512
+
+/**
+ * How a replayed response is delivered: the time to the first byte, then
+ * the body at a given rate. A profile with neither repeats the timings the
+ * response was recorded with.
+ */
+struct ReplayProfile
+{
+    const char *name;
+    uint32_t latency_ms;
+    uint32_t bytes_per_second;
+};
+
+#define REPLAY_PROFILES 4
+extern const ReplayProfile replay_profiles[REPLAY_PROFILES];
+
+/** A recorded response as stored in front of its body */
+struct RecordedResponse
+{
+    uint32_t magic;
+    char url[REPLAY_MAX_URL_LEN];
+    int32_t status;
+    uint32_t ttfb_us;
+    uint32_t transfer_us; // the network's share, without the sink
+    uint32_t length;      // of the body as received, compressed or not
+    char encoding[16];
+    PageValidators validators;
+};
+
+/**
+ * Transport in front of another one, saving each 200 response to a file of
+ * its own: status, headers, timings and the body as it came, compressed or
+ * not. Conditional headers are kept from the server so that every response
+ * is recorded in full. Files are kept until removed by hand, this is meant
+ * for a unit on the bench.
+ */
+class RecordingTransport : public ApiTransport
+{
+public:
+    RecordingTransport(ApiTransport *, fs::FS &);
+
+    void Begin(const char *) override;
+    void AddHeader(const char *, const char *) override;
+    void SetAcceptEncoding(const char *) override;
+    int Get(FetchTimings *) override;
+    String Header(const char *) override;
+    int WriteToStream(Stream *) override;
+    void End(bool) override;
+
+    uint32_t recorded = 0;
+
+private:
+    const char *TAG = "record";
+
+    ApiTransport *inner;
+    fs::FS *fs;
+    RecordedResponse response;
+};
+
+/**
+ * Transport serving recorded responses under a latency and bandwidth
+ * profile, for repeatable measurements without a network. URLs never
+ * recorded get a 404. Conditional requests are answered in full, so that
+ * every run sees the same work whatever the flash cache holds.
+ */
+class ReplayTransport : public ApiTransport
+{
+public:
+    ReplayTransport(fs::FS &, const ReplayProfile *);
+    ~ReplayTransport();
+
+    // whether a response to the URL was recorded
+    bool Has(const char *);
+
+    void Begin(const char *) override;
+    void AddHeader(const char *, const char *) override;
+    void SetAcceptEncoding(const char *) override;
+    int Get(FetchTimings *) override;
+    String Header(const char *) override;
+    int WriteToStream(Stream *) override;
+    void End(bool) override;
+
+    uint32_t replayed = 0;
+    uint32_t missing = 0;
+
+private:
+    fs::FS *fs;
+    const ReplayProfile *profile;
+    char url[REPLAY_MAX_URL_LEN];
+    fs::File file;
+    RecordedResponse response;
+    bool found = false;
+
+    bool open(const char *, fs::File *, RecordedResponse *);
+};
+
+#endif
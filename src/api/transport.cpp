@@ -0,0 +1,91 @@
+#include "transport.h"
+
+// response headers HTTPClient has to keep for us
+static const char *responseHeaders[] = {"Content-Encoding", "ETag", "Last-Modified"};
+
+HttpTransport::HttpTransport(const char *_host, uint16_t _port, host_resolver resolver, uint32_t dns_ttl) : hosts(resolver, dns_ttl)
+{
+    this->host = _host;
+    this->port = _port;
+    this->client.setReuse(true);
+}
+
+void HttpTransport::Begin(const char *url)
+{
+    size_t host_len = strlen(host);
+    direct = strncmp(url, "http://", 7) == 0 && strncmp(url + 7, host, host_len) == 0 && url[7 + host_len] == '/';
+    client.begin(tcp, url);
+    client.collectHeaders(responseHeaders, sizeof(responseHeaders) / sizeof(responseHeaders[0]));
+}
+
+void HttpTransport::AddHeader(const char *name, const char *value)
+{
+    client.addHeader(name, value);
+}
+
+void HttpTransport::SetAcceptEncoding(const char *encoding)
+{
+    client.setAcceptEncoding(encoding);
+}
+
+int HttpTransport::Get(FetchTimings *timings)
+{
+    // with a caller owned WiFiClient HTTPClient keeps the socket open across
+    // requests to the same host, saving the DNS lookup and TCP handshake
+    if (tcp.connected())
+        ESP_LOGD(TAG, "reusing connection to %s", host);
+    else if (direct)
+        connect(timings);
+
+    uint32_t requested = micros();
+    int code = client.GET();
+    if (code > 0)
+        timings->Set(FETCH_TTFB, micros() - requested);
+    return code;
+}
+
+String HttpTransport::Header(const char *name)
+{
+    return client.header(name);
+}
+
+int HttpTransport::WriteToStream(Stream *stream)
+{
+    return client.writeToStream(stream);
+}
+
+void HttpTransport::End(bool keep)
+{
+    client.end();
+    if (!keep)
+        tcp.stop();
+}
+
+/**
+ * Opens the connection to the host for HTTPClient to reuse, with its
+ * address from the resolver cache. Without an address HTTPClient is left to
+ * connect by name itself.
+ */
+void HttpTransport::connect(FetchTimings *timings)
+{
+    uint32_t started = micros();
+    uint32_t address;
+    bool resolved = hosts.Lookup(host, &address, millis());
+    uint32_t looked_up = micros();
+    timings->Set(FETCH_DNS, looked_up - started);
+    if (!resolved)
+    {
+        ESP_LOGW(TAG, "%s not resolved", host);
+        return;
+    }
+
+    connections++;
+    bool connected = tcp.connect(IPAddress(address), port);
+    timings->Set(FETCH_CONNECT, micros() - looked_up);
+    if (!connected)
+    {
+        // the host may have moved, ask the resolver again next time
+        ESP_LOGW(TAG, "connecting to %s failed", IPAddress(address).toString().c_str());
+        hosts.Expire(host);
+    }
+}
@@ -0,0 +1,70 @@
+#ifndef API_TRANSPORT_H
+#define API_TRANSPORT_H
+
+#include <HTTPClient.h>
+#include "fetchstats.h"
+#include "hostcache.h"
+
+/**
+ * What TuneinApi needs of HTTP: one GET at a time, a few headers each way,
+ * the body streamed into a sink. HttpTransport goes to the network, the
+ * transports in replay.h record its responses and stand in for it.
+ */
+class ApiTransport
+{
+public:
+    virtual ~ApiTransport() {}
+
+    virtual void Begin(const char *) = 0;
+    virtual void AddHeader(const char *, const char *) = 0;
+    // in place of HTTPClient's own Accept-Encoding, which another one added
+    // would only be sent next to
+    virtual void SetAcceptEncoding(const char *) = 0;
+    // the status code or a negative HTTPClient error; sets whichever of the
+    // DNS, connect and TTFB timings apply
+    virtual int Get(FetchTimings *) = 0;
+    // a response header, empty if it was not sent
+    virtual String Header(const char *) = 0;
+    // bytes written to the stream, or a negative HTTPClient error
+    virtual int WriteToStream(Stream *) = 0;
+    // ends the exchange; without keep the connection is dropped, after an
+    // error it may be mid-response or dead
+    virtual void End(bool) = 0;
+};
+
+/**
+ * HTTPClient over a WiFiClient it does not own, so that the connection is
+ * kept open across requests. Connections to the given host are opened with
+ * its address from the resolver cache, HTTPClient then reuses them; other
+ * hosts are left to HTTPClient.
+ */
+class HttpTransport : public ApiTransport
+{
+public:
+    HttpTransport(const char *, uint16_t, host_resolver, uint32_t);
+
+    void Begin(const char *) override;
+    void AddHeader(const char *, const char *) override;
+    void SetAcceptEncoding(const char *) override;
+    int Get(FetchTimings *) override;
+    String Header(const char *) override;
+    int WriteToStream(Stream *) override;
+    void End(bool) override;
+
+    HostCache hosts;
+    // new connections to the host
+    uint32_t connections = 0;
+
+private:
+    const char *TAG = "http";
+
+    const char *host;
+    uint16_t port;
+    bool direct = false; // the current URL is on the host
+    HTTPClient client;
+    WiFiClient tcp;
+
+    void connect(FetchTimings *);
+};
+
+#endif
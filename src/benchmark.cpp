@@ -0,0 +1,145 @@
+#include "benchmark.h"
+
+#include <stdlib.h>
+
+NavigationBenchmark::NavigationBenchmark(fs::FS &_fs)
+{
+    this->fs = &_fs;
+}
+
+static int byValue(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+// nearest rank of sorted samples
+static uint32_t percentile(const uint32_t *samples, uint16_t count, uint8_t percent)
+{
+    if (count == 0)
+        return 0;
+    uint16_t rank = (count * percent + 99) / 100;
+    return samples[rank > 0 ? rank - 1 : 0];
+}
+
+void NavigationBenchmark::Run(Print &out, uint32_t seed)
+{
+    TuneinApi *api = new TuneinApi(BENCHMARK_CACHE_DIR);
+    out.printf("navigation benchmark: %u steps from %s, seed %u\n", BENCHMARK_STEPS, API_ROOT_ID, seed);
+    for (uint8_t i = 0; i < REPLAY_PROFILES; i++)
+    {
+        const ReplayProfile *profile = &replay_profiles[i];
+        ReplayTransport replay(*fs, profile);
+        api->SetTransport(&replay);
+        api->ClearCache();
+        api->ClearFlashCache();
+        api->ClearStats();
+
+        state = seed != 0 ? seed : 1;
+        uint32_t all[BENCHMARK_STEPS];
+        uint32_t fetched[BENCHMARK_STEPS];
+        uint16_t counts[2] = {0, 0};
+        uint16_t failed = 0;
+        walk(api, &replay, all, fetched, counts, &failed);
+        out.printf("%s: %u menus, %u fetched, %u failed, %u not recorded\n",
+                   profile->name, counts[0], counts[1], failed, replay.missing);
+        report(out, "all", all, counts[0]);
+        report(out, "fetched", fetched, counts[1]);
+        api->DumpStats(out);
+        api->SetTransport(NULL);
+    }
+    api->ClearFlashCache();
+    delete api;
+}
+
+void NavigationBenchmark::report(Print &out, const char *label, uint32_t *samples, uint16_t count)
+{
+    qsort(samples, count, sizeof(samples[0]), byValue);
+    uint32_t p50 = percentile(samples, count, 50);
+    uint32_t p95 = percentile(samples, count, 95);
+    out.printf("  time to menu, %-7s p50 %u.%03u ms, p95 %u.%03u ms\n", label, p50 / 1000, p50 % 1000, p95 / 1000, p95 % 1000);
+}
+
+/**
+ * Takes the steps, entering a recorded category or going back up, and
+ * keeps the time to menu of every page loaded, and apart from those of the
+ * pages that had to be fetched rather than came from the memory cache.
+ */
+void NavigationBenchmark::walk(TuneinApi *api, ReplayTransport *replay, uint32_t *all, uint32_t *fetched, uint16_t *counts, uint16_t *failed)
+{
+    char path[BENCHMARK_MAX_DEPTH + 1][API_MAX_ID_LEN];
+    uint8_t depth = 0;
+    strlcpy(path[0], API_ROOT_ID, sizeof(path[0]));
+
+    for (uint16_t step = 0; step < BENCHMARK_STEPS; step++)
+    {
+        uint32_t requests = replay->replayed + replay->missing;
+        uint32_t flash_write_us = api->flash_write_us;
+        uint32_t started = micros();
+        UIMenuList *page = api->LoadItems(path[depth]);
+        uint32_t elapsed = micros() - started - (api->flash_write_us - flash_write_us);
+
+        char next[API_MAX_ID_LEN] = "";
+        if (page == NULL)
+        {
+            (*failed)++;
+        }
+        else
+        {
+            all[counts[0]++] = elapsed;
+            if (replay->replayed + replay->missing != requests)
+                fetched[counts[1]++] = elapsed;
+            if (depth < BENCHMARK_MAX_DEPTH && random(100) >= BENCHMARK_BACK_PERCENT)
+                pickLink(replay, page, next);
+            page->Release();
+        }
+
+        // with nowhere to go from the root the walk stays there
+        if (next[0])
+            strlcpy(path[++depth], next, sizeof(path[0]));
+        else if (depth > 0)
+            depth--;
+    }
+}
+
+// one of the page's categories that has been recorded, at random
+bool NavigationBenchmark::pickLink(ReplayTransport *replay, const UIMenuList *page, char *id)
+{
+    char url[API_MAX_URL_LEN];
+    uint16_t candidates = 0;
+    for (uint8_t pass = 0; pass < 2; pass++)
+    {
+        uint16_t pick = pass == 1 ? random(candidates) : 0;
+        uint16_t seen = 0;
+        for (uint16_t i = 0; i < page->Count(); i++)
+        {
+            const char *candidate = page->Id(i);
+            if (page->Type(i) != LINK || strlen(candidate) >= API_MAX_ID_LEN)
+                continue;
+            TuneinApi::BrowseUrl(candidate, url, sizeof(url));
+            if (!replay->Has(url))
+                continue;
+
+            if (pass == 1 && seen == pick)
+            {
+                strcpy(id, candidate);
+                return true;
+            }
+            seen++;
+        }
+        if (seen == 0)
+            return false;
+        candidates = seen;
+    }
+    return false;
+}
+
+// xorshift32, the same sequence for the same seed on every run
+uint32_t NavigationBenchmark::random(uint32_t bound)
+{
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return bound ? state % bound : 0;
+}
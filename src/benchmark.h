@@ -0,0 +1,45 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <FS.h>
+#include "tuneinapi.h"
+#include "api/replay.h"
+
+#define BENCHMARK_STEPS 40
+#define BENCHMARK_MAX_DEPTH 6
+// chance in percent of going back up rather than into a category
+#define BENCHMARK_BACK_PERCENT 25
+// the flash cache of the benchmark's own TuneinApi, emptied after each profile
+#define BENCHMARK_CACHE_DIR "/bench"
+
+/**
+ * Walks the recorded categories through TuneinApi::LoadItems(), once per
+ * replay profile, and reports the time to menu: from asking for a page to
+ * having it, over all menus and over those that had to be fetched. The
+ * walk is random but seeded, entering recorded categories only, so every
+ * profile sees the same sequence. Each profile starts with empty caches and
+ * empty request stats, which are printed after it.
+ *
+ * The walk runs on a TuneinApi of its own, over a throwaway flash cache, so
+ * the pages the player keeps are neither read nor replaced. Writing pages to
+ * flash is left out of the time to menu, it is the cache's and not the
+ * network's or the parser's, and it depends on how full the flash is.
+ */
+class NavigationBenchmark
+{
+public:
+    NavigationBenchmark(fs::FS &);
+
+    void Run(Print &, uint32_t = 1);
+
+private:
+    fs::FS *fs;
+    uint32_t state = 1;
+
+    void walk(TuneinApi *, ReplayTransport *, uint32_t *, uint32_t *, uint16_t *, uint16_t *);
+    void report(Print &, const char *, uint32_t *, uint16_t);
+    bool pickLink(ReplayTransport *, const UIMenuList *, char *);
+    uint32_t random(uint32_t);
+};
+
+#endif
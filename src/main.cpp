@@ -4,6 +4,8 @@
 #include "main.h"
 #include "tuneinapi.h"
 #include "tuneinui.h"
+#include "benchmark.h"
+#include <SPIFFS.h>
 #include <string>
 
 const char *TAG = "main";
@@ -11,6 +13,7 @@ const char *TAG = "main";
 WiFiMulti wifiMulti;
 TuneinApi *api = new TuneinApi();
 TuneinUI *ui = new TuneinUI(api);
+RecordingTransport *recorder = NULL;
 
 // #ifdef CONTROL_JOYSTICK
 // #include "controls/joystick.h"
@@ -30,8 +33,14 @@ void setup()
     ESP_LOGI(TAG, "Starting...");
 
     ui->Init();
-    ui->SetState(UIState::WifiConnecting);
-    ui->SetProgressBar(20, "connecting to wifi");
+    api->StartWorker();
+    // the stored menu stays on screen while connecting, and usable if that fails
+    bool cached = ui->ShowCachedRoot();
+    if (!cached)
+    {
+        ui->SetState(UIState::WifiConnecting);
+        ui->SetProgressBar(20, "connecting to wifi");
+    }
 
     WiFi.setHostname(CONFIG_DEVICE_NAME);
     WiFi.mode(WIFI_STA);
@@ -43,16 +52,23 @@ void setup()
     uint8_t count = 20;
     while (count-- && (wifiMulti.run() != WL_CONNECTED))
     {
-        ui->SetProgressBar(100 - count * 4, "connecting...");
+        if (!cached)
+            ui->SetProgressBar(100 - count * 4, "connecting...");
         delay(250);
     }
 
     if (!WiFi.isConnected())
-        ui->GiveUp("Unable to connect to WiFi");
+    {
+        if (!cached)
+            ui->GiveUp("Unable to connect to WiFi");
+        ESP_LOGW(TAG, "Unable to connect to WiFi, browsing the stored pages");
+        return;
+    }
 
     // MDNS.addService("http", "tcp", 80);
 
-    ui->SetState(UIState::InfoScreen);
+    if (!cached)
+        ui->SetState(UIState::InfoScreen);
 
     ui->SetState(UIState::Root);
     // // if (api->HaveRefreshToken())
@@ -84,6 +100,38 @@ void loop()
 
     ui->Loop();
 
+    // serial console: 's' dumps the request timings, 'r' starts and stops
+    // recording the responses, 'b' replays them in the navigation benchmark;
+    // 'k' and 'j' move the cursor up and down, 'l' opens or closes the
+    // section under it or opens the category, 'h' goes back
+    switch (Serial.available() ? Serial.read() : -1)
+    {
+    case 'k':
+        ui->ControlEvent(KEY_UP);
+        break;
+    case 'j':
+        ui->ControlEvent(KEY_DOWN);
+        break;
+    case 'l':
+        ui->ControlEvent(KEY_RIGHT);
+        break;
+    case 'h':
+        ui->ControlEvent(KEY_LEFT);
+        break;
+    case 's':
+        api->DumpStats(Serial);
+        break;
+    case 'r':
+        if (recorder == NULL)
+            recorder = new RecordingTransport(api->Network(), SPIFFS);
+        api->SetTransport(api->Transport() == recorder ? NULL : recorder);
+        Serial.printf("recording %s, %u responses so far\n", api->Transport() == recorder ? "on" : "off", recorder->recorded);
+        break;
+    case 'b':
+        NavigationBenchmark(SPIFFS).Run(Serial);
+        break;
+    }
+
     // temp++;
 
     if (count++ % 50 == 0)
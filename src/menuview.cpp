@@ -0,0 +1,153 @@
+#include "menuview.h"
+
+UIMenuView::UIMenuView(TuneinApi *_api)
+{
+    this->api = _api;
+}
+
+UIMenuView::~UIMenuView()
+{
+    Clear();
+}
+
+void UIMenuView::Clear()
+{
+    if (items != NULL)
+        items->Release();
+    items = NULL;
+    first = 0;
+    total = 0;
+    tree.Clear();
+    selected = 0;
+    top = 0;
+}
+
+void UIMenuView::Show(String _id, UIMenuList *page, uint16_t item, bool complete, bool continued)
+{
+    if (items != NULL)
+        items->Release();
+    this->id = _id;
+    this->items = page;
+    this->first = 0;
+    this->total = page->Count();
+    // the sections opened on the first items stay open
+    if (!tree.Build(page, continued))
+        ESP_LOGW(TAG, "no memory for the sections, showing them flat");
+
+    if (item >= total)
+        item = 0;
+    // a long page is only held around the cursor, the rest stays in flash
+    // and is read in windows from now on, so it has to stay as it is
+    if (complete && total > UI_MENU_WINDOW)
+    {
+        api->PinWindowedPage(id);
+        moveWindow(tree.RowOf(item), true);
+    }
+    else
+    {
+        api->UnpinWindowedPage();
+    }
+
+    if (!continued)
+        top = 0;
+    selected = tree.RowOf(item);
+    Select(selected);
+}
+
+void UIMenuView::Select(uint16_t row)
+{
+    selected = row;
+
+    // scroll just enough to have the selection on screen
+    if (row < top)
+        top = row;
+    else if (row >= top + UI_MENU_ROWS)
+        top = row - UI_MENU_ROWS + 1;
+
+    if (items != NULL && items->Count() < total)
+        moveWindow(row);
+
+    // categories are likely to be entered next, have them loaded by then
+    uint16_t index;
+    if (Held(row, &index) && items->Type(index) == LINK)
+        api->Prefetch(items->Id(index));
+    else
+        api->Prefetch(NULL);
+}
+
+/**
+ * Expand or collapse the section on a row. Its items are part of the page
+ * already (or of its copy in flash), nothing is fetched.
+ */
+bool UIMenuView::Toggle(uint16_t row)
+{
+    if (items == NULL || !tree.Toggle(tree.ItemAt(row)))
+        return false;
+
+    // the rows below the section changed, a window holds what was on them
+    if (items->Count() < total)
+        moveWindow(row, true);
+    Select(row);
+    return true;
+}
+
+/**
+ * Make sure the rows within a screenful of the given one are held, reading a
+ * new window around it from the flash cache when they are not. A window holds
+ * the items of consecutive rows, so collapsed sections leave no gaps in it.
+ */
+bool UIMenuView::moveWindow(uint16_t row, bool reload)
+{
+    if (items == NULL || total <= UI_MENU_WINDOW)
+        return true;
+
+    uint16_t rows = tree.Rows(total);
+    uint16_t from = (row > UI_MENU_ROWS) ? row - UI_MENU_ROWS : 0;
+    uint16_t to = (row + UI_MENU_ROWS < rows) ? row + UI_MENU_ROWS : rows;
+    bool windowed = items->Count() < total;
+    if (!reload && windowed && from >= first && to <= first + items->Count())
+        return true;
+
+    uint16_t count = (rows < UI_MENU_WINDOW) ? rows : UI_MENU_WINDOW;
+    uint16_t start = (row > UI_MENU_WINDOW / 2) ? row - UI_MENU_WINDOW / 2 : 0;
+    if (start + count > rows)
+        start = rows - count;
+    uint16_t indices[UI_MENU_WINDOW];
+    for (uint16_t i = 0; i < count; i++)
+        indices[i] = tree.ItemAt(start + i);
+
+    uint16_t stored;
+    UIMenuList *window = api->LoadItemsAt(id, indices, count, &stored);
+    if (window == NULL || stored != total)
+    {
+        ESP_LOGW(TAG, "no window at row %d of %s, keeping %d items", start, id.c_str(), items->Count());
+        if (window != NULL)
+            window->Release();
+        return false;
+    }
+
+    items->Release();
+    items = window;
+    first = start;
+    return true;
+}
+
+/**
+ * A window of a long page holds rows, a whole page holds its items
+ */
+bool UIMenuView::Held(uint16_t row, uint16_t *index) const
+{
+    if (items == NULL)
+        return false;
+    if (items->Count() < total)
+    {
+        if (row < first)
+            return false;
+        *index = row - first;
+    }
+    else
+    {
+        *index = tree.ItemAt(row);
+    }
+    return *index < items->Count();
+}
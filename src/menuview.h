@@ -0,0 +1,65 @@
+#ifndef MENUVIEW_H
+#define MENUVIEW_H
+
+#include "api/menutree.h"
+#include "tuneinapi.h"
+
+// item rows below the header line
+#define UI_MENU_ROWS 8
+// items held of a long page: the visible rows and a screenful either side
+#define UI_MENU_WINDOW (3 * UI_MENU_ROWS)
+
+/**
+ * The page on screen and the cursor on it, without the drawing: which rows
+ * are visible, which sections are expanded, and for a long page the window
+ * of rows held around the cursor. Moving the cursor reads a new window from
+ * the flash cache when it gets near the edge of the one held, and has the
+ * category under it prefetched.
+ */
+class UIMenuView
+{
+public:
+    UIMenuView(TuneinApi *);
+    ~UIMenuView();
+
+    // take a page with the cursor on one of its items, scrolled to the top
+    // unless it 'continued' the one shown, whose sections then stay as they
+    // were; a long page that is 'complete' is held as a window from then on
+    // and has to stay in the flash cache as it is
+    void Show(String, UIMenuList *, uint16_t, bool, bool = false);
+    void Clear();
+
+    void Select(uint16_t);
+    // expand or collapse the section on a row
+    bool Toggle(uint16_t);
+    // where the item on a row is among those held, false if it is not
+    bool Held(uint16_t, uint16_t *) const;
+
+    const UIMenuList *Items() const { return items; }
+    const String &Id() const { return id; }
+    const UIMenuTree &Tree() const { return tree; }
+    uint16_t Total() const { return total; }
+    uint16_t Rows() const { return tree.Rows(total); }
+    uint16_t First() const { return first; } // first row held of a long page
+    uint16_t Selected() const { return selected; }
+    uint16_t Top() const { return top; } // first row on screen
+
+private:
+    TuneinApi *api;
+    const char *TAG = "view";
+
+    UIMenuList *items = NULL; // the whole page, or the rows around the cursor of a long one
+    String id;
+    uint16_t first = 0;
+    uint16_t total = 0;
+    UIMenuTree tree; // sections of the page, selected and top are rows of it
+    uint16_t selected = 0;
+    uint16_t top = 0;
+
+    bool moveWindow(uint16_t, bool = false);
+
+    UIMenuView(const UIMenuView &);
+    UIMenuView &operator=(const UIMenuView &);
+};
+
+#endif
@@ -1,15 +1,29 @@
 #include "tuneinapi.h"
+#include <SPIFFS.h>
+#include <WiFi.h>
 // #include <base64.h>
 // #include <EEPROM.h>
 // #include <SPIFFS.h>
 // #include <ArduinoJson.h>
 
-TuneinApi::TuneinApi()
+static bool resolveHost(const char *host, uint32_t *address)
+{
+    IPAddress ip;
+    if (WiFi.hostByName(host, ip) != 1)
+        return false;
+    *address = (uint32_t)ip;
+    return true;
+}
+
+TuneinApi::TuneinApi(const char *flash_dir) : cache(API_CACHE_BUDGET, API_CACHE_TTL_MS),
+                                             flash(SPIFFS, API_FLASH_CACHE_BUDGET, API_FLASH_CACHE_MAX_PAGES, API_FLASH_CACHE_TTL, flash_dir),
+                                             http(API_HOST_NAME, API_PORT, resolveHost, API_DNS_TTL_MS)
 {
     // this->server = new AsyncWebServer(port);
     // this->events = new AsyncEventSource("/events");
     // this->ui = _ui;
     // this->client.setInsecure(); // shouldn't do this
+    this->transport = &http;
 }
 
 // void TuneinApi::Init()
@@ -36,100 +50,904 @@ TuneinApi::TuneinApi()
 //     }
 // }
 
-UIMenuItem *TuneinApi::LoadItems(String categoryId, uint16_t *length)
+/**
+ * Stream sink handing the HTTP body to the OPML parser chunk by chunk,
+ * so the response never has to be held in memory as a whole
+ */
+class OpmlParserStream : public Stream
+{
+public:
+    OpmlParserStream(OPMLStreamParser *_parser) : parser(_parser) {}
+
+    size_t write(uint8_t c) override
+    {
+        return write(&c, 1);
+    }
+
+    size_t write(const uint8_t *buffer, size_t size) override
+    {
+        // a short write makes HTTPClient abort the transfer, there is no
+        // point in downloading the rest once the parser gave up or was stopped
+        uint32_t started = micros();
+        bool fed = parser->Feed((const char *)buffer, size) == OPML_SUCCESS && !parser->Stopped();
+        elapsed += micros() - started;
+        return fed ? size : 0;
+    }
+
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+    void flush() override {}
+
+    // microseconds spent parsing
+    uint32_t elapsed = 0;
+
+private:
+    OPMLStreamParser *parser;
+};
+
+/**
+ * Handler in front of another one, adding up the time spent in it: the
+ * extraction of the menu items, as opposed to the parsing around it
+ */
+class TimedHandler : public OPMLStreamHandler
 {
+public:
+    TimedHandler(OPMLStreamHandler *_handler) : handler(_handler) {}
+
+    bool StartElement(const char *name, const OPMLStreamAttribute *attributes, int count, int depth) override
+    {
+        uint32_t started = micros();
+        bool more = handler->StartElement(name, attributes, count, depth);
+        elapsed += micros() - started;
+        return more;
+    }
+
+    bool EndElement(const char *name, int depth) override
+    {
+        uint32_t started = micros();
+        bool more = handler->EndElement(name, depth);
+        elapsed += micros() - started;
+        return more;
+    }
+
+    // microseconds spent in the handler
+    uint32_t elapsed = 0;
+
+private:
+    OPMLStreamHandler *handler;
+};
+
+UIMenuList *TuneinApi::LoadItems(String categoryId)
+{
+    client_result result;
+    return loadItems(categoryId.c_str(), &result, NULL);
+}
+
+/**
+ * Load a page from the memory cache, or else from the network. A copy in
+ * flash, or one in memory past its time to live, is revalidated rather than
+ * downloaded again, and for a request of the UI it is shown right away
+ * (stale while revalidating): the current page follows, unless the server
+ * says the copy is current, in which case it is delivered again as such.
+ */
+UIMenuList *TuneinApi::loadItems(const char *categoryId, client_result *result, volatile bool *cancelled, BrowseRequest *request)
+{
+    bool expired = false;
+    UIMenuList *cached = cacheGet(categoryId, &expired);
+    if (cached != NULL && !expired)
+    {
+        ESP_LOGD(TAG, "%s served from cache", categoryId);
+        LogCacheStats();
+        *result = OPML_OK;
+        return cached;
+    }
+
+    PageValidators validators = {};
+    bool stored = flashValidators(categoryId, &validators);
+    bool waited_for = (request != NULL && !request->prefetch);
+    // kept in case of a 304 or a failure, and shown meanwhile to the UI
+    UIMenuList *shown = cached;
+    if (shown != NULL)
+    {
+        ESP_LOGD(TAG, "%s in cache, revalidating", categoryId);
+        if (waited_for)
+        {
+            shown->Retain();
+            post(request, shown, OPML_STALE);
+        }
+    }
+    else if (stored && waited_for)
+    {
+        bool stale;
+        shown = flashLoad(categoryId, &stale);
+        if (shown != NULL)
+        {
+            ESP_LOGD(TAG, "%s shown from flash while revalidating", categoryId);
+            shown->Retain(); // one for Poll() to hand out, one kept in case of a 304
+            post(request, shown, OPML_STALE);
+        }
+    }
+
     char url[API_MAX_URL_LEN];
-    snprintf(url, sizeof(url), "%s/Browse.ashx?id=%s", API_HOST, categoryId);
-    OPMLDocument doc;
-    auto err = TuneinApi::LoadOpml(url, &doc);
-    if (err != OPML_OK)
+    BrowseUrl(categoryId, url, sizeof(url));
+    UIMenuList *items = new UIMenuList();
+    OutlineCollector collector(items, cancelled);
+    collector.Accept(API_STREAM_FORMATS, API_MAX_BITRATE);
+#if API_SORT_STATIONS
+    collector.OrderBy(OutlineCollector::ByReliability);
+#endif
+    FirstItems first_items = {this, request};
+    // the stored page is on screen already, a screenful of the new one would replace it
+    if (request != NULL && !request->prefetch && shown == NULL)
+        collector.OnFirstItems(API_FIRST_ITEMS, onFirstItems, &first_items);
+    *result = TuneinApi::LoadOpml(url, &collector, &validators);
+    if (cancelled != NULL && *cancelled)
     {
-        ESP_LOGE(TAG, "Error loading categories: %d", err);
+        ESP_LOGD(TAG, "%s cancelled", categoryId);
+        items->Release();
+        if (shown != NULL)
+            shown->Release();
+        *result = REQUEST_CANCELLED;
         return NULL;
     }
-    else
+
+    if (*result == OPML_NOT_MODIFIED)
     {
-        OPMLNode *root = doc.FirstChildElement("opml");
-        if (root == NULL)
+        items->Release();
+        not_modified++;
+        flashTouch(categoryId);
+        if (shown == NULL)
         {
-            ESP_LOGE(TAG, "Err: root is null");
-            return NULL;
+            bool stale;
+            shown = flashLoad(categoryId, &stale);
         }
+        // the copy may have been evicted since it was validated
+        *result = (shown != NULL) ? OPML_OK : HTTP_FAILED;
+        if (shown != NULL && shown->MemoryUsage() <= API_MAX_CACHED_PAGE)
+            cachePut(categoryId, shown);
+        ESP_LOGD(TAG, "%s not modified", categoryId);
+        LogCacheStats();
+        return shown;
+    }
 
-        OPMLNode *body = root->FirstChildElement("body");
-        if (body == NULL)
+    if (*result != OPML_OK || collector.out_of_memory)
+    {
+        ESP_LOGE(TAG, "Error loading categories: %d", *result);
+        items->Release();
+        // the stored page is on screen already and stays there
+        if (shown != NULL && waited_for)
         {
-            ESP_LOGE(TAG, "Err: body is null");
+            shown->Release();
             return NULL;
         }
+        if (shown != NULL)
+            return shown;
+
+        // an outdated page is better than none while the network is down
+        bool stale;
+        return flashLoad(categoryId, &stale);
+    }
+
+    if (shown != NULL)
+        shown->Release();
+    items->Shrink();
+    ESP_LOGD(TAG, "%d elements found in the document, %d stations left out, %u bytes", items->Count(), collector.dropped, (unsigned)items->MemoryUsage());
+    // a long page would crowd out many short ones, it is read back from flash in windows
+    if (!flashStore(categoryId, items, &validators) || items->MemoryUsage() <= API_MAX_CACHED_PAGE)
+        cachePut(categoryId, items);
+    LogCacheStats();
+    return items;
+}
+
+/**
+ * Load a page from the memory or flash cache only, never touching the network.
+ * Used to draw the menu on a cold boot before Wi-Fi is up.
+ */
+UIMenuList *TuneinApi::LoadCachedItems(String categoryId)
+{
+    UIMenuList *page = cacheGet(categoryId.c_str());
+    if (page != NULL)
+        return page;
+
+    bool stale = true;
+    page = flashLoad(categoryId.c_str(), &stale);
+    // stale pages stay out of the memory cache so the next LoadItems refreshes them
+    if (page != NULL && !stale)
+        cachePut(categoryId.c_str(), page);
+    return page;
+}
+
+/**
+ * Load items [first, first + count) of a page stored in flash, so that a long
+ * page costs memory for what is on screen rather than for all of it. The
+ * length of the whole page goes to total.
+ */
+UIMenuList *TuneinApi::LoadItemsWindow(String categoryId, uint16_t first, uint16_t count, uint16_t *total)
+{
+    if (flash_lock != NULL)
+        xSemaphoreTake(flash_lock, portMAX_DELAY);
+    UIMenuList *page = flash.LoadWindow(categoryId.c_str(), first, count, total);
+    if (flash_lock != NULL)
+        xSemaphoreGive(flash_lock);
+    return page;
+}
+
+/**
+ * Load the items at the given ascending indices of a page stored in flash,
+ * e.g. the rows on screen when collapsed sections leave gaps between them
+ */
+UIMenuList *TuneinApi::LoadItemsAt(String categoryId, const uint16_t *indices, uint16_t count, uint16_t *total)
+{
+    if (flash_lock != NULL)
+        xSemaphoreTake(flash_lock, portMAX_DELAY);
+    UIMenuList *page = flash.LoadItems(categoryId.c_str(), indices, count, total);
+    if (flash_lock != NULL)
+        xSemaphoreGive(flash_lock);
+    return page;
+}
+
+/**
+ * Keep the stored page the UI reads windows of from being evicted or
+ * replaced under it, the windows would no longer match what it has shown.
+ * A newer copy stored meanwhile takes its place once the page is unpinned.
+ */
+void TuneinApi::PinWindowedPage(String categoryId)
+{
+    if (flash_lock != NULL)
+        xSemaphoreTake(flash_lock, portMAX_DELAY);
+    flash.Pin(categoryId.c_str());
+    if (flash_lock != NULL)
+        xSemaphoreGive(flash_lock);
+}
+
+void TuneinApi::UnpinWindowedPage()
+{
+    if (flash_lock != NULL)
+        xSemaphoreTake(flash_lock, portMAX_DELAY);
+    flash.Unpin();
+    if (flash_lock != NULL)
+        xSemaphoreGive(flash_lock);
+}
+
+// the page cache is shared by the worker task and the UI task
+UIMenuList *TuneinApi::cacheGet(const char *key, bool *stale)
+{
+    if (lock != NULL)
+        xSemaphoreTake(lock, portMAX_DELAY);
+    UIMenuList *page = cache.Get(key, millis(), stale);
+    if (lock != NULL)
+        xSemaphoreGive(lock);
+    return page;
+}
+
+bool TuneinApi::cacheContains(const char *key)
+{
+    if (lock != NULL)
+        xSemaphoreTake(lock, portMAX_DELAY);
+    bool found = cache.Contains(key);
+    if (lock != NULL)
+        xSemaphoreGive(lock);
+    return found;
+}
+
+void TuneinApi::cachePut(const char *key, UIMenuList *page)
+{
+    if (lock != NULL)
+        xSemaphoreTake(lock, portMAX_DELAY);
+    cache.Put(key, page, millis());
+    if (lock != NULL)
+        xSemaphoreGive(lock);
+}
+
+// the flash cache is shared by the worker, storing pages, and the UI task,
+// reading windows of them; it has a lock of its own so that the UI is not
+// held up by the page cache's while the worker writes to flash
+UIMenuList *TuneinApi::flashLoad(const char *key, bool *stale)
+{
+    if (flash_lock != NULL)
+        xSemaphoreTake(flash_lock, portMAX_DELAY);
+    UIMenuList *page = flash.Load(key, stale);
+    if (flash_lock != NULL)
+        xSemaphoreGive(flash_lock);
+    return page;
+}
+
+bool TuneinApi::flashValidators(const char *key, PageValidators *validators)
+{
+    if (flash_lock != NULL)
+        xSemaphoreTake(flash_lock, portMAX_DELAY);
+    bool found = flash.Validators(key, validators);
+    if (flash_lock != NULL)
+        xSemaphoreGive(flash_lock);
+    return found;
+}
+
+bool TuneinApi::flashTouch(const char *key)
+{
+    if (flash_lock != NULL)
+        xSemaphoreTake(flash_lock, portMAX_DELAY);
+    uint32_t started = micros();
+    bool touched = flash.Touch(key);
+    flash_write_us += micros() - started;
+    if (flash_lock != NULL)
+        xSemaphoreGive(flash_lock);
+    return touched;
+}
+
+bool TuneinApi::flashStore(const char *key, const UIMenuList *page, const PageValidators *validators)
+{
+    if (flash_lock != NULL)
+        xSemaphoreTake(flash_lock, portMAX_DELAY);
+    uint32_t started = micros();
+    bool stored = flash.Store(key, page, validators);
+    flash_write_us += micros() - started;
+    if (flash_lock != NULL)
+        xSemaphoreGive(flash_lock);
+    return stored;
+}
+
+/**
+ * Start the task serving LoadItemsAsync() requests
+ */
+void TuneinApi::StartWorker()
+{
+    if (worker_task != NULL)
+        return;
+
+    memset(pending, 0, sizeof(pending));
+    lock = xSemaphoreCreateMutex();
+    flash_lock = xSemaphoreCreateMutex();
+    requests = xQueueCreate(API_MAX_PENDING, sizeof(BrowseRequest *));
+    // a request may complete twice, with its first items and with the page
+    completions = xQueueCreate(2 * API_MAX_PENDING, sizeof(BrowseRequest *));
+    xTaskCreatePinnedToCore(worker, "tunein-api", API_WORKER_STACK, this, API_WORKER_PRIORITY, &worker_task, API_WORKER_CORE);
+}
+
+void TuneinApi::worker(void *arg)
+{
+    TuneinApi *api = (TuneinApi *)arg;
+    BrowseRequest *request;
+
+    while (true)
+    {
+        // idle time goes to renewing the API host's address before it expires
+        uint32_t refresh_in = api->http.hosts.RefreshIn(millis());
+        TickType_t wait = refresh_in == UINT32_MAX ? portMAX_DELAY : pdMS_TO_TICKS(refresh_in);
+        if (xQueueReceive(api->requests, &request, wait) != pdTRUE)
+        {
+            api->http.hosts.Refresh(millis());
+            continue;
+        }
 
-        uint16_t count = 0;
-        for (OPMLElement *cat = body->FirstChildElement("outline"); cat; cat = cat->NextSiblingElement("outline"))
+        if (request->cancelled)
         {
-            count++;
+            request->result = REQUEST_CANCELLED;
+            request->page = NULL;
         }
+        else
+        {
+            request->page = api->loadItems(request->id, &request->result, &request->cancelled, request);
+        }
+        xQueueSend(api->completions, &request, portMAX_DELAY);
+    }
+}
 
-        ESP_LOGD(TAG, "%d elements found in the document", count);
+/**
+ * Runs on the worker while a page is being parsed: hands a copy of its first
+ * items to Poll(), those settled so the page completes without moving them,
+ * the page itself keeps growing
+ */
+void TuneinApi::onFirstItems(const UIMenuList *items, uint16_t settled, void *arg)
+{
+    FirstItems *first_items = (FirstItems *)arg;
+    BrowseRequest *request = first_items->request;
+    if (request->cancelled || request->prefetch)
+        return;
+
+    UIMenuList *copy = items->Copy(settled);
+    if (copy != NULL)
+        first_items->api->post(request, copy, OPML_PARTIAL);
+}
 
-        UIMenuItem *result = (UIMenuItem *)alloc(sizeof(UIMenuItem) * count);
+/**
+ * Runs on the worker: hands a page to Poll() ahead of the one the request
+ * completes with. Poll() takes the reference.
+ */
+void TuneinApi::post(BrowseRequest *request, UIMenuList *page, client_result result)
+{
+    request->partial = page;
+    request->partial_result = result;
+    xQueueSend(completions, &request, portMAX_DELAY);
+}
 
-        count = 0;
-        for (OPMLElement *cat = body->FirstChildElement("outline"); cat; count++, cat = cat->NextSiblingElement("outline"))
+/**
+ * Queue a category for loading. The callback is invoked from Poll() once the
+ * page is there, unless the request got cancelled in the meantime. A request
+ * for a page that is being fetched already waits for that fetch.
+ * Returns 0 if the request could not be queued.
+ */
+request_handle TuneinApi::LoadItemsAsync(String categoryId, browse_callback callback, void *arg)
+{
+    // the user wants what is being prefetched: adopt the request rather than start over
+    request_handle adopted = 0;
+    if (lock != NULL)
+        xSemaphoreTake(lock, portMAX_DELAY);
+    for (uint8_t i = 0; i < API_MAX_PENDING && adopted == 0; i++)
+    {
+        BrowseRequest *request = &pending[i];
+        if (request->handle != 0 && request->handle == prefetch_request && !request->cancelled &&
+            strcmp(request->id, categoryId.c_str()) == 0)
         {
-            auto type_s = cat->Attribute("type");
-            auto type = (strcmp(type_s, "link") == 0) ? LINK : ((strcmp(type_s, "audio") == 0) ? AUDIO : UNKNOWN);
-            result[count] = (UIMenuItem){
-                .type = type
-            };
-            strcpy(result[count].id, cat->Attribute("guide_id"));
-            strcpy(result[count].text, cat->Attribute("text"));
-            strcpy(result[count].url, cat->Attribute("URL"));
+            request->callback = callback;
+            request->arg = arg;
+            request->prefetch = false;
+            adopted = request->handle;
         }
+    }
+    if (lock != NULL)
+        xSemaphoreGive(lock);
+    if (adopted != 0)
+    {
+        prefetch_request = 0;
+        return adopted;
+    }
 
-        *length = count;
+    // a prefetch would hold the connection the user is waiting for
+    Cancel(prefetch_request);
+    prefetch_request = 0;
+    return enqueue(categoryId.c_str(), callback, arg, false);
+}
+
+request_handle TuneinApi::enqueue(const char *categoryId, browse_callback callback, void *arg, bool prefetch)
+{
+    if (worker_task == NULL || strlen(categoryId) >= API_MAX_ID_LEN)
+        return 0;
 
-        return result;
+    xSemaphoreTake(lock, portMAX_DELAY);
+    BrowseRequest *request = NULL;
+    for (uint8_t i = 0; i < API_MAX_PENDING; i++)
+    {
+        if (pending[i].handle == 0)
+        {
+            request = &pending[i];
+            break;
+        }
+    }
+    if (request == NULL)
+    {
+        xSemaphoreGive(lock);
+        ESP_LOGW(TAG, "too many pending requests, %s rejected", categoryId);
+        return 0;
+    }
+
+    // the URL is made of the id alone, the same id is the same fetch
+    BrowseRequest *leader = NULL;
+    for (uint8_t i = 0; i < API_MAX_PENDING; i++)
+    {
+        if (pending[i].handle != 0 && pending[i].leader == NULL && !pending[i].cancelled &&
+            strcmp(pending[i].id, categoryId) == 0)
+        {
+            leader = &pending[i];
+            break;
+        }
+    }
+
+    if (++last_handle == 0)
+        last_handle = 1;
+    request->handle = last_handle;
+    strlcpy(request->id, categoryId, sizeof(request->id));
+    request->callback = callback;
+    request->arg = arg;
+    request->cancelled = false;
+    request->detached = false;
+    request->prefetch = prefetch;
+    request->leader = leader;
+    request->result = UNDEFINED;
+    request->page = NULL;
+    request->partial = NULL;
+    xSemaphoreGive(lock);
+
+    if (leader != NULL)
+    {
+        // Poll() hands it what the leader gets
+        coalesced++;
+        ESP_LOGD(TAG, "%s is being loaded already, request %u waits for %u", categoryId, request->handle, leader->handle);
+        return request->handle;
+    }
+
+    // cannot block, the queue is as long as the pending table
+    fetches++;
+    xQueueSend(requests, &request, 0);
+    return request->handle;
+}
+
+bool TuneinApi::waitedFor(const BrowseRequest *leader)
+{
+    if (!leader->detached)
+        return true;
+    for (uint8_t i = 0; i < API_MAX_PENDING; i++)
+    {
+        if (pending[i].handle != 0 && pending[i].leader == leader && !pending[i].detached)
+            return true;
+    }
+    return false;
+}
+
+void TuneinApi::Cancel(request_handle handle)
+{
+    if (handle == 0 || lock == NULL)
+        return;
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+    for (uint8_t i = 0; i < API_MAX_PENDING; i++)
+    {
+        BrowseRequest *request = &pending[i];
+        if (request->handle != handle)
+            continue;
+
+        request->detached = true;
+        // a shared fetch goes on as long as one of its requests waits for it
+        BrowseRequest *leader = (request->leader != NULL) ? request->leader : request;
+        if (!waitedFor(leader))
+            leader->cancelled = true;
     }
+    xSemaphoreGive(lock);
 }
 
-client_result TuneinApi::LoadOpml(const char *url, OPMLDocument *doc)
+/**
+ * Hand a page to the leader and all requests sharing its fetch, each with a
+ * reference of its own, unless they were cancelled or are prefetches
+ */
+void TuneinApi::deliver(BrowseRequest *leader, client_result result, UIMenuList *page)
+{
+    BrowseRequest *waiting[API_MAX_PENDING];
+    uint8_t count = 0;
+    for (uint8_t i = 0; i < API_MAX_PENDING; i++)
+    {
+        BrowseRequest *request = &pending[i];
+        if (request->handle == 0 || (request != leader && request->leader != leader))
+            continue;
+        if (!request->detached && !request->prefetch)
+            waiting[count++] = request;
+    }
+
+    if (page != NULL)
+    {
+        // before any callback, one of them may release its page right away
+        for (uint8_t i = 1; i < count; i++)
+            page->Retain();
+        if (count == 0)
+            page->Release();
+    }
+    for (uint8_t i = 0; i < count; i++)
+        waiting[i]->callback(waiting[i]->handle, result, page, waiting[i]->arg);
+}
+
+/**
+ * Deliver completed requests, to be called from the UI loop
+ */
+void TuneinApi::Poll()
+{
+    if (completions == NULL)
+        return;
+
+    BrowseRequest *request;
+    while (xQueueReceive(completions, &request, 0) == pdTRUE)
+    {
+        if (request->partial != NULL)
+        {
+            // the request goes on, only its first items are there
+            UIMenuList *partial = request->partial;
+            request->partial = NULL;
+            deliver(request, request->partial_result, partial);
+            continue;
+        }
+
+        // a prefetched page is already in the cache, that was the point
+        deliver(request, request->result, request->page);
+
+        xSemaphoreTake(lock, portMAX_DELAY);
+        for (uint8_t i = 0; i < API_MAX_PENDING; i++)
+        {
+            BrowseRequest *done = &pending[i];
+            if (done->handle == 0 || (done != request && done->leader != request))
+                continue;
+            if (done->handle == prefetch_request)
+                prefetch_request = 0;
+            done->handle = 0;
+            done->leader = NULL;
+        }
+        xSemaphoreGive(lock);
+    }
+
+    schedulePrefetch();
+}
+
+/**
+ * Tell the API which category the cursor rests on. Once it stayed there for
+ * the dwell time and nothing else is loading, its page is fetched into the
+ * cache so that entering it is instant. Pass NULL when nothing is selectable.
+ */
+void TuneinApi::Prefetch(const char *categoryId)
+{
+    if (categoryId == NULL)
+        categoryId = "";
+    if (strcmp(categoryId, prefetch_id) == 0)
+        return;
+    for (uint8_t i = 0; i < API_MAX_PENDING; i++)
+    {
+        if (prefetch_request != 0 && pending[i].handle == prefetch_request && strcmp(pending[i].id, categoryId) == 0)
+            return;
+    }
+
+    // the cursor moved on, whatever was prefetched for the old entry is stale
+    Cancel(prefetch_request);
+    prefetch_request = 0;
+
+    if (strlen(categoryId) >= API_MAX_ID_LEN)
+        categoryId = "";
+    strlcpy(prefetch_id, categoryId, sizeof(prefetch_id));
+    prefetch_since = millis();
+}
+
+void TuneinApi::SetPrefetchDwell(uint32_t dwell_ms)
+{
+    this->prefetch_dwell = dwell_ms;
+}
+
+void TuneinApi::schedulePrefetch()
+{
+    if (prefetch_dwell == 0 || prefetch_id[0] == 0 || prefetch_request != 0)
+        return;
+    if (millis() - prefetch_since < prefetch_dwell)
+        return;
+
+    // lowest priority: only when no request is waiting
+    for (uint8_t i = 0; i < API_MAX_PENDING; i++)
+    {
+        if (pending[i].handle != 0)
+            return;
+    }
+
+    if (!cacheContains(prefetch_id))
+    {
+        ESP_LOGD(TAG, "prefetching %s", prefetch_id);
+        prefetch_request = enqueue(prefetch_id, NULL, NULL, true);
+    }
+    // either way this entry is done, until the cursor comes back to it
+    prefetch_id[0] = 0;
+}
+
+void TuneinApi::LogCacheStats()
+{
+    ESP_LOGI(TAG, "cache: %u hits, %u stale, %u misses, %u evictions, %u pages, %u/%u bytes",
+             cache.hits, cache.stale, cache.misses, cache.evictions, cache.Count(),
+             (unsigned)cache.Size(), (unsigned)cache.Budget());
+    ESP_LOGI(TAG, "requests: %u fetched, %u coalesced, %u not modified", fetches, coalesced, not_modified);
+    ESP_LOGI(TAG, "dns: %u hits, %u misses, %u refreshes, %u failures, %u fallbacks",
+             http.hosts.hits, http.hosts.misses, http.hosts.refreshes, http.hosts.failures, http.hosts.fallbacks);
+    ESP_LOGI(TAG, "connections: %u, %u ms resolving, %u ms connecting", http.connections,
+             (unsigned)(stats.Get(FETCH_DNS).Sum() / 1000), (unsigned)(stats.Get(FETCH_CONNECT).Sum() / 1000));
+}
+
+/**
+ * Prints a line per metric: how many requests measured it, p50, p95, max
+ * and mean, then its non-empty buckets as "floor:count"
+ */
+void TuneinApi::DumpStats(Print &out)
+{
+    out.printf("%u requests\n", stats.Requests());
+    out.printf("%-9s %6s %9s %9s %9s %9s\n", "metric", "count", "p50", "p95", "max", "mean");
+    for (uint8_t i = 0; i < FETCH_METRICS; i++)
+    {
+        FetchMetric metric = (FetchMetric)i;
+        const Histogram &h = stats.Get(metric);
+        out.printf("%-9s %6u %9u %9u %9u %9u %s\n", FetchStats::Name(metric), h.Count(),
+                   h.Percentile(50), h.Percentile(95), h.Max(), h.Mean(), FetchStats::Unit(metric));
+        if (h.Count() == 0)
+            continue;
+
+        out.printf("         ");
+        for (uint8_t b = 0; b < HISTOGRAM_BUCKETS; b++)
+        {
+            if (h.Bucket(b) != 0)
+                out.printf(" %u:%u", Histogram::BucketFloor(b), h.Bucket(b));
+        }
+        out.printf("\n");
+    }
+}
+
+void TuneinApi::ClearStats()
+{
+    stats.Clear();
+}
+
+/**
+ * Puts a transport in place of the network, NULL goes back to it. Waits for
+ * the requests in flight, delivering them, so call it from the polling task.
+ */
+void TuneinApi::SetTransport(ApiTransport *_transport)
+{
+    Prefetch(NULL);
+    while (busy())
+    {
+        Poll();
+        delay(10);
+    }
+    this->transport = _transport != NULL ? _transport : &http;
+}
+
+void TuneinApi::ClearCache()
+{
+    if (lock != NULL)
+        xSemaphoreTake(lock, portMAX_DELAY);
+    cache.Clear();
+    if (lock != NULL)
+        xSemaphoreGive(lock);
+}
+
+void TuneinApi::SetCacheTtl(uint32_t ttl_ms)
+{
+    if (lock != NULL)
+        xSemaphoreTake(lock, portMAX_DELAY);
+    cache.SetTtl(ttl_ms);
+    if (lock != NULL)
+        xSemaphoreGive(lock);
+}
+
+void TuneinApi::ClearFlashCache()
+{
+    if (flash_lock != NULL)
+        xSemaphoreTake(flash_lock, portMAX_DELAY);
+    flash.Clear();
+    if (flash_lock != NULL)
+        xSemaphoreGive(flash_lock);
+}
+
+void TuneinApi::BrowseUrl(const char *categoryId, char *url, size_t size)
+{
+    snprintf(url, size, "%s/Browse.ashx?id=%s", API_HOST, categoryId);
+}
+
+// whether the worker has requests not delivered yet
+bool TuneinApi::busy()
+{
+    if (lock == NULL)
+        return false;
+
+    bool found = false;
+    xSemaphoreTake(lock, portMAX_DELAY);
+    for (uint8_t i = 0; i < API_MAX_PENDING && !found; i++)
+        found = pending[i].handle != 0;
+    xSemaphoreGive(lock);
+    return found;
+}
+
+/**
+ * Fetch an OPML document into the handler. With validators the request is
+ * conditional: OPML_NOT_MODIFIED means the copy they belong to is current,
+ * otherwise they are replaced by those of the new document.
+ */
+client_result TuneinApi::LoadOpml(const char *url, OPMLStreamHandler *handler, PageValidators *validators)
 {
     ESP_LOGD(TAG, "get %s", url);
 
-    client.begin(url);
-    int httpCode = client.GET();
+    client_result result = UNDEFINED;
+    FetchTimings timings = {};
+    transport->Begin(url);
+#if API_ACCEPT_GZIP
+    // in place of HTTPClient's own "identity" preference, so that servers
+    // configured to compress pick gzip
+    transport->SetAcceptEncoding("gzip, deflate");
+#endif
+    if (validators != NULL && validators->etag[0])
+        transport->AddHeader("If-None-Match", validators->etag);
+    if (validators != NULL && validators->last_modified[0])
+        transport->AddHeader("If-Modified-Since", validators->last_modified);
+    int httpCode = transport->Get(&timings);
     if (httpCode > 0)
     {
         ESP_LOGD(TAG, "[HTTP] GET... code: %d\n", httpCode);
 
         if (httpCode == HTTP_CODE_OK)
         {
-            String payload = client.getString();
-            // ESP_LOGD(TAG, "<- %s", payload.c_str());
-
-            auto err = doc->Parse(payload.c_str());
-            if (err != OPML_SUCCESS)
+            TimedHandler timed(handler);
+            OPMLStreamParser parser(&timed);
+            OpmlParserStream sink(&parser);
+
+            String encoding = transport->Header("Content-Encoding");
+            bool compressed = encoding.equalsIgnoreCase("gzip") || encoding.equalsIgnoreCase("deflate");
+            InflateStream::Format format = encoding.equalsIgnoreCase("gzip") ? InflateStream::GZIP : InflateStream::ZLIB;
+            if (compressed && !inflater.Begin(&sink, format))
             {
-                ESP_LOGE(TAG, "Error parsing opml: %d", err);
-                return OPML_PARSE_ERR;
+                ESP_LOGE(TAG, "Not enough memory to inflate the response");
+                result = HTTP_FAILED;
             }
-
-            return OPML_OK;
+            else if (!compressed && encoding.length() > 0 && !encoding.equalsIgnoreCase("identity"))
+            {
+                ESP_LOGE(TAG, "Unsupported content encoding: %s", encoding.c_str());
+                result = HTTP_FAILED;
+            }
+            else
+            {
+                uint32_t receiving = micros();
+                int written = transport->WriteToStream(compressed ? (Stream *)&inflater : (Stream *)&sink);
+                uint32_t received = micros();
+                auto err = parser.Finish();
+                uint32_t parsing = sink.elapsed + (micros() - received);
+                timings.Set(FETCH_TRANSFER, received - receiving - sink.elapsed);
+                timings.Set(FETCH_PARSE, parsing - timed.elapsed);
+                timings.Set(FETCH_EXTRACT, timed.elapsed);
+                timings.Set(FETCH_WIRE_BYTES, compressed ? inflater.BytesIn() : parser.BytesFed());
+                timings.Set(FETCH_BODY_BYTES, parser.BytesFed());
+                if (err != OPML_SUCCESS)
+                {
+                    ESP_LOGE(TAG, "Error parsing opml: %d", err);
+                    result = OPML_PARSE_ERR;
+                }
+                else if (parser.Stopped())
+                {
+                    result = REQUEST_CANCELLED;
+                }
+                else if (written < 0)
+                {
+                    ESP_LOGE(TAG, "[HTTP] read failed, error: %s\n", HTTPClient::errorToString(written).c_str());
+                    result = HTTP_FAILED;
+                }
+                else if (compressed && !inflater.Done())
+                {
+                    ESP_LOGE(TAG, "Truncated or corrupt %s body", encoding.c_str());
+                    result = HTTP_FAILED;
+                }
+                else
+                {
+                    if (compressed)
+                        ESP_LOGD(TAG, "%u bytes received, %u inflated", (unsigned)inflater.BytesIn(), (unsigned)inflater.BytesOut());
+                    ESP_LOGD(TAG, "%u bytes parsed", (unsigned)parser.BytesFed());
+                    result = OPML_OK;
+                    if (validators != NULL)
+                        keepValidators(validators);
+                }
+            }
+            if (compressed)
+                inflater.End();
+        }
+        else if (httpCode == HTTP_CODE_NOT_MODIFIED && validators != NULL)
+        {
+            result = OPML_NOT_MODIFIED;
         }
         else
         {
             ESP_LOGE(TAG, "Response code is not successful: %d", httpCode);
-            return HTTP_UNSUCCESSFUL;
+            result = HTTP_UNSUCCESSFUL;
         }
     }
     else
     {
-        ESP_LOGE(TAG, "[HTTP] GET... failed, error: %s\n", client.errorToString(httpCode).c_str());
-        return HTTP_FAILED;
+        ESP_LOGE(TAG, "[HTTP] GET... failed, error: %s\n", HTTPClient::errorToString(httpCode).c_str());
+        result = HTTP_FAILED;
     }
 
-    client.end();
-    return UNDEFINED;
+    // the connection may be mid-response or dead, never reuse it after an error
+    transport->End(result == OPML_OK || result == OPML_NOT_MODIFIED);
+    stats.Record(timings);
+    ESP_LOGD(TAG, "dns %u, connect %u, ttfb %u, transfer %u, parse %u, extract %u us, %u bytes",
+             timings.value[FETCH_DNS], timings.value[FETCH_CONNECT], timings.value[FETCH_TTFB], timings.value[FETCH_TRANSFER],
+             timings.value[FETCH_PARSE], timings.value[FETCH_EXTRACT], timings.value[FETCH_WIRE_BYTES]);
+    return result;
+}
+
+// copies the response's validators, a header too long to keep is as good as none
+void TuneinApi::keepValidators(PageValidators *validators)
+{
+    String etag = transport->Header("ETag");
+    String last_modified = transport->Header("Last-Modified");
+    memset(validators, 0, sizeof(PageValidators));
+    if (etag.length() < (int)sizeof(validators->etag))
+        strlcpy(validators->etag, etag.c_str(), sizeof(validators->etag));
+    if (last_modified.length() < (int)sizeof(validators->last_modified))
+        strlcpy(validators->last_modified, last_modified.c_str(), sizeof(validators->last_modified));
 }
 
 // /**
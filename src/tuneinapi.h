@@ -3,22 +3,78 @@
 
 #include <tinyopml.h>
 #include <WString.h>
-#include <ESPAsyncWebServer.h>
 #include <HTTPClient.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#include "api/menulist.h"
+#include "api/pagecache.h"
+#include "api/flashcache.h"
+#include "api/inflatestream.h"
+#include "api/outlinecollector.h"
+#include "api/fetchstats.h"
+#include "api/transport.h"
 
 using namespace tinyopml;
 
+#define API_HOST_NAME "opml.radiotime.com"
+#define API_HOST "http://" API_HOST_NAME
+#define API_PORT 80
+#define API_ROOT_ID "r0"
+#define API_MAX_URL_LEN 128
+
+#ifndef API_CACHE_BUDGET
 #ifdef BOARD_HAS_PSRAM
-#include "esp32-hal-psram.h"
-#define alloc ps_malloc
+#define API_CACHE_BUDGET (512 * 1024)
 #else
-#define alloc malloc
+#define API_CACHE_BUDGET (32 * 1024)
+#endif
 #endif
 
-#define API_HOST "http://opml.radiotime.com"
-#define API_PORT 80
-#define API_ROOT_ID "r0"
-#define API_MAX_URL_LEN 128
+#ifndef API_FLASH_CACHE_BUDGET
+#define API_FLASH_CACHE_BUDGET (256 * 1024)
+#endif
+#define API_FLASH_CACHE_MAX_PAGES 64
+// longer pages are kept in flash only and browsed a window at a time
+#define API_MAX_CACHED_PAGE (API_CACHE_BUDGET / 4)
+// pages in memory are shown right away for this long, then while revalidated
+#ifndef API_CACHE_TTL_MS
+#define API_CACHE_TTL_MS (10 * 60 * 1000)
+#endif
+#define API_FLASH_CACHE_TTL (24 * 60 * 60)
+
+#define API_MAX_ID_LEN 24
+#define API_MAX_PENDING 4
+#define API_WORKER_STACK 8192
+#define API_WORKER_PRIORITY 1
+// the Arduino loop (and so the UI) runs on core 1
+#define API_WORKER_CORE 0
+#define API_PREFETCH_DWELL_MS 700
+// about one screenful, shown while the rest of a page is still loading
+#define API_FIRST_ITEMS 10
+// how long a resolved address of the API host is used; the Arduino resolver
+// does not pass on the record's TTL, so this is the upper bound we accept
+#ifndef API_DNS_TTL_MS
+#define API_DNS_TTL_MS (5 * 60 * 1000)
+#endif
+
+// stations the player cannot decode or keep up with are left out of the menus
+#ifndef API_STREAM_FORMATS
+#define API_STREAM_FORMATS (FORMAT_MP3 | FORMAT_AAC)
+#endif
+#ifndef API_MAX_BITRATE
+#define API_MAX_BITRATE 320
+#endif
+// list the most reliable stations first
+#ifndef API_SORT_STATIONS
+#define API_SORT_STATIONS 1
+#endif
+
+// ask for compressed bodies, OPML shrinks to a fraction of its size
+#ifndef API_ACCEPT_GZIP
+#define API_ACCEPT_GZIP 1
+#endif
 // #define min(X, Y) (((X)<(Y))?(X):(Y))
 // #define startsWith(STR, SEARCH) (strncmp(STR, SEARCH, strlen(SEARCH)) == 0)
 
@@ -28,21 +84,6 @@ using namespace tinyopml;
 //     String payload;
 // } HTTP_response_t;
 
-enum UIMenuItemType
-{
-    LINK,
-    AUDIO,
-    UNKNOWN
-};
-
-struct UIMenuItem
-{
-    UIMenuItemType type;
-    char id[8];
-    char text[32];
-    char url[64];
-};
-
 enum client_result
 {
     UNDEFINED,
@@ -51,12 +92,43 @@ enum client_result
     HTTP_FAILED,
     OPML_PARSE_ERR,
     OPML_UNEXPECTED_STRUCTURE,
+    REQUEST_CANCELLED,
+    REQUEST_REJECTED,
+    OPML_PARTIAL,      // the first items of a page, the complete page follows
+    OPML_NOT_MODIFIED, // the stored copy is current (HTTP 304)
+    OPML_STALE,        // a stored page shown while it is revalidated, the current page follows
+};
+
+typedef uint32_t request_handle;
+
+// called from TuneinApi::Poll() on the polling task; the callee owns the page
+// reference (NULL on failure) and must Release() it. A long page may first be
+// delivered in part, with OPML_PARTIAL, or a stored page with OPML_STALE,
+// before the final call. A final NULL after OPML_STALE leaves the stale page
+// as the best there is.
+typedef void (*browse_callback)(request_handle, client_result, UIMenuList *, void *);
+
+struct BrowseRequest
+{
+    request_handle handle; // 0 while the slot is free
+    char id[API_MAX_ID_LEN];
+    browse_callback callback;
+    void *arg;
+    volatile bool cancelled; // stops the fetch, set once nobody waits for it
+    bool detached;           // the caller cancelled, others may still wait
+    volatile bool prefetch;  // speculative until the caller adopts it, nobody waits for it
+    BrowseRequest *leader;   // the request whose fetch this one shares, if any
+    client_result result;
+    UIMenuList *page;
+    UIMenuList *partial; // set by the worker until Poll() delivers it
+    client_result partial_result;
 };
 
 class TuneinApi
 {
 public:
-    TuneinApi(/*TuneinUI *ui*/);
+    // pages are kept in flash in the given directory
+    TuneinApi(const char * = FLASH_CACHE_DIR /*, TuneinUI *ui*/);
 
     // // webserver part
     // void RegisterPaths();
@@ -76,15 +148,102 @@ public:
     // void Toggle();
     // void CurrentlyPlaying();
     // void DisplayAlbumArt(String);
-    UIMenuItem *LoadItems(String, uint16_t *);
-    client_result LoadOpml(const char *, OPMLDocument *);
+    UIMenuList *LoadItems(String);
+    UIMenuList *LoadCachedItems(String);
+    UIMenuList *LoadItemsWindow(String, uint16_t, uint16_t, uint16_t *);
+    UIMenuList *LoadItemsAt(String, const uint16_t *, uint16_t, uint16_t *);
+    // the stored page read in windows stays as it is until unpinned
+    void PinWindowedPage(String);
+    void UnpinWindowedPage();
+
+    // asynchronous browsing, served by a worker task on the other core
+    void StartWorker();
+    request_handle LoadItemsAsync(String, browse_callback, void *);
+    void Cancel(request_handle);
+    void Poll();
+
+    // speculative loading of the entry under the cursor
+    void Prefetch(const char *);
+    void SetPrefetchDwell(uint32_t);
+
+    client_result LoadOpml(const char *, OPMLStreamHandler *, PageValidators * = NULL);
+    void LogCacheStats();
+
+    // timings and sizes of the requests made, recorded by the worker; a
+    // reading taken while a request completes may be off by that request
+    const FetchStats &Stats() const { return stats; }
+    void DumpStats(Print &);
+    void ClearStats();
+
+    // recorded or replayed responses instead of the network, see api/replay.h
+    void SetTransport(ApiTransport *);
+    ApiTransport *Transport() { return transport; }
+    ApiTransport *Network() { return &http; }
+    void ClearCache();
+    void ClearFlashCache();
+    // how long a page in memory is shown without revalidating it
+    void SetCacheTtl(uint32_t);
+    static void BrowseUrl(const char *, char *, size_t);
+
+    // requests handed to the worker, and requests that joined a fetch of
+    // the same URL already under way instead
+    uint32_t fetches = 0;
+    uint32_t coalesced = 0;
+    // pages the server confirmed with a 304 instead of sending them again
+    uint32_t not_modified = 0;
+    // time spent storing and touching pages in flash, in microseconds
+    uint32_t flash_write_us = 0;
 
 private:
     const char *TAG = "api";
+
+    UIMenuList *loadItems(const char *, client_result *, volatile bool *, BrowseRequest * = NULL);
+    UIMenuList *cacheGet(const char *, bool * = NULL);
+    bool cacheContains(const char *);
+    void cachePut(const char *, UIMenuList *);
+    UIMenuList *flashLoad(const char *, bool *);
+    bool flashValidators(const char *, PageValidators *);
+    bool flashTouch(const char *);
+    bool flashStore(const char *, const UIMenuList *, const PageValidators *);
+    request_handle enqueue(const char *, browse_callback, void *, bool);
+    bool waitedFor(const BrowseRequest *);
+    void deliver(BrowseRequest *, client_result, UIMenuList *);
+    void schedulePrefetch();
+    static void worker(void *);
+    struct FirstItems
+    {
+        TuneinApi *api;
+        BrowseRequest *request;
+    };
+    static void onFirstItems(const UIMenuList *, uint16_t, void *);
+    void post(BrowseRequest *, UIMenuList *, client_result);
+    void keepValidators(PageValidators *);
+    bool busy();
+
+    // guards the page cache and the pending table
+    SemaphoreHandle_t lock = NULL;
+    // guards the flash cache, apart so that a store does not hold up the UI
+    SemaphoreHandle_t flash_lock = NULL;
+    QueueHandle_t requests = NULL;
+    QueueHandle_t completions = NULL;
+    TaskHandle_t worker_task = NULL;
+    BrowseRequest pending[API_MAX_PENDING];
+    request_handle last_handle = 0;
+
+    char prefetch_id[API_MAX_ID_LEN] = {0};
+    uint32_t prefetch_since = 0;
+    uint32_t prefetch_dwell = API_PREFETCH_DWELL_MS;
+    request_handle prefetch_request = 0;
     // bool send_events = true;
 
     // TuneinUI *ui;
-    HTTPClient client;
+    PageCache cache;
+    FlashCache flash;
+    HttpTransport http;
+    ApiTransport *transport;
+    // buffers of a compressed response, kept for the next one with PSRAM only
+    InflateStream inflater;
+    FetchStats stats;
     // TuneinApi *api;
     // AsyncWebServer *server;
     // AsyncEventSource *events;
@@ -7,7 +7,7 @@
 void setLed() {}
 void op1Func() {}
 
-TuneinUI::TuneinUI(TuneinApi *_api)
+TuneinUI::TuneinUI(TuneinApi *_api) : view(_api)
 {
     this->api = _api;
 #ifdef TFT_ENABLED
@@ -206,16 +206,16 @@ void TuneinUI::SetState(UIState newState)
 
     case Root:
     {
-        this->SetProgressBar(40, "loading root");
-        // if (!loadItems(API_ROOT_ID))
-        // {
-        //     ESP_LOGE(TAG, "Error loading categories: %s", API_ROOT_ID);
-        // }
+        // a stored root on screen is replaced once the current one is there
+        if (this->view.Items() == NULL)
+            this->SetProgressBar(40, "loading root");
+        if (!loadItems(API_ROOT_ID))
+        {
+            ESP_LOGE(TAG, "Error loading categories: %s", API_ROOT_ID);
+        }
         // else
         // {
         //     this->SetProgressBar(60, "rendering root");
-        //     ESP_LOGD(TAG, "returned %d items", items_count);
-
         //     // this->UpdateMenu(count, results);
         //     this->SetProgressBar(80, "rendering menu");
         //     this->SetState(UIState::MainMenu);
@@ -237,15 +237,117 @@ void TuneinUI::SetState(UIState newState)
 
 bool TuneinUI::loadItems(String id)
 {
-    ESP_LOGD(TAG, "Loading category by id: %s", id);
-    if (this->items != NULL)
+    ESP_LOGD(TAG, "Loading category by id: %s", id.c_str());
+    // whatever was requested before is not wanted anymore
+    api->Cancel(this->items_request);
+    this->items_id = id;
+    this->items_request = api->LoadItemsAsync(id, onItemsLoaded, this);
+
+    return this->items_request != 0;
+}
+
+void TuneinUI::onItemsLoaded(request_handle handle, client_result result, UIMenuList *loaded, void *arg)
+{
+    TuneinUI *ui = (TuneinUI *)arg;
+    // a stored page shown while it is revalidated is followed by the current one
+    bool partial = (result == OPML_PARTIAL || result == OPML_STALE);
+    if (handle == ui->items_request && !partial)
+        ui->items_request = 0;
+
+    if (loaded == NULL)
     {
-        free(this->items);
+        ESP_LOGE(ui->TAG, "Error loading items: %d", result);
+        return;
     }
 
-    this->items = api->LoadItems(id, &items_count);
-    this->selected_index = 0;
+    ESP_LOGD(ui->TAG, "returned %d items%s", loaded->Count(), partial ? " so far" : "");
+    // the complete page continues the partial or stale one on screen, a
+    // fallback page from the flash cache after an error does not
+    bool continued = (ui->view.Items() != NULL && ui->items_partial == handle && result == OPML_OK);
+    uint16_t item = continued ? ui->view.Tree().ItemAt(ui->view.Selected()) : 0;
+    ui->items_partial = partial ? handle : 0;
+    ui->view.Show(ui->items_id, loaded, item, !partial, continued);
+    // even a continued page is drawn anew: sections closed and stations
+    // sorted since the first items came in move rows already on screen
+    ui->rendered = 0;
+    ui->renderMenu();
+}
 
+void TuneinUI::select(uint16_t row)
+{
+    // the cursor is drawn with the rows
+    if (row != view.Selected())
+        rendered = 0;
+    uint16_t top = view.Top();
+    view.Select(row);
+    if (view.Top() != top)
+        rendered = 0;
+}
+
+/**
+ * Expand or collapse the section on a row, or open the category on it,
+ * remembering the page on screen to go back to
+ */
+void TuneinUI::enter(uint16_t row)
+{
+    // the section's items are part of the page already, nothing is fetched
+    if (view.Toggle(row))
+    {
+        rendered = 0;
+        return;
+    }
+
+    uint16_t index;
+    if (!view.Held(row, &index))
+        return;
+    const UIMenuList *items = view.Items();
+    if (items->Type(index) != LINK)
+    {
+        ESP_LOGD(TAG, "nothing to open at row %d", row);
+        return;
+    }
+
+    if (!loadItems(items->Id(index)))
+    {
+        ESP_LOGE(TAG, "Error loading items: %s", items->Id(index));
+        return;
+    }
+
+    // the oldest page is forgotten on a long way down
+    if (trail_count == MENU_MAX_DEPTH)
+    {
+        for (uint8_t i = 1; i < MENU_MAX_DEPTH; i++)
+            trail[i - 1] = trail[i];
+        trail_count--;
+    }
+    trail[trail_count].id = view.Id();
+    trail[trail_count].title = parent;
+    trail_count++;
+    parent = items->Text(index);
+}
+
+void TuneinUI::back()
+{
+    if (trail_count == 0)
+        return;
+    trail_count--;
+    parent = trail[trail_count].title;
+    if (!loadItems(trail[trail_count].id))
+        ESP_LOGE(TAG, "Error loading items: %s", trail[trail_count].id.c_str());
+}
+
+bool TuneinUI::ShowCachedRoot()
+{
+    UIMenuList *cached = api->LoadCachedItems(API_ROOT_ID);
+    if (cached == NULL)
+        return false;
+
+    ESP_LOGD(TAG, "Showing cached root, %d items", cached->Count());
+    this->items_id = API_ROOT_ID;
+    this->items_partial = 0;
+    this->view.Show(API_ROOT_ID, cached, 0, true);
+    this->rendered = 0;
+    renderMenu();
     return true;
 }
 
@@ -300,121 +402,110 @@ String TuneinUI::prettyBytes(uint32_t bytes)
     };
 }
 
-// void TuneinUI::ControlEvent(UIControlEvent evt)
-// {
-//     bool render = false;
-
-//     switch (evt)
-//     {
-//     case KEY_UP:
-//     {
-//         if (selected_index == 0)
-//             selected_index = items_count - 1;
-//         else
-//             selected_index -= 1;
-//         render = true;
-//     }
-//     break;
-
-//     case KEY_DOWN:
-//     {
-//         if (selected_index == items_count - 1)
-//             selected_index = 0;
-//         else
-//             selected_index += 1;
-//         render = true;
-//     }
-//     break;
-
-//     case KEY_RIGHT:
-//     {
-//         ESP_LOGD(TAG, "right");
-//         auto selected = &(items[selected_index]);
-//         if (!loadItems(selected->id))
-//         {
-//             ESP_LOGE(TAG, "Error loading items: %s", selected->id);
-//         }
-//         else
-//         {
-//             // this->SetProgressBar(60, "rendering root");
-//             ESP_LOGD(TAG, "returned %d items", items_count);
-
-//             // this->UpdateMenu(count, results);
-//             //  this->SetProgressBar(80, "rendering menu");
-//             //  this->SetState(UIState::Menu);
-//             this->parent = selected;
-//         }
-//         render = true;
-//     }
-//     break;
-
-//     case KEY_LEFT:
-//     {
-//         ESP_LOGD(TAG, "left");
-//         auto id = parent->id;
-//         if (!loadItems(id))
-//         {
-//             ESP_LOGE(TAG, "Error loading items: %s", id);
-//         }
-//         else
-//         {
-//             // this->SetProgressBar(60, "rendering root");
-//             ESP_LOGD(TAG, "returned %d items", items_count);
-
-//             // this->UpdateMenu(count, results);
-//             //  this->SetProgressBar(80, "rendering menu");
-//             //  this->SetState(UIState::Menu);
-//         }
-//         render = true;
-//     }
-//     break;
-
-//     case KEY_RELEASE:
-//         break;
-//     }
-
-//     if (render)
-//         // this->renderMenu();
-//         this->SetState(UIState::MainMenu);
-// }
-
-void TuneinUI::renderMenu()
+void TuneinUI::ControlEvent(UIControlEvent evt)
 {
-    // tft->fillScreen(TFT_BLACK);
-    // tft->drawBmpFile(SPIFFS, "/logo-color-d.bmp", 0, 0);
+    uint16_t rows = view.Rows();
+    uint16_t row = view.Selected();
 
-#ifdef TFT_ENABLED
-    tft->setTextColor(TFT_TN_GREEN);
-    tft->setFreeFont(&FreeMono12pt7b);
-    tft->setTextSize(1);
-    tft->setTextDatum(TL_DATUM);
+    switch (evt)
+    {
+    case KEY_UP:
+    {
+        if (rows > 0)
+            select((row == 0) ? rows - 1 : row - 1);
+    }
+    break;
 
-    // Header line
-    tft->setCursor(0, FreeMono12pt7b.yAdvance);
-    if (parent == NULL)
+    case KEY_DOWN:
     {
-        // tft->println("\n");
+        if (rows > 0)
+            select((row + 1 >= rows) ? 0 : row + 1);
     }
-    else
+    break;
+
+    case KEY_RIGHT:
+    {
+        ESP_LOGD(TAG, "right");
+        enter(row);
+    }
+    break;
+
+    case KEY_LEFT:
     {
-        tft->printf("< %s", parent->text);
+        ESP_LOGD(TAG, "left");
+        back();
+    }
+    break;
+
+    case KEY_RELEASE:
+        break;
     }
-    tft->drawLine(0, FreeMono12pt7b.yAdvance + 4, tft->width(), FreeMono12pt7b.yAdvance + 4, TFT_TN_GREEN);
+
+    renderMenu();
+}
+
+/**
+ * Draws the visible rows not on screen yet: all of them after a new page came
+ * in or the menu scrolled, only the new tail when rows were added below
+ */
+void TuneinUI::renderMenu()
+{
+    uint16_t count = view.Rows();
+    uint16_t top = view.Top();
+    uint16_t bottom = (top + UI_MENU_ROWS < count) ? top + UI_MENU_ROWS : count;
+    if (rendered == 0)
+    {
+#ifdef TFT_ENABLED
+        tft->fillScreen(TFT_BLACK);
+        tft->setTextColor(TFT_TN_GREEN);
+        tft->setFreeFont(&FreeMono12pt7b);
+        tft->setTextSize(1);
+        tft->setTextDatum(TL_DATUM);
+
+        // Header line
+        tft->setCursor(0, FreeMono12pt7b.yAdvance);
+        if (parent.length() == 0)
+        {
+            // tft->println("\n");
+        }
+        else
+        {
+            tft->printf("< %s", parent.c_str());
+        }
+        tft->drawLine(0, FreeMono12pt7b.yAdvance + 4, tft->width(), FreeMono12pt7b.yAdvance + 4, TFT_TN_GREEN);
 #endif
+    }
+    else if (top + rendered > count)
+    {
+        rendered = 0;
+        renderMenu();
+        return;
+    }
 
-    for (uint16_t i = 0; i < items_count; i++)
+    const UIMenuTree &tree = view.Tree();
+    for (uint16_t row = top + rendered; row < bottom; row++)
     {
+        uint16_t item = tree.ItemAt(row);
+        // a window holds the rows around the cursor, the screen among them
+        uint16_t index;
+        const char *text = view.Held(row, &index) ? view.Items()->Text(index) : "";
+        const char *marker = !tree.IsSection(item) ? "" : tree.Expanded(item) ? "- " : "+ ";
+        int indent = 2 * tree.Depth(item);
 #ifdef TFT_ENABLED
-        tft->setCursor(0, FreeMono12pt7b.yAdvance * (i + 2));
-        tft->printf("%s %s", items[i].text, (selected_index == i) ? "<" : " ");
+        tft->setCursor(0, FreeMono12pt7b.yAdvance * (row - top + 2));
+        tft->printf("%*s%s%s %s", indent, "", marker, text, (view.Selected() == row) ? "<" : " ");
 #endif
-        ESP_LOGI(TAG, "%s %s", items[i].text, (selected_index == i) ? "<" : "");
+        ESP_LOGI(TAG, "%*s%s%s %s", indent, "", marker, text, (view.Selected() == row) ? "<" : "");
     }
+    rendered = (bottom > top) ? bottom - top : 0;
 }
 
 void TuneinUI::Loop(void)
 {
-    nav->poll();
+    api->Poll();
+    // keys come in through ControlEvent(), the menu library would read them
+    // off the serial port first
+
 }
 
 // void TuneinUI::SetSongName(String name)
@@ -20,6 +20,7 @@
 #endif
 
 #include "ui/progressbar.h"
+#include "menuview.h"
 #include "tuneinapi.h"
 
 #define FONT_SIZE 1
@@ -65,14 +66,14 @@ enum UIState
     MainMenu,
 };
 
-// enum UIControlEvent
-// {
-//     KEY_RELEASE,
-//     KEY_UP,
-//     KEY_DOWN,
-//     KEY_RIGHT,
-//     KEY_LEFT,
-// };
+enum UIControlEvent
+{
+    KEY_RELEASE,
+    KEY_UP,
+    KEY_DOWN,
+    KEY_RIGHT,
+    KEY_LEFT,
+};
 
 class TuneinUI
 {
@@ -81,6 +82,7 @@ public:
     void Init();
     void SetState(UIState);
     void GiveUp(const char *);
+    bool ShowCachedRoot();
 
     // void SetSongName(String);
     // void SetArtistName(String);
@@ -89,7 +91,7 @@ public:
     // void SetAlbumArt(const char *);
 
     // void UpdateMenu(uint16_t, UIMenuItem *);
-    // void ControlEvent(UIControlEvent);
+    void ControlEvent(UIControlEvent);
     void Loop(void);
 
 private:
@@ -99,10 +101,21 @@ private:
 
     const char *TAG = "ui";
     UIState state;
-    UIMenuItem *items = NULL;
-    uint16_t items_count = 0;
-    uint16_t selected_index = 0;
-    UIMenuItem *parent = NULL;
+    UIMenuView view;
+    String items_id; // the page asked for last
+    request_handle items_request = 0;
+    request_handle items_partial = 0; // request whose first items are shown
+    uint16_t rendered = 0;            // rows of items on screen
+    String parent;                    // title of the page on screen
+
+    // the pages entered from, to go back to
+    struct Visited
+    {
+        String id;
+        String title;
+    };
+    Visited trail[MENU_MAX_DEPTH];
+    uint8_t trail_count = 0;
 
     // navigation inputs
     serialIn *serial_in;
@@ -142,6 +155,10 @@ private:
     String prettyBytes(uint32_t bytes);
     void renderMenu();
     bool loadItems(String);
+    static void onItemsLoaded(request_handle, client_result, UIMenuList *, void *);
+    void select(uint16_t);
+    void enter(uint16_t);
+    void back();
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,65 @@
+#ifndef TEST_CORPUS_H
+#define TEST_CORPUS_H
+
+#include <dirent.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+/*
+ * The saved Browse.ashx responses in test/corpus, each named after the
+ * guide_id it was fetched with: r0 is the root, the pages it links to
+ * follow, from short link lists to a long flat station list (g61) and pages
+ * grouped into sections (g2748, g3124, ...).
+ */
+
+#ifndef TEST_CORPUS_DIR
+#define TEST_CORPUS_DIR "test/corpus"
+#endif
+
+struct CorpusPage
+{
+    std::string id;
+    std::string body;
+};
+
+static bool ReadCorpusFile(const std::string &path, std::string *body)
+{
+    FILE *f = fopen(path.c_str(), "rb");
+    if (f == NULL)
+        return false;
+    body->clear();
+    char buffer[4096];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0)
+        body->append(buffer, n);
+    fclose(f);
+    return true;
+}
+
+// the corpus by guide_id, empty if the directory is not found
+static std::vector<CorpusPage> LoadCorpus()
+{
+    std::vector<CorpusPage> pages;
+    DIR *dir = opendir(TEST_CORPUS_DIR);
+    if (dir == NULL)
+        return pages;
+    for (struct dirent *entry = readdir(dir); entry != NULL; entry = readdir(dir))
+    {
+        const char *dot = strrchr(entry->d_name, '.');
+        if (dot == NULL || strcmp(dot, ".opml") != 0)
+            continue;
+        CorpusPage page;
+        page.id.assign(entry->d_name, dot - entry->d_name);
+        if (ReadCorpusFile(std::string(TEST_CORPUS_DIR) + "/" + entry->d_name, &page.body))
+            pages.push_back(page);
+    }
+    closedir(dir);
+    std::sort(pages.begin(), pages.end(), [](const CorpusPage &a, const CorpusPage &b) { return a.id < b.id; });
+    return pages;
+}
+
+#endif
@@ -0,0 +1,246 @@
+#ifndef TEST_FAKE_TRANSPORT_H
+#define TEST_FAKE_TRANSPORT_H
+
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <string>
+#include <zlib.h>
+
+#include "api/transport.h"
+#include "tuneinapi.h"
+#include "corpus.h"
+
+/*
+ * A server in memory for TuneinApi: Browse pages by guide_id, each with an
+ * optional ETag and Last-Modified that a matching conditional request gets
+ * a 304 for. It counts what it is asked, can be held so that a request stays
+ * in flight until the test lets it go, and can be slowed down. Told to, it
+ * gzips the pages for requests that accept it, as the real server does.
+ */
+class FakeTransport : public ApiTransport
+{
+public:
+    struct Page
+    {
+        std::string body;
+        std::string etag;
+        std::string last_modified;
+        std::string gzipped; // made the first time it is sent
+    };
+
+    void Serve(const char *id, const std::string &body, const char *etag = "", const char *last_modified = "")
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        Page &page = pages[url(id)];
+        page.body = body;
+        page.etag = etag;
+        page.last_modified = last_modified;
+        page.gzipped.clear();
+    }
+
+    void ServeCorpus()
+    {
+        std::vector<CorpusPage> corpus = LoadCorpus();
+        for (size_t i = 0; i < corpus.size(); i++)
+            Serve(corpus[i].id.c_str(), corpus[i].body);
+    }
+
+    // the GETs made for a page, conditional or not
+    int Gets(const char *id)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        return gets[url(id)];
+    }
+
+    // the If-None-Match of the last GET for a page
+    std::string SentEtag(const char *id)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        return sent_etag[url(id)];
+    }
+
+    // the If-Modified-Since of the last GET for a page
+    std::string SentModifiedSince(const char *id)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        return sent_ims[url(id)];
+    }
+
+    // the Accept-Encoding of the last GET for a page
+    std::string SentAcceptEncoding(const char *id)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        return sent_accept[url(id)];
+    }
+
+    // GETs wait until Release(), and count as waiting meanwhile
+    void Hold()
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        held = true;
+    }
+
+    void Release()
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        held = false;
+        changed.notify_all();
+    }
+
+    // waits up to a second for that many GETs to be held
+    bool WaitForHeld(int count)
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        return changed.wait_for(guard, std::chrono::seconds(1), [&] { return waiting >= count; });
+    }
+
+    void Reset()
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        gets.clear();
+        sent_etag.clear();
+        sent_ims.clear();
+        sent_accept.clear();
+        total = 0;
+        not_modified = 0;
+    }
+
+    void Begin(const char *_url) override
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        current = _url;
+        request_headers.clear();
+        accept_encoding = "identity";
+        response = NULL;
+        response_gzipped = false;
+    }
+
+    void AddHeader(const char *name, const char *value) override
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        request_headers[name] = value;
+    }
+
+    void SetAcceptEncoding(const char *encoding) override
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        accept_encoding = encoding;
+    }
+
+    int Get(FetchTimings *timings) override
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        gets[current]++;
+        total++;
+        waiting++;
+        changed.notify_all();
+        changed.wait(guard, [this] { return !held; });
+        waiting--;
+        timings->Set(FETCH_TTFB, 1000);
+
+        std::map<std::string, Page>::iterator page = pages.find(current);
+        if (page == pages.end())
+            return HTTP_CODE_NOT_FOUND;
+        response = &page->second;
+
+        std::string inm = request_headers["If-None-Match"];
+        std::string ims = request_headers["If-Modified-Since"];
+        sent_etag[current] = inm;
+        sent_ims[current] = ims;
+        sent_accept[current] = accept_encoding;
+        if ((!inm.empty() && inm == response->etag) || (inm.empty() && !ims.empty() && ims == response->last_modified))
+        {
+            not_modified++;
+            return HTTP_CODE_NOT_MODIFIED;
+        }
+        response_gzipped = compress && accept_encoding.find("gzip") != std::string::npos;
+        if (response_gzipped && page->second.gzipped.empty())
+            page->second.gzipped = gzip(page->second.body);
+        return HTTP_CODE_OK;
+    }
+
+    String Header(const char *name) override
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (response == NULL)
+            return String();
+        if (strcasecmp(name, "ETag") == 0)
+            return String(response->etag.c_str());
+        if (strcasecmp(name, "Last-Modified") == 0)
+            return String(response->last_modified.c_str());
+        if (strcasecmp(name, "Content-Encoding") == 0 && response_gzipped)
+            return String("gzip");
+        return String();
+    }
+
+    int WriteToStream(Stream *stream) override
+    {
+        std::string body;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            if (response == NULL)
+                return HTTPC_ERROR_CONNECTION_LOST;
+            body = response_gzipped ? response->gzipped : response->body;
+        }
+        // in TCP segments, each after the delay
+        for (size_t at = 0; at < body.size(); at += 1460)
+        {
+            if (chunk_delay_ms > 0)
+                delay(chunk_delay_ms);
+            size_t n = std::min((size_t)1460, body.size() - at);
+            if (stream->write((const uint8_t *)body.data() + at, n) != n)
+                return HTTPC_ERROR_STREAM_WRITE;
+        }
+        return body.size();
+    }
+
+    void End(bool) override
+    {
+    }
+
+    int total = 0;        // GETs
+    int not_modified = 0; // 304s sent
+    volatile int chunk_delay_ms = 0;
+    volatile bool compress = false;
+
+private:
+    std::mutex lock;
+    std::condition_variable changed;
+    std::map<std::string, Page> pages;
+    std::map<std::string, int> gets;
+    std::map<std::string, std::string> sent_etag;
+    std::map<std::string, std::string> sent_ims;
+    std::map<std::string, std::string> sent_accept;
+    std::map<std::string, std::string> request_headers;
+    std::string accept_encoding;
+    std::string current;
+    const Page *response = NULL;
+    bool response_gzipped = false;
+    bool held = false;
+    int waiting = 0;
+
+    static std::string gzip(const std::string &body)
+    {
+        z_stream stream = {};
+        deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, MAX_WBITS + 16, 8, Z_DEFAULT_STRATEGY);
+        std::string out(deflateBound(&stream, body.size()), 0);
+        stream.next_in = (Bytef *)body.data();
+        stream.avail_in = body.size();
+        stream.next_out = (Bytef *)&out[0];
+        stream.avail_out = out.size();
+        deflate(&stream, Z_FINISH);
+        out.resize(stream.total_out);
+        deflateEnd(&stream);
+        return out;
+    }
+
+    static std::string url(const char *id)
+    {
+        char buffer[API_MAX_URL_LEN];
+        TuneinApi::BrowseUrl(id, buffer, sizeof(buffer));
+        return buffer;
+    }
+};
+
+#endif
@@ -0,0 +1,98 @@
+#ifndef TEST_HEAP_H
+#define TEST_HEAP_H
+
+#include <stddef.h>
+
+/*
+ * Counts the heap calls of a test between HeapStart() and HeapStop(), by
+ * standing in for the C library's malloc and friends, which operator new
+ * goes through as well. Needs glibc, elsewhere HEAP_COUNTED is 0 and the
+ * counters stay at zero. Include it in one file of a suite, and count on
+ * one thread at a time.
+ */
+
+struct HeapCounters
+{
+    size_t allocations; // malloc, calloc and realloc calls
+    long live;          // bytes allocated and not freed since HeapStart()
+    long peak;          // the most live was at
+};
+
+static volatile bool heap_counting = false;
+static HeapCounters heap_counters;
+
+#if defined(__GLIBC__)
+#define HEAP_COUNTED 1
+
+#include <malloc.h>
+
+extern "C"
+{
+    void *__libc_malloc(size_t);
+    void *__libc_calloc(size_t, size_t);
+    void *__libc_realloc(void *, size_t);
+    void __libc_free(void *);
+}
+
+static void heapAdded(void *p)
+{
+    if (!heap_counting || p == NULL)
+        return;
+    heap_counters.allocations++;
+    heap_counters.live += malloc_usable_size(p);
+    if (heap_counters.live > heap_counters.peak)
+        heap_counters.peak = heap_counters.live;
+}
+
+static void heapRemoved(void *p)
+{
+    if (heap_counting && p != NULL)
+        heap_counters.live -= malloc_usable_size(p);
+}
+
+extern "C" void *malloc(size_t size)
+{
+    void *p = __libc_malloc(size);
+    heapAdded(p);
+    return p;
+}
+
+extern "C" void *calloc(size_t count, size_t size)
+{
+    void *p = __libc_calloc(count, size);
+    heapAdded(p);
+    return p;
+}
+
+extern "C" void *realloc(void *p, size_t size)
+{
+    heapRemoved(p);
+    void *q = __libc_realloc(p, size);
+    heapAdded(q != NULL ? q : p);
+    return q;
+}
+
+extern "C" void free(void *p)
+{
+    heapRemoved(p);
+    __libc_free(p);
+}
+#else
+#define HEAP_COUNTED 0
+#endif
+
+static void HeapStart()
+{
+    heap_counters.allocations = 0;
+    heap_counters.live = 0;
+    heap_counters.peak = 0;
+    heap_counting = true;
+}
+
+static HeapCounters HeapStop()
+{
+    heap_counting = false;
+    return heap_counters;
+}
+
+#endif
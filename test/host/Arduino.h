@@ -0,0 +1,62 @@
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+/*
+ * Just enough of the Arduino core for the portable sources to build and run
+ * on a desktop, see [env:native] in platformio.ini. There is no network: the
+ * host HTTPClient fails every request as if the server were unreachable, tests
+ * put an ApiTransport of their own in place.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <math.h>
+
+#include "WString.h"
+#include "Print.h"
+#include "Stream.h"
+#include "IPAddress.h"
+
+// where fs::FS instances without a root of their own, SPIFFS among them, keep their files
+#ifndef HOST_FS_ROOT
+#define HOST_FS_ROOT "/tmp/esp-tunein-player"
+#endif
+
+// errors and warnings go to stderr, the rest only with -D HOST_LOG_VERBOSE
+#define HOST_LOG(level, tag, format, ...) fprintf(stderr, "[%c][%s] " format "\n", level, tag, ##__VA_ARGS__)
+// compiled, so the arguments are still checked against the format, but never run
+#define HOST_LOG_NONE(level, tag, format, ...)             \
+    do                                                     \
+    {                                                      \
+        if (0)                                             \
+            HOST_LOG(level, tag, format, ##__VA_ARGS__);   \
+    } while (0)
+
+#define ESP_LOGE(tag, format, ...) HOST_LOG('E', tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) HOST_LOG('W', tag, format, ##__VA_ARGS__)
+#ifdef HOST_LOG_VERBOSE
+#define ESP_LOGI(tag, format, ...) HOST_LOG('I', tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) HOST_LOG('D', tag, format, ##__VA_ARGS__)
+#define ESP_LOGV(tag, format, ...) HOST_LOG('V', tag, format, ##__VA_ARGS__)
+#else
+#define ESP_LOGI(tag, format, ...) HOST_LOG_NONE('I', tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) HOST_LOG_NONE('D', tag, format, ##__VA_ARGS__)
+#define ESP_LOGV(tag, format, ...) HOST_LOG_NONE('V', tag, format, ##__VA_ARGS__)
+#endif
+
+#define IRAM_ATTR
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long);
+void yield();
+
+// not every C library has it, and those that do declare it differently
+size_t host_strlcpy(char *, const char *, size_t);
+#define strlcpy host_strlcpy
+
+#endif
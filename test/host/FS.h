@@ -0,0 +1,92 @@
+#ifndef HOST_FS_H
+#define HOST_FS_H
+
+#include <memory>
+#include <string>
+
+#include "Arduino.h"
+
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+#define FILE_APPEND "a"
+
+namespace fs
+{
+
+enum SeekMode
+{
+    SeekSet = 0,
+    SeekCur = 1,
+    SeekEnd = 2
+};
+
+class FileImpl;
+
+/** An open file or directory; copies share it, as with the ESP32 core */
+class File : public Stream
+{
+public:
+    File() {}
+    File(std::shared_ptr<FileImpl> _impl) : impl(_impl) {}
+
+    size_t write(uint8_t) override;
+    size_t write(const uint8_t *, size_t) override;
+    int available() override;
+    int read() override;
+    int peek() override;
+    void flush() override;
+    size_t read(uint8_t *, size_t);
+    bool seek(uint32_t, SeekMode = SeekSet);
+    size_t position() const;
+    size_t size() const;
+    void close();
+    operator bool() const;
+    const char *name() const;
+    bool isDirectory() const;
+    File openNextFile(const char * = FILE_READ);
+
+private:
+    std::shared_ptr<FileImpl> impl;
+};
+
+/**
+ * A file system kept in a directory of the host. Paths are absolute within
+ * it, and as on SPIFFS the directories in them exist as soon as a file is
+ * written there.
+ */
+class FS
+{
+public:
+    FS(const char * = HOST_FS_ROOT);
+    virtual ~FS() {}
+
+    File open(const char *, const char * = FILE_READ);
+    File open(const String &path, const char *mode = FILE_READ) { return open(path.c_str(), mode); }
+    bool exists(const char *);
+    bool exists(const String &path) { return exists(path.c_str()); }
+    bool remove(const char *);
+    bool remove(const String &path) { return remove(path.c_str()); }
+    bool rename(const char *, const char *);
+    bool mkdir(const char *);
+    bool rmdir(const char *);
+
+    // removes every file in the directory, for tests starting from a clean slate
+    void Clear(const char * = "/");
+    const char *Root() const { return root.c_str(); }
+
+private:
+    std::string root;
+
+    std::string host(const char *) const;
+};
+
+} // namespace fs
+
+using fs::File;
+using fs::FS;
+using fs::SeekMode;
+using fs::SeekSet;
+using fs::SeekCur;
+using fs::SeekEnd;
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef HOST_HTTPCLIENT_H
+#define HOST_HTTPCLIENT_H
+
+#include "WiFiClient.h"
+
+#define HTTPC_ERROR_CONNECTION_REFUSED (-1)
+#define HTTPC_ERROR_SEND_HEADER_FAILED (-2)
+#define HTTPC_ERROR_SEND_PAYLOAD_FAILED (-3)
+#define HTTPC_ERROR_NOT_CONNECTED (-4)
+#define HTTPC_ERROR_CONNECTION_LOST (-5)
+#define HTTPC_ERROR_NO_STREAM (-6)
+#define HTTPC_ERROR_NO_HTTP_SERVER (-7)
+#define HTTPC_ERROR_TOO_LESS_RAM (-8)
+#define HTTPC_ERROR_ENCODING (-9)
+#define HTTPC_ERROR_STREAM_WRITE (-10)
+#define HTTPC_ERROR_READ_TIMEOUT (-11)
+
+typedef enum
+{
+    HTTP_CODE_OK = 200,
+    HTTP_CODE_MOVED_PERMANENTLY = 301,
+    HTTP_CODE_FOUND = 302,
+    HTTP_CODE_NOT_MODIFIED = 304,
+    HTTP_CODE_BAD_REQUEST = 400,
+    HTTP_CODE_NOT_FOUND = 404,
+    HTTP_CODE_INTERNAL_SERVER_ERROR = 500,
+    HTTP_CODE_SERVICE_UNAVAILABLE = 503
+} t_http_codes;
+
+/**
+ * The HTTPClient interface the API uses. Every request fails with
+ * HTTPC_ERROR_CONNECTION_REFUSED.
+ */
+class HTTPClient
+{
+public:
+    bool begin(WiFiClient &, const String &) { return true; }
+    bool begin(const String &) { return true; }
+    void end() {}
+    void setReuse(bool) {}
+    void setTimeout(uint16_t) {}
+    void setAcceptEncoding(const String &encoding) { accept_encoding = encoding; }
+    void addHeader(const String &, const String &, bool = false, bool = true) {}
+    void collectHeaders(const char *[], const size_t) {}
+    String header(const char *) { return String(); }
+    bool hasHeader(const char *) { return false; }
+
+    int GET() { return HTTPC_ERROR_CONNECTION_REFUSED; }
+    int getSize() { return -1; }
+    int writeToStream(Stream *) { return HTTPC_ERROR_NOT_CONNECTED; }
+
+    static String errorToString(int);
+
+    // what an Accept-Encoding header would say, for tests
+    String accept_encoding = "identity;q=1,chunked;q=0.1,*;q=0";
+};
+
+#endif
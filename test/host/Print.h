@@ -0,0 +1,37 @@
+#ifndef HOST_PRINT_H
+#define HOST_PRINT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "WString.h"
+
+class Print
+{
+public:
+    virtual ~Print() {}
+
+    virtual size_t write(uint8_t) = 0;
+    virtual size_t write(const uint8_t *, size_t);
+    size_t write(const char *s) { return s != NULL ? write((const uint8_t *)s, strlen(s)) : 0; }
+    virtual void flush() {}
+
+    size_t printf(const char *, ...) __attribute__((format(printf, 2, 3)));
+    size_t print(const char *s) { return write(s); }
+    size_t print(const String &s) { return write(s.c_str()); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(int);
+    size_t print(unsigned int);
+    size_t print(long);
+    size_t print(unsigned long);
+    size_t println() { return write("\r\n"); }
+    template <typename T>
+    size_t println(const T &value)
+    {
+        size_t n = print(value);
+        return n + println();
+    }
+};
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef HOST_SPIFFS_H
+#define HOST_SPIFFS_H
+
+#include "FS.h"
+
+namespace fs
+{
+
+class SPIFFSFS : public FS
+{
+public:
+    SPIFFSFS() : FS(HOST_FS_ROOT "/spiffs") {}
+
+    bool begin(bool = false, const char * = "/spiffs", uint8_t = 10, const char * = NULL) { return true; }
+    bool format()
+    {
+        Clear();
+        return true;
+    }
+    void end() {}
+};
+
+} // namespace fs
+
+extern fs::SPIFFSFS SPIFFS;
+
+#endif
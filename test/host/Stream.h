@@ -0,0 +1,21 @@
+#ifndef HOST_STREAM_H
+#define HOST_STREAM_H
+
+#include "Print.h"
+
+class Stream : public Print
+{
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+
+    void setTimeout(unsigned long timeout) { this->timeout = timeout; }
+    size_t readBytes(uint8_t *, size_t);
+    size_t readBytes(char *buffer, size_t length) { return readBytes((uint8_t *)buffer, length); }
+
+protected:
+    unsigned long timeout = 1000;
+};
+
+#endif
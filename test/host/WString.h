@@ -0,0 +1,75 @@
+#ifndef HOST_WSTRING_H
+#define HOST_WSTRING_H
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string>
+
+/** The part of the Arduino String the sources use, over std::string */
+class String
+{
+public:
+    String() {}
+    String(const char *s) : value(s != NULL ? s : "") {}
+    String(const char *s, size_t length) : value(s, length) {}
+    explicit String(char c) : value(1, c) {}
+    explicit String(int);
+    explicit String(unsigned int);
+    explicit String(long);
+    explicit String(unsigned long);
+
+    const char *c_str() const { return value.c_str(); }
+    unsigned int length() const { return value.length(); }
+    bool isEmpty() const { return value.empty(); }
+    char operator[](unsigned int i) const { return i < value.length() ? value[i] : 0; }
+
+    bool equals(const String &s) const { return value == s.value; }
+    bool equals(const char *s) const { return value == s; }
+    bool equalsIgnoreCase(const String &) const;
+    bool startsWith(const String &s) const { return value.compare(0, s.value.length(), s.value) == 0; }
+    bool endsWith(const String &) const;
+    int indexOf(char c, unsigned int from = 0) const;
+    int indexOf(const String &, unsigned int from = 0) const;
+    String substring(unsigned int, unsigned int) const;
+    String substring(unsigned int from) const { return substring(from, length()); }
+    long toInt() const { return strtol(value.c_str(), NULL, 10); }
+
+    bool concat(const String &s)
+    {
+        value += s.value;
+        return true;
+    }
+    String &operator+=(const String &s)
+    {
+        value += s.value;
+        return *this;
+    }
+    String &operator+=(const char *s)
+    {
+        value += s;
+        return *this;
+    }
+    String &operator+=(char c)
+    {
+        value += c;
+        return *this;
+    }
+
+    bool operator==(const String &s) const { return value == s.value; }
+    bool operator==(const char *s) const { return value == s; }
+    bool operator!=(const String &s) const { return value != s.value; }
+    bool operator!=(const char *s) const { return value != s; }
+    bool operator<(const String &s) const { return value < s.value; }
+
+    friend String operator+(const String &a, const String &b)
+    {
+        String s(a);
+        s += b;
+        return s;
+    }
+
+private:
+    std::string value;
+};
+
+#endif
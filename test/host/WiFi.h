@@ -0,0 +1,26 @@
+#ifndef HOST_WIFI_H
+#define HOST_WIFI_H
+
+#include "WiFiClient.h"
+
+typedef enum
+{
+    WL_IDLE_STATUS = 0,
+    WL_NO_SSID_AVAIL = 1,
+    WL_CONNECTED = 3,
+    WL_CONNECT_FAILED = 4,
+    WL_DISCONNECTED = 6
+} wl_status_t;
+
+/** A station that never connects; names resolve only if they are addresses */
+class WiFiClass
+{
+public:
+    wl_status_t status() { return WL_DISCONNECTED; }
+    bool isConnected() { return false; }
+    int hostByName(const char *host, IPAddress &address) { return address.fromString(host) ? 1 : 0; }
+};
+
+extern WiFiClass WiFi;
+
+#endif
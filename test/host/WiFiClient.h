@@ -0,0 +1,23 @@
+#ifndef HOST_WIFICLIENT_H
+#define HOST_WIFICLIENT_H
+
+#include "Arduino.h"
+
+/** A client that never gets through, the host build has no network */
+class WiFiClient : public Stream
+{
+public:
+    int connect(IPAddress, uint16_t) { return 0; }
+    int connect(const char *, uint16_t) { return 0; }
+    uint8_t connected() { return 0; }
+    void stop() {}
+
+    size_t write(uint8_t) override { return 0; }
+    size_t write(const uint8_t *, size_t) override { return 0; }
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int read(uint8_t *, size_t) { return -1; }
+    int peek() override { return -1; }
+};
+
+#endif
@@ -0,0 +1,12 @@
+#ifndef HOST_FREERTOS_QUEUE_H
+#define HOST_FREERTOS_QUEUE_H
+
+#include "FreeRTOS.h"
+
+QueueHandle_t xQueueCreate(UBaseType_t, UBaseType_t);
+BaseType_t xQueueSend(QueueHandle_t, const void *, TickType_t);
+BaseType_t xQueueSendToFront(QueueHandle_t, const void *, TickType_t);
+BaseType_t xQueueReceive(QueueHandle_t, void *, TickType_t);
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t);
+
+#endif
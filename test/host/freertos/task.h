@@ -0,0 +1,13 @@
+#ifndef HOST_FREERTOS_TASK_H
+#define HOST_FREERTOS_TASK_H
+
+#include "FreeRTOS.h"
+
+typedef void (*TaskFunction_t)(void *);
+
+// the task runs on a thread of its own, core and priority are ignored
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t, const char *, uint32_t, void *, UBaseType_t, TaskHandle_t *, BaseType_t);
+void vTaskDelay(TickType_t);
+TickType_t xTaskGetTickCount();
+
+#endif
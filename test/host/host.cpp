@@ -0,0 +1,595 @@
+// The host side of the platform headers in this directory
+
+#include <Arduino.h>
+#include <FS.h>
+#include <SPIFFS.h>
+#include <WiFi.h>
+#include <HTTPClient.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#include <rom/miniz.h>
+
+#include <dirent.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+fs::SPIFFSFS SPIFFS;
+WiFiClass WiFi;
+
+static const std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+
+unsigned long millis()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started).count();
+}
+
+unsigned long micros()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started).count();
+}
+
+void delay(unsigned long ms)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void yield()
+{
+    std::this_thread::yield();
+}
+
+size_t host_strlcpy(char *dst, const char *src, size_t size)
+{
+    size_t len = strlen(src);
+    if (size > 0)
+    {
+        size_t n = len < size - 1 ? len : size - 1;
+        memcpy(dst, src, n);
+        dst[n] = 0;
+    }
+    return len;
+}
+
+// String
+
+String::String(int v) : value(std::to_string(v)) {}
+String::String(unsigned int v) : value(std::to_string(v)) {}
+String::String(long v) : value(std::to_string(v)) {}
+String::String(unsigned long v) : value(std::to_string(v)) {}
+
+bool String::equalsIgnoreCase(const String &s) const
+{
+    return value.length() == s.value.length() && strcasecmp(value.c_str(), s.value.c_str()) == 0;
+}
+
+bool String::endsWith(const String &s) const
+{
+    return value.length() >= s.value.length() &&
+           value.compare(value.length() - s.value.length(), s.value.length(), s.value) == 0;
+}
+
+int String::indexOf(char c, unsigned int from) const
+{
+    size_t i = value.find(c, from);
+    return i == std::string::npos ? -1 : (int)i;
+}
+
+int String::indexOf(const String &s, unsigned int from) const
+{
+    size_t i = value.find(s.value, from);
+    return i == std::string::npos ? -1 : (int)i;
+}
+
+String String::substring(unsigned int from, unsigned int to) const
+{
+    if (from > to)
+    {
+        unsigned int t = from;
+        from = to;
+        to = t;
+    }
+    if (from >= value.length())
+        return String();
+    return String(value.substr(from, to - from).c_str());
+}
+
+// Print, Stream
+
+size_t Print::write(const uint8_t *buffer, size_t size)
+{
+    size_t n = 0;
+    while (n < size && write(buffer[n]) == 1)
+        n++;
+    return n;
+}
+
+size_t Print::printf(const char *format, ...)
+{
+    char small[128];
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(small, sizeof(small), format, args);
+    va_end(args);
+    if (len < 0)
+        return 0;
+    if (len < (int)sizeof(small))
+        return write((const uint8_t *)small, len);
+
+    std::vector<char> large(len + 1);
+    va_start(args, format);
+    vsnprintf(large.data(), large.size(), format, args);
+    va_end(args);
+    return write((const uint8_t *)large.data(), len);
+}
+
+size_t Print::print(int v) { return printf("%d", v); }
+size_t Print::print(unsigned int v) { return printf("%u", v); }
+size_t Print::print(long v) { return printf("%ld", v); }
+size_t Print::print(unsigned long v) { return printf("%lu", v); }
+
+size_t Stream::readBytes(uint8_t *buffer, size_t length)
+{
+    size_t n = 0;
+    unsigned long since = millis();
+    while (n < length && millis() - since < timeout)
+    {
+        int c = read();
+        if (c < 0)
+        {
+            yield();
+            continue;
+        }
+        buffer[n++] = (uint8_t)c;
+        since = millis();
+    }
+    return n;
+}
+
+// IPAddress
+
+bool IPAddress::fromString(const char *s)
+{
+    unsigned int a, b, c, d;
+    char end;
+    if (sscanf(s, "%u.%u.%u.%u%c", &a, &b, &c, &d, &end) != 4 || a > 255 || b > 255 || c > 255 || d > 255)
+        return false;
+    *this = IPAddress(a, b, c, d);
+    return true;
+}
+
+String IPAddress::toString() const
+{
+    char buffer[16];
+    snprintf(buffer, sizeof(buffer), "%u.%u.%u.%u", (*this)[0], (*this)[1], (*this)[2], (*this)[3]);
+    return String(buffer);
+}
+
+// HTTPClient
+
+String HTTPClient::errorToString(int error)
+{
+    switch (error)
+    {
+    case HTTPC_ERROR_CONNECTION_REFUSED:
+        return String("connection refused");
+    case HTTPC_ERROR_NOT_CONNECTED:
+        return String("not connected");
+    case HTTPC_ERROR_CONNECTION_LOST:
+        return String("connection lost");
+    case HTTPC_ERROR_STREAM_WRITE:
+        return String("Stream write error");
+    case HTTPC_ERROR_READ_TIMEOUT:
+        return String("read Timeout");
+    default:
+        return String();
+    }
+}
+
+// fs
+
+namespace fs
+{
+
+class FileImpl
+{
+public:
+    FILE *file = NULL;
+    DIR *dir = NULL;
+    std::string path; // within the file system
+    std::string host; // of the host
+    bool readable = false;
+
+    ~FileImpl()
+    {
+        if (file != NULL)
+            fclose(file);
+        if (dir != NULL)
+            closedir(dir);
+    }
+};
+
+static bool makeParents(const std::string &path)
+{
+    for (size_t slash = path.find('/', 1); slash != std::string::npos; slash = path.find('/', slash + 1))
+    {
+        std::string parent = path.substr(0, slash);
+        if (::mkdir(parent.c_str(), 0755) != 0 && errno != EEXIST)
+            return false;
+    }
+    return true;
+}
+
+FS::FS(const char *_root) : root(_root)
+{
+    while (root.size() > 1 && root[root.size() - 1] == '/')
+        root.erase(root.size() - 1);
+}
+
+std::string FS::host(const char *path) const
+{
+    return root + (path[0] == '/' ? "" : "/") + path;
+}
+
+File FS::open(const char *path, const char *mode)
+{
+    std::shared_ptr<FileImpl> impl(new FileImpl());
+    impl->path = path;
+    impl->host = host(path);
+
+    struct stat st;
+    if (mode[0] == 'r' && mode[1] != '+' && stat(impl->host.c_str(), &st) == 0 && S_ISDIR(st.st_mode))
+    {
+        impl->dir = opendir(impl->host.c_str());
+        return impl->dir != NULL ? File(impl) : File();
+    }
+
+    if (mode[0] != 'r' && !makeParents(impl->host))
+        return File();
+    const char *fmode = mode[0] == 'w' ? "w+b" : mode[0] == 'a' ? "a+b" : mode[1] == '+' ? "r+b" : "rb";
+    impl->file = fopen(impl->host.c_str(), fmode);
+    impl->readable = true;
+    return impl->file != NULL ? File(impl) : File();
+}
+
+bool FS::exists(const char *path)
+{
+    struct stat st;
+    return stat(host(path).c_str(), &st) == 0;
+}
+
+bool FS::remove(const char *path)
+{
+    return ::remove(host(path).c_str()) == 0;
+}
+
+bool FS::rename(const char *from, const char *to)
+{
+    std::string target = host(to);
+    return makeParents(target) && ::rename(host(from).c_str(), target.c_str()) == 0;
+}
+
+bool FS::mkdir(const char *path)
+{
+    std::string dir = host(path);
+    return makeParents(dir) && (::mkdir(dir.c_str(), 0755) == 0 || errno == EEXIST);
+}
+
+bool FS::rmdir(const char *path)
+{
+    return ::rmdir(host(path).c_str()) == 0;
+}
+
+void FS::Clear(const char *path)
+{
+    std::string dir = host(path);
+    DIR *d = opendir(dir.c_str());
+    if (d == NULL)
+        return;
+    for (struct dirent *entry = readdir(d); entry != NULL; entry = readdir(d))
+    {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+            continue;
+        std::string child = std::string(path) + (path[strlen(path) - 1] == '/' ? "" : "/") + entry->d_name;
+        struct stat st;
+        if (stat(host(child.c_str()).c_str(), &st) == 0 && S_ISDIR(st.st_mode))
+        {
+            Clear(child.c_str());
+            rmdir(child.c_str());
+        }
+        else
+        {
+            remove(child.c_str());
+        }
+    }
+    closedir(d);
+}
+
+size_t File::write(uint8_t c)
+{
+    return write(&c, 1);
+}
+
+size_t File::write(const uint8_t *buffer, size_t size)
+{
+    if (!impl || impl->file == NULL)
+        return 0;
+    return fwrite(buffer, 1, size, impl->file);
+}
+
+int File::available()
+{
+    if (!impl || impl->file == NULL)
+        return 0;
+    return (int)(size() - position());
+}
+
+int File::read()
+{
+    uint8_t c;
+    return read(&c, 1) == 1 ? c : -1;
+}
+
+int File::peek()
+{
+    if (!impl || impl->file == NULL)
+        return -1;
+    int c = fgetc(impl->file);
+    if (c != EOF)
+        ungetc(c, impl->file);
+    return c == EOF ? -1 : c;
+}
+
+void File::flush()
+{
+    if (impl && impl->file != NULL)
+        fflush(impl->file);
+}
+
+size_t File::read(uint8_t *buffer, size_t size)
+{
+    if (!impl || impl->file == NULL)
+        return 0;
+    return fread(buffer, 1, size, impl->file);
+}
+
+bool File::seek(uint32_t pos, SeekMode mode)
+{
+    if (!impl || impl->file == NULL)
+        return false;
+    int whence = mode == SeekSet ? SEEK_SET : mode == SeekCur ? SEEK_CUR : SEEK_END;
+    return fseek(impl->file, pos, whence) == 0;
+}
+
+size_t File::position() const
+{
+    if (!impl || impl->file == NULL)
+        return 0;
+    return ftell(impl->file);
+}
+
+size_t File::size() const
+{
+    if (!impl || impl->file == NULL)
+        return 0;
+    fflush(impl->file);
+    struct stat st;
+    return fstat(fileno(impl->file), &st) == 0 ? st.st_size : 0;
+}
+
+void File::close()
+{
+    impl.reset();
+}
+
+File::operator bool() const
+{
+    return impl && (impl->file != NULL || impl->dir != NULL);
+}
+
+const char *File::name() const
+{
+    return impl ? impl->path.c_str() : "";
+}
+
+bool File::isDirectory() const
+{
+    return impl && impl->dir != NULL;
+}
+
+File File::openNextFile(const char *mode)
+{
+    if (!impl || impl->dir == NULL)
+        return File();
+    for (struct dirent *entry = readdir(impl->dir); entry != NULL; entry = readdir(impl->dir))
+    {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+            continue;
+        std::string path = impl->path + (impl->path[impl->path.size() - 1] == '/' ? "" : "/") + entry->d_name;
+        std::shared_ptr<FileImpl> next(new FileImpl());
+        next->path = path;
+        next->host = impl->host + "/" + entry->d_name;
+        struct stat st;
+        if (stat(next->host.c_str(), &st) == 0 && S_ISDIR(st.st_mode))
+            next->dir = opendir(next->host.c_str());
+        else
+            next->file = fopen(next->host.c_str(), mode[0] == 'r' ? "rb" : "r+b");
+        if (next->file != NULL || next->dir != NULL)
+            return File(next);
+    }
+    return File();
+}
+
+} // namespace fs
+
+// FreeRTOS
+
+struct HostQueue
+{
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<std::vector<uint8_t>> items;
+    size_t length;
+    size_t item_size;
+};
+
+static bool waitFor(std::condition_variable &cv, std::unique_lock<std::mutex> &lock, TickType_t ticks, std::function<bool()> ready)
+{
+    if (ticks == portMAX_DELAY)
+    {
+        cv.wait(lock, ready);
+        return true;
+    }
+    return cv.wait_for(lock, std::chrono::milliseconds(ticks), ready);
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+    HostQueue *queue = new HostQueue();
+    queue->length = length;
+    queue->item_size = item_size;
+    return queue;
+}
+
+static BaseType_t queueSend(QueueHandle_t handle, const void *item, TickType_t ticks, bool front)
+{
+    HostQueue *queue = (HostQueue *)handle;
+    std::unique_lock<std::mutex> lock(queue->mutex);
+    if (!waitFor(queue->changed, lock, ticks, [queue] { return queue->items.size() < queue->length; }))
+        return pdFALSE;
+    std::vector<uint8_t> copy((const uint8_t *)item, (const uint8_t *)item + queue->item_size);
+    if (front)
+        queue->items.push_front(copy);
+    else
+        queue->items.push_back(copy);
+    queue->changed.notify_all();
+    return pdTRUE;
+}
+
+BaseType_t xQueueSend(QueueHandle_t handle, const void *item, TickType_t ticks)
+{
+    return queueSend(handle, item, ticks, false);
+}
+
+BaseType_t xQueueSendToFront(QueueHandle_t handle, const void *item, TickType_t ticks)
+{
+    return queueSend(handle, item, ticks, true);
+}
+
+BaseType_t xQueueReceive(QueueHandle_t handle, void *item, TickType_t ticks)
+{
+    HostQueue *queue = (HostQueue *)handle;
+    std::unique_lock<std::mutex> lock(queue->mutex);
+    if (!waitFor(queue->changed, lock, ticks, [queue] { return !queue->items.empty(); }))
+        return pdFALSE;
+    memcpy(item, queue->items.front().data(), queue->item_size);
+    queue->items.pop_front();
+    queue->changed.notify_all();
+    return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t handle)
+{
+    HostQueue *queue = (HostQueue *)handle;
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    return queue->items.size();
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex()
+{
+    return new std::timed_mutex();
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t handle, TickType_t ticks)
+{
+    std::timed_mutex *mutex = (std::timed_mutex *)handle;
+    if (ticks == portMAX_DELAY)
+    {
+        mutex->lock();
+        return pdTRUE;
+    }
+    return mutex->try_lock_for(std::chrono::milliseconds(ticks)) ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t handle)
+{
+    ((std::timed_mutex *)handle)->unlock();
+    return pdTRUE;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t task, const char *, uint32_t, void *arg, UBaseType_t, TaskHandle_t *handle, BaseType_t)
+{
+    // tasks never return, the thread lives as long as the process
+    std::thread *thread = new std::thread(task, arg);
+    thread->detach();
+    if (handle != NULL)
+        *handle = thread;
+    return pdPASS;
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    delay(ticks);
+}
+
+TickType_t xTaskGetTickCount()
+{
+    return millis();
+}
+
+// tinfl
+
+#define HOST_TINFL_STARTED 0x54494e46 // "TINF"
+
+void host_tinfl_init(tinfl_decompressor *r)
+{
+    // a decompressor reused before its stream ended still holds zlib state
+    if (r->started == HOST_TINFL_STARTED)
+        inflateEnd(&r->stream);
+    r->started = 0;
+}
+
+tinfl_status tinfl_decompress(tinfl_decompressor *r, const mz_uint8 *in, size_t *in_size, mz_uint8 *, mz_uint8 *out, size_t *out_size, const mz_uint32 flags)
+{
+    if (r->started != HOST_TINFL_STARTED)
+    {
+        memset(&r->stream, 0, sizeof(r->stream));
+        // a raw deflate stream without the zlib header, as for gzip
+        if (inflateInit2(&r->stream, (flags & TINFL_FLAG_PARSE_ZLIB_HEADER) ? MAX_WBITS : -MAX_WBITS) != Z_OK)
+            return TINFL_STATUS_FAILED;
+        r->started = HOST_TINFL_STARTED;
+    }
+
+    r->stream.next_in = (Bytef *)in;
+    r->stream.avail_in = *in_size;
+    r->stream.next_out = out;
+    r->stream.avail_out = *out_size;
+    int status = inflate(&r->stream, Z_NO_FLUSH);
+    *in_size -= r->stream.avail_in;
+    *out_size -= r->stream.avail_out;
+
+    if (status == Z_STREAM_END)
+    {
+        inflateEnd(&r->stream);
+        r->started = 0;
+        return TINFL_STATUS_DONE;
+    }
+    if (status != Z_OK && status != Z_BUF_ERROR)
+    {
+        inflateEnd(&r->stream);
+        r->started = 0;
+        return TINFL_STATUS_FAILED;
+    }
+    return r->stream.avail_out == 0 ? TINFL_STATUS_HAS_MORE_OUTPUT : TINFL_STATUS_NEEDS_MORE_INPUT;
+}
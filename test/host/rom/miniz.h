@@ -0,0 +1,44 @@
+#ifndef HOST_ROM_MINIZ_H
+#define HOST_ROM_MINIZ_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <zlib.h>
+
+// the tinfl interface of the ESP32 ROM, over zlib
+
+typedef uint8_t mz_uint8;
+typedef uint32_t mz_uint32;
+
+#define TINFL_LZ_DICT_SIZE 32768
+
+enum
+{
+    TINFL_FLAG_PARSE_ZLIB_HEADER = 1,
+    TINFL_FLAG_HAS_MORE_INPUT = 2,
+    TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF = 4,
+    TINFL_FLAG_COMPUTE_ADLER32 = 8
+};
+
+typedef enum
+{
+    TINFL_STATUS_BAD_PARAM = -3,
+    TINFL_STATUS_ADLER32_MISMATCH = -2,
+    TINFL_STATUS_FAILED = -1,
+    TINFL_STATUS_DONE = 0,
+    TINFL_STATUS_NEEDS_MORE_INPUT = 1,
+    TINFL_STATUS_HAS_MORE_OUTPUT = 2
+} tinfl_status;
+
+struct tinfl_decompressor
+{
+    z_stream stream;
+    uint32_t started; // HOST_TINFL_STARTED while zlib holds state for it
+};
+
+void host_tinfl_init(tinfl_decompressor *);
+#define tinfl_init(r) host_tinfl_init(r)
+
+tinfl_status tinfl_decompress(tinfl_decompressor *, const mz_uint8 *, size_t *, mz_uint8 *, mz_uint8 *, size_t *, const mz_uint32);
+
+#endif
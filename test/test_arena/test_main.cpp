@@ -0,0 +1,156 @@
+/*
+ * OPMLDocument over an arena, soaked: thousands of parse and clear cycles
+ * over the corpus in random order. The arena is reset by every clear, its
+ * peak is that of the largest page however long it runs, and the heap sees
+ * a call or two per cycle and holds no more after the hundredth cycle than
+ * after the first, so nothing is left to fragment it. An arena too small
+ * falls back to heap blocks, which go with the clear as well.
+ *
+ *     pio test -e native -f test_arena -v
+ */
+
+#include <unity.h>
+#include <tinyopml.h>
+
+#include "../corpus.h"
+#include "../heap.h"
+
+using namespace tinyopml;
+
+#define SOAK_CYCLES 3000
+#define ARENA_SIZE (1024 * 1024)
+
+static std::vector<CorpusPage> corpus;
+static char buffer[ARENA_SIZE];
+static size_t largest = 0; // arena bytes the largest page takes
+
+static uint32_t state = 1;
+
+// xorshift32, the same order on every run
+static uint32_t random(uint32_t bound)
+{
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state % bound;
+}
+
+struct Soak
+{
+    size_t allocations; // heap calls of the busiest cycle
+    long peak;          // heap bytes at most, over the whole soak
+    long held;          // heap bytes kept between cycles after the first one
+    long grown;         // kept between later cycles on top of that, at most
+    long left;          // heap bytes still allocated once the document went
+};
+
+// parses and clears pages in random order, the document kept or new each time
+static Soak soak(OPMLArena *arena, bool reuse, int cycles)
+{
+    Soak result = {0, 0, 0, 0, 0};
+    HeapStart();
+    OPMLDocument *kept = reuse ? new OPMLDocument(true, PRESERVE_WHITESPACE, arena) : NULL;
+    for (int i = 0; i < cycles; i++)
+    {
+        const std::string &body = corpus[random(corpus.size())].body;
+        size_t allocations = heap_counters.allocations;
+        OPMLDocument *doc = reuse ? kept : new OPMLDocument(true, PRESERVE_WHITESPACE, arena);
+        TEST_ASSERT_EQUAL(OPML_SUCCESS, doc->Parse(body.data(), body.size()));
+        TEST_ASSERT_NOT_NULL(doc->RootElement());
+        doc->Clear();
+        TEST_ASSERT_EQUAL(0, arena->Used());
+        if (!reuse)
+            delete doc;
+
+        if (heap_counters.allocations - allocations > result.allocations)
+            result.allocations = heap_counters.allocations - allocations;
+        if (i == 0)
+            result.held = heap_counters.live;
+        else if (heap_counters.live - result.held > result.grown)
+            result.grown = heap_counters.live - result.held;
+    }
+    delete kept;
+    HeapCounters heap = HeapStop();
+    result.peak = heap.peak;
+    result.left = heap.live;
+    return result;
+}
+
+static void report(const char *run, const OPMLArena &arena, const Soak &soaked)
+{
+    printf("%s, %d cycles: arena of %u peaked at %u bytes; heap peaked at %ld bytes, at most %u calls a cycle, %ld bytes kept between\n",
+           run, SOAK_CYCLES, (unsigned)arena.Size(), (unsigned)arena.Peak(), soaked.peak, (unsigned)soaked.allocations, soaked.held);
+}
+
+void setUp(void)
+{
+    state = 1;
+}
+
+void tearDown(void)
+{
+}
+
+static void test_largest_page_fits(void)
+{
+    OPMLArena arena(buffer, sizeof(buffer));
+    OPMLDocument doc(true, PRESERVE_WHITESPACE, &arena);
+    for (size_t i = 0; i < corpus.size(); i++)
+    {
+        TEST_ASSERT_EQUAL(OPML_SUCCESS, doc.Parse(corpus[i].body.data(), corpus[i].body.size()));
+        TEST_ASSERT_TRUE(arena.Used() < arena.Size());
+        doc.Clear();
+    }
+    largest = arena.Peak();
+    TEST_ASSERT_TRUE(largest > 0);
+    printf("largest page: %u bytes of arena\n", (unsigned)largest);
+}
+
+static void test_soak_with_one_document(void)
+{
+    OPMLArena arena(buffer, largest);
+    Soak soaked = soak(&arena, true, SOAK_CYCLES);
+    TEST_ASSERT_EQUAL(largest, arena.Peak());
+    // the copy of the page and no node blocks
+    if (HEAP_COUNTED)
+        TEST_ASSERT_EQUAL(1, soaked.allocations);
+    TEST_ASSERT_EQUAL(0, soaked.grown);
+    TEST_ASSERT_EQUAL(0, soaked.left);
+    report("one document", arena, soaked);
+}
+
+static void test_soak_with_a_document_each_time(void)
+{
+    OPMLArena arena(buffer, largest);
+    Soak soaked = soak(&arena, false, SOAK_CYCLES);
+    TEST_ASSERT_EQUAL(largest, arena.Peak());
+    TEST_ASSERT_EQUAL(0, soaked.held);
+    TEST_ASSERT_EQUAL(0, soaked.grown);
+    TEST_ASSERT_EQUAL(0, soaked.left);
+    report("a document each time", arena, soaked);
+}
+
+static void test_soak_with_too_small_an_arena(void)
+{
+    OPMLArena arena(buffer, largest / 4);
+    Soak soaked = soak(&arena, true, SOAK_CYCLES);
+    TEST_ASSERT_TRUE(arena.Peak() <= arena.Size());
+    if (HEAP_COUNTED)
+        TEST_ASSERT_TRUE(soaked.allocations > 1);
+    // the heap blocks the pools fell back to go with each clear, only the
+    // lists of them keep their room
+    TEST_ASSERT_EQUAL(0, soaked.grown);
+    TEST_ASSERT_EQUAL(0, soaked.left);
+    report("arena too small", arena, soaked);
+}
+
+int main(int, char **)
+{
+    corpus = LoadCorpus();
+    UNITY_BEGIN();
+    RUN_TEST(test_largest_page_fits);
+    RUN_TEST(test_soak_with_one_document);
+    RUN_TEST(test_soak_with_a_document_each_time);
+    RUN_TEST(test_soak_with_too_small_an_arena);
+    return UNITY_END();
+}
@@ -0,0 +1,291 @@
+/*
+ * Regression numbers for the parser and the item extraction, over the
+ * corpus: parse throughput of the DOM, of the DOM with the UI's OPMLFilter and
+ * of the stream parser, allocations and
+ * peak heap per document, and the time from the first byte of a response to
+ * the finished UIMenuList, as TuneinApi::loadItems() builds it. Also the
+ * cost per outline of interning attribute names and finding the well-known
+ * attributes, against the string compares they replaced, and what an
+ * element weighs for it.
+ *
+ *     pio test -e native -f test_benchmark -v
+ */
+
+#include <unity.h>
+#include <tinyopml.h>
+#include <chrono>
+
+#include "api/menulist.h"
+#include "api/outlinecollector.h"
+#include "../corpus.h"
+#include "../heap.h"
+
+using namespace tinyopml;
+
+// a TCP segment, about what HTTPClient::writeToStream() passes on at a time
+#define BENCHMARK_CHUNK 1460
+#define BENCHMARK_MIN_US 200000
+
+static std::vector<CorpusPage> corpus;
+// the outlines of the body and its sections, with what OutlineCollector binds
+static OPMLFilter ui_filter;
+
+static uint64_t now_us()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+enum Path
+{
+    DOM,
+    FILTERED,
+    STREAM,
+    MENU
+};
+
+static const char *pathName(Path path)
+{
+    return path == DOM ? "dom" : path == FILTERED ? "filter" : path == STREAM ? "stream" : "menu";
+}
+
+
+
+// runs one of the paths over a document, false if it did not parse
+static bool run(Path path, const std::string &body, uint16_t *items)
+{
+    if (path == DOM || path == FILTERED)
+    {
+        OPMLDocument doc;
+        doc.SetFilter(path == FILTERED ? &ui_filter : NULL);
+        return doc.Parse(body.data(), body.size()) == OPML_SUCCESS;
+    }
+
+    OPMLStreamHandler ignore;
+    UIMenuList *list = (path == MENU) ? new UIMenuList() : NULL;
+    OutlineCollector collector(list, NULL);
+    collector.Accept(FORMAT_MP3 | FORMAT_AAC, 320);
+    collector.OrderBy(OutlineCollector::ByReliability);
+    OPMLStreamParser parser(path == MENU ? (OPMLStreamHandler *)&collector : &ignore);
+    bool ok = true;
+    for (size_t at = 0; ok && at < body.size(); at += BENCHMARK_CHUNK)
+        ok = parser.Feed(body.data() + at, std::min((size_t)BENCHMARK_CHUNK, body.size() - at)) == OPML_SUCCESS;
+    ok = ok && parser.Finish() == OPML_SUCCESS && !collector.out_of_memory;
+    if (list != NULL)
+    {
+        list->Shrink();
+        if (items != NULL)
+            *items = list->Count();
+        list->Release();
+    }
+    return ok;
+}
+
+struct Result
+{
+    double us;          // per document
+    size_t allocations; // per document
+    long peak;          // bytes
+};
+
+static Result measure(Path path, const std::string &body)
+{
+    Result result;
+    HeapStart();
+    TEST_ASSERT_TRUE(run(path, body, NULL));
+    HeapCounters heap = HeapStop();
+    result.allocations = heap.allocations;
+    result.peak = heap.peak;
+
+    // as many rounds as fit in the minimum time, for a stable mean
+    uint32_t rounds = 0;
+    uint64_t started = now_us();
+    uint64_t elapsed;
+    do
+    {
+        run(path, body, NULL);
+        rounds++;
+        elapsed = now_us() - started;
+    } while (elapsed < BENCHMARK_MIN_US);
+    result.us = (double)elapsed / rounds;
+    return result;
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+static void test_corpus_is_there(void)
+{
+    TEST_ASSERT_TRUE_MESSAGE(corpus.size() >= 10, "test/corpus not found, run from the project directory");
+    for (size_t i = 0; i < corpus.size(); i++)
+    {
+        uint16_t items = 0;
+        TEST_ASSERT_TRUE(run(MENU, corpus[i].body, &items));
+        TEST_ASSERT_GREATER_THAN(0, items);
+    }
+}
+
+static void test_benchmark(void)
+{
+    printf("%-8s %7s %6s | %-6s %9s %8s %7s %9s\n", "page", "bytes", "items", "path", "us/doc", "MB/s", "allocs", "peak");
+    double total_us[4] = {0, 0, 0, 0};
+    size_t total_allocations[4] = {0, 0, 0, 0};
+    long peak[4] = {0, 0, 0, 0};
+    size_t total_bytes = 0;
+    for (size_t i = 0; i < corpus.size(); i++)
+    {
+        const CorpusPage &page = corpus[i];
+        uint16_t items = 0;
+        run(MENU, page.body, &items);
+        total_bytes += page.body.size();
+        for (int p = DOM; p <= MENU; p++)
+        {
+            Result r = measure((Path)p, page.body);
+            printf("%-8s %7u %6u | %-6s %9.1f %8.1f %7u %9ld\n", p == DOM ? page.id.c_str() : "", (unsigned)page.body.size(), items,
+                   pathName((Path)p), r.us, page.body.size() / r.us, (unsigned)r.allocations, r.peak);
+            total_us[p] += r.us;
+            total_allocations[p] += r.allocations;
+            if (r.peak > peak[p])
+                peak[p] = r.peak;
+        }
+    }
+
+    printf("\n%u documents, %u bytes%s\n", (unsigned)corpus.size(), (unsigned)total_bytes,
+           HEAP_COUNTED ? "" : ", heap not counted on this host");
+    for (int p = DOM; p <= MENU; p++)
+        printf("%-6s %8.1f MB/s, %6.1f allocations per document, peak %ld bytes, %.1f us for all\n", pathName((Path)p),
+               total_bytes / total_us[p], (double)total_allocations[p] / corpus.size(), peak[p], total_us[p]);
+}
+
+// how attribute lookups were done before attributes kept their id
+static OPMLAttributeId linearId(const char *name)
+{
+    for (int i = OPML_ATTR_UNKNOWN + 1; i < OPML_ATTR_COUNT; ++i)
+    {
+        const char *known = OPMLUtil::AttributeName((OPMLAttributeId)i);
+        if (known[0] == *name && OPMLUtil::StringEqual(known, name))
+            return (OPMLAttributeId)i;
+    }
+    return OPML_ATTR_UNKNOWN;
+}
+
+static const OPMLAttribute *walk(const OPMLElement *outline, OPMLAttributeId id)
+{
+    const char *name = OPMLUtil::AttributeName(id);
+    for (const OPMLAttribute *a = outline->FirstAttribute(); a; a = a->Next())
+    {
+        if (OPMLUtil::StringEqual(a->Name(), name))
+            return a;
+    }
+    return NULL;
+}
+
+static void outlines(const OPMLElement *parent, std::vector<const OPMLElement *> *found)
+{
+    for (const OPMLElement *e = parent->FirstChildElement("outline"); e; e = e->NextSiblingElement("outline"))
+    {
+        found->push_back(e);
+        outlines(e, found);
+    }
+}
+
+enum Lookup
+{
+    NAME_LINEAR,
+    NAME_SWITCH,
+    FIND_NAME,
+    FIND_ID
+};
+
+// one pass of a lookup over every attribute of every outline, a checksum out
+static uintptr_t lookup(Lookup how, const std::vector<const OPMLElement *> &found)
+{
+    uintptr_t sum = 0;
+    for (size_t i = 0; i < found.size(); i++)
+    {
+        if (how == NAME_LINEAR || how == NAME_SWITCH)
+        {
+            for (const OPMLAttribute *a = found[i]->FirstAttribute(); a; a = a->Next())
+                sum += how == NAME_LINEAR ? linearId(a->Name()) : OPMLUtil::AttributeId(a->Name());
+            continue;
+        }
+        for (int id = OPML_ATTR_UNKNOWN + 1; id < OPML_ATTR_COUNT; id++)
+            sum += (uintptr_t)(how == FIND_NAME ? walk(found[i], (OPMLAttributeId)id) : found[i]->FindAttribute((OPMLAttributeId)id));
+    }
+    return sum;
+}
+
+static double nsPerOutline(Lookup how, const std::vector<const OPMLElement *> &found, uintptr_t *sum)
+{
+    uint32_t rounds = 0;
+    uint64_t started = now_us();
+    uint64_t elapsed;
+    do
+    {
+        *sum = lookup(how, found);
+        rounds++;
+        elapsed = now_us() - started;
+    } while (elapsed < BENCHMARK_MIN_US);
+    return elapsed * 1000.0 / rounds / found.size();
+}
+
+static void test_attribute_lookup(void)
+{
+    for (int id = OPML_ATTR_UNKNOWN + 1; id < OPML_ATTR_COUNT; id++)
+        TEST_ASSERT_EQUAL(id, OPMLUtil::AttributeId(OPMLUtil::AttributeName((OPMLAttributeId)id)));
+    TEST_ASSERT_EQUAL(OPML_ATTR_UNKNOWN, OPMLUtil::AttributeId("types"));
+    TEST_ASSERT_EQUAL(OPML_ATTR_UNKNOWN, OPMLUtil::AttributeId("url"));
+    TEST_ASSERT_EQUAL(OPML_ATTR_UNKNOWN, OPMLUtil::AttributeId(""));
+
+    std::vector<OPMLDocument *> docs;
+    std::vector<const OPMLElement *> found;
+    for (size_t i = 0; i < corpus.size(); i++)
+    {
+        OPMLDocument *doc = new OPMLDocument();
+        TEST_ASSERT_EQUAL(OPML_SUCCESS, doc->Parse(corpus[i].body.data(), corpus[i].body.size()));
+        const OPMLElement *body = doc->RootElement()->FirstChildElement("body");
+        TEST_ASSERT_NOT_NULL(body);
+        outlines(body, &found);
+        docs.push_back(doc);
+    }
+    TEST_ASSERT_TRUE(found.size() > 0);
+
+    uintptr_t sums[4];
+    double ns[4];
+    for (int how = NAME_LINEAR; how <= FIND_ID; how++)
+        ns[how] = nsPerOutline((Lookup)how, found, &sums[how]);
+    // the same answers, only sooner
+    TEST_ASSERT_TRUE(sums[NAME_LINEAR] == sums[NAME_SWITCH]);
+    TEST_ASSERT_TRUE(sums[FIND_NAME] == sums[FIND_ID]);
+
+    printf("\n%u outlines, ns per outline, before -> after\n", (unsigned)found.size());
+    printf("intern names   %8.1f -> %8.1f\n", ns[NAME_LINEAR], ns[NAME_SWITCH]);
+    printf("find %2d by id  %8.1f -> %8.1f\n", OPML_ATTR_COUNT - 1, ns[FIND_NAME], ns[FIND_ID]);
+    // the id is a byte in the padding of the attribute, elements keep no table
+    printf("element %u bytes, attribute %u bytes\n", (unsigned)sizeof(OPMLElement), (unsigned)sizeof(OPMLAttribute));
+    for (size_t i = 0; i < docs.size(); i++)
+        delete docs[i];
+}
+
+int main(int, char **)
+{
+    corpus = LoadCorpus();
+    ui_filter.AddPath("opml/body/outline/outline");
+    ui_filter.AddAttribute(OPML_ATTR_TYPE);
+    ui_filter.AddAttribute(OPML_ATTR_GUIDE_ID);
+    ui_filter.AddAttribute(OPML_ATTR_TEXT);
+    ui_filter.AddAttribute(OPML_ATTR_URL);
+    ui_filter.AddAttribute(OPML_ATTR_SUBTEXT);
+    ui_filter.AddAttribute(OPML_ATTR_FORMATS);
+    ui_filter.AddAttribute(OPML_ATTR_BITRATE);
+    ui_filter.AddAttribute(OPML_ATTR_RELIABILITY);
+    UNITY_BEGIN();
+    RUN_TEST(test_corpus_is_there);
+    RUN_TEST(test_benchmark);
+    RUN_TEST(test_attribute_lookup);
+    return UNITY_END();
+}
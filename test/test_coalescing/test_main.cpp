@@ -0,0 +1,194 @@
+/*
+ * Requests for a page that is being fetched already: they share the one
+ * fetch, and cancelling one of them leaves the others served.
+ */
+
+#include <unity.h>
+#include <SPIFFS.h>
+
+#include "tuneinapi.h"
+#include "../fake_transport.h"
+
+#define PAGE "c57943"
+
+static TuneinApi api;
+static FakeTransport server;
+
+// what a request got delivered, its last page and how it ended
+struct Delivery
+{
+    int finals;
+    client_result result;
+    UIMenuList *page;
+};
+
+static void onPage(request_handle, client_result result, UIMenuList *page, void *arg)
+{
+    Delivery *delivery = (Delivery *)arg;
+    if (result == OPML_PARTIAL || result == OPML_STALE)
+    {
+        if (page != NULL)
+            page->Release();
+        return;
+    }
+    delivery->finals++;
+    delivery->result = result;
+    if (delivery->page != NULL)
+        delivery->page->Release();
+    delivery->page = page;
+}
+
+static void release(Delivery *delivery)
+{
+    if (delivery->page != NULL)
+        delivery->page->Release();
+    delivery->page = NULL;
+}
+
+// polls long enough for the worker to be done with everything asked so far
+static void settle()
+{
+    uint32_t started = millis();
+    while (millis() - started < 300)
+    {
+        api.Poll();
+        delay(1);
+    }
+}
+
+void setUp(void)
+{
+    SPIFFS.Clear();
+    api.ClearCache();
+    server.Reset();
+    server.Hold();
+}
+
+void tearDown(void)
+{
+    server.Release();
+    settle();
+}
+
+static void test_same_page_is_fetched_once(void)
+{
+    Delivery first = {}, second = {}, third = {};
+    uint32_t coalesced = api.coalesced;
+    TEST_ASSERT_NOT_EQUAL(0, api.LoadItemsAsync(PAGE, onPage, &first));
+    TEST_ASSERT_TRUE(server.WaitForHeld(1));
+    TEST_ASSERT_NOT_EQUAL(0, api.LoadItemsAsync(PAGE, onPage, &second));
+    TEST_ASSERT_NOT_EQUAL(0, api.LoadItemsAsync(PAGE, onPage, &third));
+    server.Release();
+    settle();
+
+    TEST_ASSERT_EQUAL(1, server.Gets(PAGE));
+    TEST_ASSERT_EQUAL(2, api.coalesced - coalesced);
+    Delivery *all[] = {&first, &second, &third};
+    for (int i = 0; i < 3; i++)
+    {
+        TEST_ASSERT_EQUAL(1, all[i]->finals);
+        TEST_ASSERT_EQUAL(OPML_OK, all[i]->result);
+        TEST_ASSERT_TRUE(all[i]->page == first.page);
+    }
+    TEST_ASSERT_EQUAL(40, first.page->Count());
+    for (int i = 0; i < 3; i++)
+        release(all[i]);
+}
+
+static void test_cancelled_follower_leaves_the_leader_served(void)
+{
+    Delivery leader = {}, follower = {};
+    api.LoadItemsAsync(PAGE, onPage, &leader);
+    TEST_ASSERT_TRUE(server.WaitForHeld(1));
+    request_handle handle = api.LoadItemsAsync(PAGE, onPage, &follower);
+    api.Cancel(handle);
+    server.Release();
+    settle();
+
+    TEST_ASSERT_EQUAL(1, server.Gets(PAGE));
+    TEST_ASSERT_EQUAL(1, leader.finals);
+    TEST_ASSERT_EQUAL(OPML_OK, leader.result);
+    TEST_ASSERT_NOT_NULL(leader.page);
+    TEST_ASSERT_EQUAL(0, follower.finals);
+    release(&leader);
+}
+
+static void test_cancelled_leader_leaves_the_follower_served(void)
+{
+    Delivery leader = {}, follower = {};
+    request_handle handle = api.LoadItemsAsync(PAGE, onPage, &leader);
+    TEST_ASSERT_TRUE(server.WaitForHeld(1));
+    api.LoadItemsAsync(PAGE, onPage, &follower);
+    api.Cancel(handle);
+    server.Release();
+    settle();
+
+    // the fetch went on for the follower, nothing was fetched twice
+    TEST_ASSERT_EQUAL(1, server.Gets(PAGE));
+    TEST_ASSERT_EQUAL(0, leader.finals);
+    TEST_ASSERT_EQUAL(1, follower.finals);
+    TEST_ASSERT_EQUAL(OPML_OK, follower.result);
+    TEST_ASSERT_NOT_NULL(follower.page);
+    TEST_ASSERT_EQUAL(40, follower.page->Count());
+    release(&follower);
+}
+
+static void test_fetch_nobody_waits_for_is_dropped(void)
+{
+    Delivery leader = {}, follower = {};
+    request_handle first = api.LoadItemsAsync(PAGE, onPage, &leader);
+    TEST_ASSERT_TRUE(server.WaitForHeld(1));
+    request_handle second = api.LoadItemsAsync(PAGE, onPage, &follower);
+    api.Cancel(second);
+    api.Cancel(first);
+    server.Release();
+    settle();
+
+    TEST_ASSERT_EQUAL(0, leader.finals);
+    TEST_ASSERT_EQUAL(0, follower.finals);
+
+    // not kept, a new request fetches again and is not joined to the old one
+    Delivery again = {};
+    uint32_t coalesced = api.coalesced;
+    api.LoadItemsAsync(PAGE, onPage, &again);
+    settle();
+    TEST_ASSERT_EQUAL(coalesced, api.coalesced);
+    TEST_ASSERT_EQUAL(2, server.Gets(PAGE));
+    TEST_ASSERT_EQUAL(1, again.finals);
+    TEST_ASSERT_NOT_NULL(again.page);
+    release(&again);
+}
+
+static void test_different_pages_are_not_joined(void)
+{
+    Delivery one = {}, other = {};
+    uint32_t coalesced = api.coalesced;
+    api.LoadItemsAsync(PAGE, onPage, &one);
+    api.LoadItemsAsync("c57922", onPage, &other);
+    server.Release();
+    settle();
+
+    TEST_ASSERT_EQUAL(coalesced, api.coalesced);
+    TEST_ASSERT_EQUAL(1, server.Gets(PAGE));
+    TEST_ASSERT_EQUAL(1, server.Gets("c57922"));
+    TEST_ASSERT_TRUE(one.page != other.page);
+    release(&one);
+    release(&other);
+}
+
+int main(int, char **)
+{
+    server.ServeCorpus();
+    api.SetTransport(&server);
+    // nothing but the requests made here
+    api.SetPrefetchDwell(0);
+    api.StartWorker();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_same_page_is_fetched_once);
+    RUN_TEST(test_cancelled_follower_leaves_the_leader_served);
+    RUN_TEST(test_cancelled_leader_leaves_the_follower_served);
+    RUN_TEST(test_fetch_nobody_waits_for_is_dropped);
+    RUN_TEST(test_different_pages_are_not_joined);
+    return UNITY_END();
+}
@@ -0,0 +1,149 @@
+/*
+ * Compressed responses: gzip is asked for in place of HTTPClient's own
+ * Accept-Encoding, a gzipped page comes out as the plain one, and the
+ * inflater's buffers go back to the heap after each response, or are
+ * allocated once for all of them with INFLATE_KEEP_BUFFERS, as on PSRAM
+ * boards. Prints the bytes on the wire per corpus page, plain and gzipped.
+ *
+ * The inflater runs over zlib here, test/host/rom/miniz.h standing in for
+ * the tinfl of the ESP32 ROM: the bytes and the buffers are those of the
+ * firmware, the time and zlib's own state are not.
+ *
+ *     pio test -e native -f test_compression -v
+ */
+
+#include <unity.h>
+#include <SPIFFS.h>
+
+#include "tuneinapi.h"
+#include "../fake_transport.h"
+#include "../heap.h"
+
+static TuneinApi api;
+static FakeTransport server;
+static std::vector<CorpusPage> corpus;
+
+// a page fetched anew, with nothing of it in memory or in flash
+static UIMenuList *fetch(const char *id)
+{
+    api.ClearCache();
+    api.ClearFlashCache();
+    return api.LoadItems(id);
+}
+
+void setUp(void)
+{
+    SPIFFS.Clear();
+    api.ClearCache();
+    server.Reset();
+    server.compress = false;
+}
+
+void tearDown(void)
+{
+}
+
+static void test_gzip_replaces_the_default_encoding(void)
+{
+    UIMenuList *page = fetch("g61");
+    TEST_ASSERT_NOT_NULL(page);
+    page->Release();
+    // not merged with "identity;q=1,chunked;q=0.1,*;q=0"
+    TEST_ASSERT_EQUAL_STRING("gzip, deflate", server.SentAcceptEncoding("g61").c_str());
+}
+
+static void test_gzipped_page_is_the_plain_one(void)
+{
+    for (size_t i = 0; i < corpus.size(); i++)
+    {
+        const char *id = corpus[i].id.c_str();
+        server.compress = false;
+        UIMenuList *plain = fetch(id);
+        server.compress = true;
+        UIMenuList *gzipped = fetch(id);
+        TEST_ASSERT_NOT_NULL(plain);
+        TEST_ASSERT_NOT_NULL(gzipped);
+        TEST_ASSERT_EQUAL(corpus[i].body.size(), api.Stats().Last().value[FETCH_BODY_BYTES]);
+        TEST_ASSERT_EQUAL(plain->Count(), gzipped->Count());
+        for (uint16_t j = 0; j < plain->Count(); j++)
+        {
+            TEST_ASSERT_EQUAL_STRING(plain->Id(j), gzipped->Id(j));
+            TEST_ASSERT_EQUAL_STRING(plain->Text(j), gzipped->Text(j));
+        }
+        plain->Release();
+        gzipped->Release();
+    }
+}
+
+static void test_inflater_buffers_between_responses(void)
+{
+    char url[API_MAX_URL_LEN];
+    TuneinApi::BrowseUrl("g61", url, sizeof(url));
+    OPMLStreamHandler ignore;
+    TuneinApi fresh("/fresh");
+    fresh.SetTransport(&server);
+    server.compress = true;
+
+    // the server's bookkeeping of the URL is in place from then on
+    TEST_ASSERT_EQUAL(OPML_OK, fresh.LoadOpml(url, &ignore));
+
+    TuneinApi other("/other");
+    other.SetTransport(&server);
+    HeapStart();
+    TEST_ASSERT_EQUAL(OPML_OK, other.LoadOpml(url, &ignore));
+    HeapCounters first = HeapStop();
+    HeapStart();
+    TEST_ASSERT_EQUAL(OPML_OK, other.LoadOpml(url, &ignore));
+    HeapCounters second = HeapStop();
+
+#if INFLATE_KEEP_BUFFERS
+    // the decompressor state and the window, once
+    if (HEAP_COUNTED)
+        TEST_ASSERT_EQUAL(2, first.allocations - second.allocations);
+    TEST_ASSERT_TRUE(second.peak < first.peak);
+#else
+    // allocated for each response and none of it held after
+    if (HEAP_COUNTED)
+        TEST_ASSERT_EQUAL(first.allocations, second.allocations);
+    TEST_ASSERT_TRUE(second.peak >= TINFL_LZ_DICT_SIZE);
+    TEST_ASSERT_TRUE(first.live < TINFL_LZ_DICT_SIZE);
+    TEST_ASSERT_TRUE(second.live < TINFL_LZ_DICT_SIZE);
+#endif
+}
+
+static void test_bytes_on_the_wire(void)
+{
+    printf("%-8s %8s %8s %6s\n", "page", "plain", "gzip", "ratio");
+    size_t total_plain = 0;
+    size_t total_gzip = 0;
+    for (size_t i = 0; i < corpus.size(); i++)
+    {
+        const char *id = corpus[i].id.c_str();
+        server.compress = false;
+        fetch(id)->Release();
+        uint32_t plain = api.Stats().Last().value[FETCH_WIRE_BYTES];
+        server.compress = true;
+        fetch(id)->Release();
+        uint32_t gzip = api.Stats().Last().value[FETCH_WIRE_BYTES];
+        TEST_ASSERT_TRUE(gzip < plain);
+
+        printf("%-8s %8u %8u %5.1f%%\n", id, plain, gzip, 100.0 * gzip / plain);
+        total_plain += plain;
+        total_gzip += gzip;
+    }
+    printf("%-8s %8u %8u %5.1f%%\n", "all", (unsigned)total_plain, (unsigned)total_gzip, 100.0 * total_gzip / total_plain);
+}
+
+int main(int, char **)
+{
+    corpus = LoadCorpus();
+    server.ServeCorpus();
+    api.SetTransport(&server);
+
+    UNITY_BEGIN();
+    RUN_TEST(test_gzip_replaces_the_default_encoding);
+    RUN_TEST(test_gzipped_page_is_the_plain_one);
+    RUN_TEST(test_inflater_buffers_between_responses);
+    RUN_TEST(test_bytes_on_the_wire);
+    return UNITY_END();
+}
@@ -0,0 +1,183 @@
+/*
+ * The UI task and the worker at the same time: requests, cancels, prefetches
+ * and flash windows from the UI loop while the worker fetches and stores
+ * pages. Every request has to complete exactly once, cancelled ones never,
+ * and every page handed out has to be whole. Build with -fsanitize=thread
+ * for the races the assertions cannot see; the volatile request flags are
+ * read without the lock on purpose and get reported too.
+ */
+
+#include <unity.h>
+#include <SPIFFS.h>
+
+#include <unistd.h>
+#include <vector>
+
+#include "tuneinapi.h"
+#include "../fake_transport.h"
+
+#define ROUNDS 4000
+#define MAX_HANDLES 8192
+// the one corpus page over the flash window threshold
+#define LONG_PAGE "g61"
+
+static TuneinApi api;
+static FakeTransport server;
+static std::vector<std::string> ids;
+
+static uint8_t finals[MAX_HANDLES];
+static bool cancelled[MAX_HANDLES];
+static uint32_t bad_pages = 0;
+static uint32_t late_callbacks = 0;
+static uint32_t state = 1;
+
+static uint32_t random(uint32_t bound)
+{
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state % bound;
+}
+
+static bool whole(UIMenuList *page)
+{
+    for (uint16_t i = 0; i < page->Count(); i++)
+    {
+        if (page->Text(i) == NULL || page->Text(i)[0] == 0 || page->Id(i) == NULL)
+            return false;
+    }
+    return true;
+}
+
+static void onPage(request_handle handle, client_result result, UIMenuList *page, void *)
+{
+    if (page != NULL)
+    {
+        if (!whole(page))
+            bad_pages++;
+        page->Release();
+    }
+    if (handle >= MAX_HANDLES)
+        return;
+    if (cancelled[handle])
+        late_callbacks++;
+    if (result != OPML_PARTIAL && result != OPML_STALE)
+        finals[handle]++;
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+static void test_ui_and_worker_together(void)
+{
+    std::vector<request_handle> outstanding;
+    uint32_t windows = 0;
+
+    for (int round = 0; round < ROUNDS; round++)
+    {
+        switch (random(6))
+        {
+        case 0:
+        case 1:
+        {
+            request_handle handle = api.LoadItemsAsync(ids[random(ids.size())].c_str(), onPage, NULL);
+            if (handle != 0 && handle < MAX_HANDLES)
+                outstanding.push_back(handle);
+            break;
+        }
+        case 2:
+            if (!outstanding.empty())
+            {
+                size_t pick = random(outstanding.size());
+                request_handle handle = outstanding[pick];
+                if (finals[handle] == 0)
+                {
+                    cancelled[handle] = true;
+                    api.Cancel(handle);
+                }
+                outstanding.erase(outstanding.begin() + pick);
+            }
+            break;
+        case 3:
+        {
+            // what renderMenu() does for a long page while the worker stores others
+            uint16_t total = 0;
+            UIMenuList *window = api.LoadItemsWindow(LONG_PAGE, random(240), 8, &total);
+            if (window != NULL)
+            {
+                windows++;
+                if (!whole(window) || window->Count() > 8)
+                    bad_pages++;
+                window->Release();
+            }
+            break;
+        }
+        case 4:
+            api.Prefetch(ids[random(ids.size())].c_str());
+            break;
+        default:
+            if (random(8) == 0)
+                api.ClearCache();
+            break;
+        }
+        api.Poll();
+        delay(random(2));
+    }
+
+    // let everything still under way come in
+    uint32_t started = millis();
+    while (millis() - started < 5000)
+    {
+        api.Poll();
+        bool done = true;
+        for (size_t i = 0; i < outstanding.size(); i++)
+            done = done && (cancelled[outstanding[i]] || finals[outstanding[i]] > 0);
+        if (done)
+            break;
+        delay(1);
+    }
+
+    for (request_handle handle = 1; handle < MAX_HANDLES; handle++)
+    {
+        TEST_ASSERT_TRUE(finals[handle] <= 1);
+        if (!cancelled[handle])
+            continue;
+        TEST_ASSERT_EQUAL(0, finals[handle]);
+    }
+    for (size_t i = 0; i < outstanding.size(); i++)
+        TEST_ASSERT_EQUAL(1, finals[outstanding[i]]);
+    TEST_ASSERT_EQUAL(0, late_callbacks);
+    TEST_ASSERT_EQUAL(0, bad_pages);
+    TEST_ASSERT_TRUE(windows > 0);
+}
+
+int main(int, char **)
+{
+    std::vector<CorpusPage> corpus = LoadCorpus();
+    for (size_t i = 0; i < corpus.size(); i++)
+        ids.push_back(corpus[i].id);
+
+    SPIFFS.Clear();
+    server.ServeCorpus();
+    server.chunk_delay_ms = 1;
+    api.SetTransport(&server);
+    api.SetPrefetchDwell(5);
+    api.StartWorker();
+
+    // the long page has to be on flash for the windows to have something to read
+    UIMenuList *page = api.LoadItems(LONG_PAGE);
+    if (page != NULL)
+        page->Release();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_ui_and_worker_together);
+    int failures = UNITY_END();
+    // the worker never stops, the static destructors would pull things from under it
+    fflush(stdout);
+    _exit(failures);
+}
@@ -0,0 +1,202 @@
+/*
+ * OPMLFilter over the corpus: the outlines of the body, nested ones of the
+ * sections included, with the attributes the UI reads. The filtered DOM must
+ * hold the same outlines and values as the whole one, with fewer nodes,
+ * fewer heap calls and a lower peak. Prints both per page, and the parse
+ * time.
+ *
+ *     pio test -e native -f test_filter -v
+ */
+
+#include <unity.h>
+#include <tinyopml.h>
+#include <chrono>
+
+#include "../corpus.h"
+#include "../heap.h"
+
+using namespace tinyopml;
+
+#define BENCHMARK_MIN_US 100000
+
+static std::vector<CorpusPage> corpus;
+static OPMLFilter filter;
+
+// those OutlineCollector binds
+static const OPMLAttributeId kept[] = {OPML_ATTR_TYPE,    OPML_ATTR_GUIDE_ID, OPML_ATTR_TEXT,    OPML_ATTR_URL,
+                                       OPML_ATTR_SUBTEXT, OPML_ATTR_FORMATS,  OPML_ATTR_BITRATE, OPML_ATTR_RELIABILITY};
+
+static uint64_t now_us()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static bool keptAttribute(OPMLAttributeId id)
+{
+    for (size_t i = 0; i < sizeof(kept) / sizeof(kept[0]); i++)
+    {
+        if (kept[i] == id)
+            return true;
+    }
+    return false;
+}
+
+// whether an element at a depth is on one of the filter's paths
+static bool keptElement(const OPMLElement *element, int depth)
+{
+    static const char *const path[] = {"opml", "body", "outline", "outline"};
+    return depth < 4 && strcmp(element->Name(), path[depth]) == 0;
+}
+
+// the elements and the attributes of them the filter keeps
+static void logElement(std::string *log, const OPMLElement *element, int depth)
+{
+    if (!keptElement(element, depth))
+        return;
+    *log += "<";
+    *log += element->Name();
+    for (const OPMLAttribute *a = element->FirstAttribute(); a != NULL; a = a->Next())
+    {
+        if (!keptAttribute(a->Id()))
+            continue;
+        *log += " ";
+        *log += a->Name();
+        *log += "=[";
+        *log += a->Value();
+        *log += "]";
+    }
+    *log += ">\n";
+    for (const OPMLElement *child = element->FirstChildElement(); child != NULL; child = child->NextSiblingElement())
+        logElement(log, child, depth + 1);
+    *log += "</>\n";
+}
+
+static int countNodes(const OPMLNode *node)
+{
+    int nodes = 1;
+    const OPMLElement *element = node->ToElement();
+    if (element != NULL)
+    {
+        for (const OPMLAttribute *a = element->FirstAttribute(); a != NULL; a = a->Next())
+            nodes++;
+    }
+    for (const OPMLNode *child = node->FirstChild(); child != NULL; child = child->NextSibling())
+        nodes += countNodes(child);
+    return nodes;
+}
+
+static std::string keptLog(const OPMLDocument &doc)
+{
+    std::string log;
+    logElement(&log, doc.RootElement(), 0);
+    return log;
+}
+
+static double usPerParse(const std::string &body, const OPMLFilter *with)
+{
+    uint32_t rounds = 0;
+    uint64_t started = now_us();
+    uint64_t elapsed;
+    do
+    {
+        OPMLDocument doc;
+        doc.SetFilter(with);
+        doc.Parse(body.data(), body.size());
+        rounds++;
+        elapsed = now_us() - started;
+    } while (elapsed < BENCHMARK_MIN_US);
+    return (double)elapsed / rounds;
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+static void test_filter_paths(void)
+{
+    OPMLFilter other;
+    TEST_ASSERT_TRUE(other.AddPath("opml/body/outline"));
+    TEST_ASSERT_FALSE(other.AddPath(""));
+    TEST_ASSERT_FALSE(other.AddPath("opml//outline"));
+    TEST_ASSERT_FALSE(other.AddPath("opml/a_name_too_long_to_keep"));
+    TEST_ASSERT_TRUE(other.Match(OPMLFilter::ROOT, "opml", 4) != OPMLFilter::NONE);
+    TEST_ASSERT_TRUE(other.Match(OPMLFilter::ROOT, "body", 4) == OPMLFilter::NONE);
+    int body = other.Match(other.Match(OPMLFilter::ROOT, "opml", 4), "body", 4);
+    TEST_ASSERT_TRUE(body != OPMLFilter::NONE);
+    TEST_ASSERT_TRUE(other.Match(body, "outline", 7) != OPMLFilter::NONE);
+    TEST_ASSERT_TRUE(other.Match(body, "outlines", 8) == OPMLFilter::NONE);
+    // every attribute until one is added
+    TEST_ASSERT_TRUE(other.AttributeAllowed(OPML_ATTR_UNKNOWN));
+    other.AddAttribute(OPML_ATTR_TEXT);
+    TEST_ASSERT_TRUE(other.AttributeAllowed(OPML_ATTR_TEXT));
+    TEST_ASSERT_FALSE(other.AttributeAllowed(OPML_ATTR_URL));
+    TEST_ASSERT_FALSE(other.AttributeAllowed(OPML_ATTR_UNKNOWN));
+}
+
+static void test_filtered_corpus(void)
+{
+    printf("%-8s %7s | %13s %13s %17s %15s\n", "page", "bytes", "nodes", "allocs", "peak", "us/parse");
+    int total_nodes[2] = {0, 0};
+    size_t total_allocations[2] = {0, 0};
+    long total_peak[2] = {0, 0};
+    double total_us[2] = {0, 0};
+    for (size_t i = 0; i < corpus.size(); i++)
+    {
+        const std::string &body = corpus[i].body;
+        OPMLDocument whole;
+        HeapStart();
+        TEST_ASSERT_EQUAL(OPML_SUCCESS, whole.Parse(body.data(), body.size()));
+        HeapCounters whole_heap = HeapStop();
+
+        OPMLDocument doc;
+        doc.SetFilter(&filter);
+        HeapStart();
+        TEST_ASSERT_EQUAL(OPML_SUCCESS, doc.Parse(body.data(), body.size()));
+        HeapCounters heap = HeapStop();
+
+        // the same outlines and values, nothing else
+        TEST_ASSERT_EQUAL_STRING_MESSAGE(keptLog(whole).c_str(), keptLog(doc).c_str(), corpus[i].id.c_str());
+        TEST_ASSERT_NULL(doc.RootElement()->FirstChildElement("head"));
+
+        int nodes[2] = {countNodes(&whole), countNodes(&doc)};
+        TEST_ASSERT_TRUE(nodes[1] < nodes[0]);
+        if (HEAP_COUNTED)
+        {
+            TEST_ASSERT_TRUE(heap.allocations <= whole_heap.allocations);
+            TEST_ASSERT_TRUE(heap.peak < whole_heap.peak);
+        }
+        double us[2] = {usPerParse(body, NULL), usPerParse(body, &filter)};
+        printf("%-8s %7u | %6d %6d %6u %6u %8ld %8ld %7.1f %7.1f\n", corpus[i].id.c_str(), (unsigned)body.size(), nodes[0], nodes[1],
+               (unsigned)whole_heap.allocations, (unsigned)heap.allocations, whole_heap.peak, heap.peak, us[0], us[1]);
+
+        total_nodes[0] += nodes[0];
+        total_nodes[1] += nodes[1];
+        total_allocations[0] += whole_heap.allocations;
+        total_allocations[1] += heap.allocations;
+        total_peak[0] += whole_heap.peak;
+        total_peak[1] += heap.peak;
+        total_us[0] += us[0];
+        total_us[1] += us[1];
+    }
+    printf("%-8s %7s | %6d %6d %6u %6u %8ld %8ld %7.1f %7.1f\n", "all", "", total_nodes[0], total_nodes[1],
+           (unsigned)total_allocations[0], (unsigned)total_allocations[1], total_peak[0], total_peak[1], total_us[0], total_us[1]);
+    if (HEAP_COUNTED)
+        TEST_ASSERT_TRUE(total_allocations[1] < total_allocations[0]);
+}
+
+int main(int, char **)
+{
+    corpus = LoadCorpus();
+    filter.AddPath("opml/body/outline/outline");
+    for (size_t i = 0; i < sizeof(kept) / sizeof(kept[0]); i++)
+        filter.AddAttribute(kept[i]);
+
+    UNITY_BEGIN();
+    RUN_TEST(test_filter_paths);
+    RUN_TEST(test_filtered_corpus);
+    return UNITY_END();
+}
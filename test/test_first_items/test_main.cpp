@@ -0,0 +1,204 @@
+/*
+ * The first screenful of a page, handed out while the rest is loading: the
+ * items in it are in their final place and shape, so the complete page that
+ * follows starts with them and nothing shown moves, stations sorted or not.
+ *
+ *     pio test -e native -f test_first_items -v
+ */
+
+#include <unity.h>
+#include <SPIFFS.h>
+
+#include "tuneinapi.h"
+#include "api/outlinecollector.h"
+#include "../fake_transport.h"
+
+static TuneinApi api;
+static FakeTransport server;
+static std::vector<CorpusPage> corpus;
+
+// the pages a request got delivered
+struct Delivery
+{
+    int partials;
+    UIMenuList *partial;
+    client_result result;
+    UIMenuList *page;
+};
+
+static void onPage(request_handle, client_result result, UIMenuList *page, void *arg)
+{
+    Delivery *delivery = (Delivery *)arg;
+    UIMenuList **kept = (result == OPML_PARTIAL) ? &delivery->partial : &delivery->page;
+    if (result == OPML_PARTIAL)
+        delivery->partials++;
+    else
+        delivery->result = result;
+    if (*kept != NULL)
+        (*kept)->Release();
+    *kept = page;
+}
+
+static void release(Delivery *delivery)
+{
+    if (delivery->partial != NULL)
+        delivery->partial->Release();
+    if (delivery->page != NULL)
+        delivery->page->Release();
+}
+
+// polls long enough for the worker to be done with everything asked so far
+static void settle()
+{
+    uint32_t started = millis();
+    while (millis() - started < 300)
+    {
+        api.Poll();
+        delay(1);
+    }
+}
+
+static void assertPrefix(const UIMenuList *partial, const UIMenuList *page, const char *id)
+{
+    TEST_ASSERT_TRUE_MESSAGE(partial->Count() <= page->Count(), id);
+    for (uint16_t i = 0; i < partial->Count(); i++)
+    {
+        TEST_ASSERT_EQUAL_STRING_MESSAGE(page->Id(i), partial->Id(i), id);
+        TEST_ASSERT_EQUAL_STRING_MESSAGE(page->Text(i), partial->Text(i), id);
+        TEST_ASSERT_EQUAL(page->Type(i), partial->Type(i));
+        TEST_ASSERT_EQUAL(page->Children(i), partial->Children(i));
+    }
+}
+
+// feeds a page to a collector a TCP segment at a time
+static void feed(OutlineCollector *collector, const std::string &body)
+{
+    OPMLStreamParser parser(collector);
+    for (size_t at = 0; at < body.size(); at += 1460)
+        TEST_ASSERT_EQUAL(OPML_SUCCESS, parser.Feed(body.data() + at, std::min((size_t)1460, body.size() - at)));
+    TEST_ASSERT_EQUAL(OPML_SUCCESS, parser.Finish());
+}
+
+struct Snapshot
+{
+    int calls;
+    uint16_t settled;
+    UIMenuList *copy;
+};
+
+static void onFirstItems(const UIMenuList *items, uint16_t settled, void *arg)
+{
+    Snapshot *snapshot = (Snapshot *)arg;
+    snapshot->calls++;
+    snapshot->settled = settled;
+    snapshot->copy = items->Copy(settled);
+}
+
+void setUp(void)
+{
+    SPIFFS.Clear();
+    api.ClearCache();
+    server.Reset();
+}
+
+void tearDown(void)
+{
+}
+
+static void test_first_items_are_a_prefix_of_the_page(void)
+{
+    int partials = 0;
+    for (size_t i = 0; i < corpus.size(); i++)
+    {
+        const char *id = corpus[i].id.c_str();
+        api.ClearCache();
+        api.ClearFlashCache();
+        Delivery delivery = {};
+        TEST_ASSERT_NOT_EQUAL(0, api.LoadItemsAsync(id, onPage, &delivery));
+        settle();
+
+        TEST_ASSERT_EQUAL(OPML_OK, delivery.result);
+        TEST_ASSERT_NOT_NULL(delivery.page);
+        TEST_ASSERT_TRUE(delivery.partials <= 1);
+        if (delivery.partial != NULL)
+        {
+            TEST_ASSERT_TRUE(delivery.partial->Count() >= API_FIRST_ITEMS);
+            assertPrefix(delivery.partial, delivery.page, id);
+            partials++;
+        }
+        release(&delivery);
+    }
+    // the sectioned pages at least, their first section is done early
+    TEST_ASSERT_TRUE(partials > 0);
+}
+
+static void test_sorted_run_is_handed_out_once_complete(void)
+{
+    for (size_t i = 0; i < corpus.size(); i++)
+    {
+        UIMenuList *items = new UIMenuList();
+        OutlineCollector collector(items, NULL);
+        collector.OrderBy(OutlineCollector::ByReliability);
+        Snapshot snapshot = {};
+        collector.OnFirstItems(API_FIRST_ITEMS, onFirstItems, &snapshot);
+        feed(&collector, corpus[i].body);
+
+        TEST_ASSERT_TRUE(snapshot.calls <= 1);
+        if (snapshot.copy != NULL)
+        {
+            TEST_ASSERT_TRUE(snapshot.settled >= API_FIRST_ITEMS);
+            TEST_ASSERT_EQUAL(snapshot.settled, snapshot.copy->Count());
+            assertPrefix(snapshot.copy, items, corpus[i].id.c_str());
+            snapshot.copy->Release();
+        }
+        items->Release();
+    }
+}
+
+static void test_unsorted_page_is_handed_out_at_the_first_items(void)
+{
+    // one long run of stations
+    const std::string *body = NULL;
+    for (size_t i = 0; i < corpus.size(); i++)
+    {
+        if (corpus[i].id == "g61")
+            body = &corpus[i].body;
+    }
+    TEST_ASSERT_NOT_NULL(body);
+
+    UIMenuList *items = new UIMenuList();
+    OutlineCollector collector(items, NULL);
+    Snapshot snapshot = {};
+    collector.OnFirstItems(API_FIRST_ITEMS, onFirstItems, &snapshot);
+    feed(&collector, *body);
+    TEST_ASSERT_EQUAL(1, snapshot.calls);
+    TEST_ASSERT_EQUAL(API_FIRST_ITEMS, snapshot.settled);
+    assertPrefix(snapshot.copy, items, "g61");
+    snapshot.copy->Release();
+
+    // sorted, no station is in place before the last one is in
+    snapshot.calls = 0;
+    UIMenuList *sorted = new UIMenuList();
+    OutlineCollector sorting(sorted, NULL);
+    sorting.OrderBy(OutlineCollector::ByReliability);
+    sorting.OnFirstItems(API_FIRST_ITEMS, onFirstItems, &snapshot);
+    feed(&sorting, *body);
+    TEST_ASSERT_EQUAL(0, snapshot.calls);
+    items->Release();
+    sorted->Release();
+}
+
+int main(int, char **)
+{
+    corpus = LoadCorpus();
+    server.ServeCorpus();
+    api.SetTransport(&server);
+    api.SetPrefetchDwell(0);
+    api.StartWorker();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_first_items_are_a_prefix_of_the_page);
+    RUN_TEST(test_sorted_run_is_handed_out_once_complete);
+    RUN_TEST(test_unsorted_page_is_handed_out_at_the_first_items);
+    return UNITY_END();
+}
@@ -0,0 +1,269 @@
+/*
+ * Windows of stored pages: whatever order a page's items were sorted into,
+ * a window has to hold the same items as the whole page, and only the
+ * strings of its own items. A page read in windows is pinned, neither
+ * evicted nor replaced until it is unpinned, and counted against the budget
+ * all the while.
+ */
+
+#include <unity.h>
+#include <SPIFFS.h>
+
+#include "api/flashcache.h"
+#include "api/outlinecollector.h"
+#include "../corpus.h"
+
+#define WINDOW 9
+
+static FlashCache flash(SPIFFS, 256 * 1024, 64, 24 * 60 * 60);
+
+// a corpus page as TuneinApi keeps it, stations in order of reliability
+static UIMenuList *parse(const char *id)
+{
+    std::vector<CorpusPage> corpus = LoadCorpus();
+    for (size_t i = 0; i < corpus.size(); i++)
+    {
+        if (corpus[i].id != id)
+            continue;
+        UIMenuList *list = new UIMenuList();
+        OutlineCollector collector(list, NULL);
+        collector.Accept(FORMAT_MP3 | FORMAT_AAC, 320);
+        collector.OrderBy(OutlineCollector::ByReliability);
+        OPMLStreamParser parser(&collector);
+        TEST_ASSERT_EQUAL(OPML_SUCCESS, parser.Feed(corpus[i].body.data(), corpus[i].body.size()));
+        TEST_ASSERT_EQUAL(OPML_SUCCESS, parser.Finish());
+        list->Shrink();
+        return list;
+    }
+    TEST_FAIL_MESSAGE("not in the corpus");
+    return NULL;
+}
+
+static void assertSameItem(const UIMenuList *page, uint16_t index, const UIMenuList *window, uint16_t at)
+{
+    char expected[256];
+    char actual[256];
+    TEST_ASSERT_EQUAL(page->Type(index), window->Type(at));
+    TEST_ASSERT_EQUAL_STRING(page->Id(index), window->Id(at));
+    TEST_ASSERT_EQUAL_STRING(page->Text(index), window->Text(at));
+    TEST_ASSERT_EQUAL_STRING(page->Subtext(index), window->Subtext(at));
+    TEST_ASSERT_EQUAL(page->Bitrate(index), window->Bitrate(at));
+    TEST_ASSERT_EQUAL(page->Reliability(index), window->Reliability(at));
+    if (page->Type(index) == SECTION)
+    {
+        TEST_ASSERT_EQUAL(page->Children(index), window->Children(at));
+        return;
+    }
+    page->Url(index, expected, sizeof(expected));
+    window->Url(at, actual, sizeof(actual));
+    TEST_ASSERT_EQUAL_STRING(expected, actual);
+}
+
+// every window of the stored page against the page itself
+static void assertWindows(const char *key, const UIMenuList *page)
+{
+    for (uint16_t first = 0; first < page->Count(); first++)
+    {
+        uint16_t total = 0;
+        UIMenuList *window = flash.LoadWindow(key, first, WINDOW, &total);
+        TEST_ASSERT_NOT_NULL(window);
+        TEST_ASSERT_EQUAL(page->Count(), total);
+        uint16_t expected = page->Count() - first < WINDOW ? page->Count() - first : WINDOW;
+        TEST_ASSERT_EQUAL(expected, window->Count());
+
+        size_t own = 1;
+        for (uint16_t i = 0; i < window->Count(); i++)
+        {
+            assertSameItem(page, first + i, window, i);
+            own += strlen(page->Id(first + i)) + 1 + strlen(page->Text(first + i)) + 1 + strlen(page->Subtext(first + i)) + 1;
+            if (page->Type(first + i) != SECTION)
+                own += strlen(page->Strings() + page->Item(first + i)->url) + 1;
+        }
+        // the window's strings and nothing of the items around it
+        TEST_ASSERT_TRUE(window->StringsSize() <= own);
+        window->Release();
+    }
+}
+
+void setUp(void)
+{
+    SPIFFS.Clear();
+}
+
+void tearDown(void)
+{
+}
+
+static void test_windows_of_a_sorted_page(void)
+{
+    UIMenuList *page = parse("g61");
+    TEST_ASSERT_TRUE(page->Count() > 100);
+    TEST_ASSERT_TRUE(flash.Store("g61", page));
+    assertWindows("g61", page);
+    page->Release();
+}
+
+static void test_windows_of_a_sectioned_page(void)
+{
+    UIMenuList *page = parse("g2748");
+    TEST_ASSERT_TRUE(flash.Store("g2748", page));
+    assertWindows("g2748", page);
+    page->Release();
+}
+
+static void test_windows_of_items_moved_backwards(void)
+{
+    // each item is moved to the front as it comes, the blob ends up reversed
+    UIMenuList *page = new UIMenuList();
+    for (int i = 0; i < 40; i++)
+    {
+        char id[16];
+        char text[32];
+        snprintf(id, sizeof(id), "s%d", i);
+        snprintf(text, sizeof(text), "Station number %d", i);
+        UIStationInfo info = {i % 3 ? "Now playing" : "", (uint16_t)(64 * (i % 4)), (uint8_t)i, FORMAT_MP3};
+        TEST_ASSERT_TRUE(page->Append(AUDIO, id, text, "http://opml.radiotime.com/Tune.ashx?id=s0", &info));
+        page->MoveLast(0);
+    }
+    TEST_ASSERT_TRUE(flash.Store("rev", page));
+    assertWindows("rev", page);
+    page->Release();
+}
+
+static void test_stored_page_loads_whole(void)
+{
+    UIMenuList *page = parse("g61");
+    TEST_ASSERT_TRUE(flash.Store("g61", page));
+    bool stale;
+    UIMenuList *loaded = flash.Load("g61", &stale);
+    TEST_ASSERT_NOT_NULL(loaded);
+    TEST_ASSERT_EQUAL(page->Count(), loaded->Count());
+    for (uint16_t i = 0; i < page->Count(); i++)
+        assertSameItem(page, i, loaded, i);
+    // repacked in item order, the blob is no bigger than it was
+    TEST_ASSERT_TRUE(loaded->StringsSize() <= page->StringsSize());
+    loaded->Release();
+    page->Release();
+}
+
+static void test_items_around_collapsed_sections(void)
+{
+    UIMenuList *page = parse("g2748");
+    TEST_ASSERT_TRUE(flash.Store("g2748", page));
+    // every third item, as the rows of collapsed sections leave them
+    uint16_t indices[WINDOW];
+    uint16_t count = 0;
+    for (uint16_t i = 1; i < page->Count() && count < WINDOW; i += 3)
+        indices[count++] = i;
+    uint16_t total = 0;
+    UIMenuList *window = flash.LoadItems("g2748", indices, count, &total);
+    TEST_ASSERT_NOT_NULL(window);
+    TEST_ASSERT_EQUAL(page->Count(), total);
+    TEST_ASSERT_EQUAL(count, window->Count());
+    for (uint16_t i = 0; i < count; i++)
+        assertSameItem(page, indices[i], window, i);
+    window->Release();
+
+    // out of order is refused rather than read wrong
+    uint16_t backwards[] = {4, 2};
+    TEST_ASSERT_NULL(flash.LoadItems("g2748", backwards, 2, &total));
+    page->Release();
+}
+
+static void test_pinned_page_stays_until_unpinned(void)
+{
+    FlashCache small(SPIFFS, 256 * 1024, 2, 24 * 60 * 60);
+    UIMenuList *page = parse("g61");
+    UIMenuList *other = parse("g2748");
+    TEST_ASSERT_TRUE(small.Store("g61", page));
+    small.Pin("g61");
+
+    // room for two pages: the others go, the pinned one stays
+    TEST_ASSERT_TRUE(small.Store("a", other));
+    TEST_ASSERT_TRUE(small.Store("b", other));
+    uint16_t total = 0;
+    UIMenuList *window = small.LoadWindow("g61", 0, WINDOW, &total);
+    TEST_ASSERT_NOT_NULL(window);
+    TEST_ASSERT_EQUAL(page->Count(), total);
+    window->Release();
+
+    // a newer copy goes aside, the windows still come from the old one
+    TEST_ASSERT_TRUE(small.Store("g61", other));
+    window = small.LoadWindow("g61", 0, WINDOW, &total);
+    TEST_ASSERT_NOT_NULL(window);
+    TEST_ASSERT_EQUAL(page->Count(), total);
+    assertSameItem(page, 0, window, 0);
+    window->Release();
+
+    small.Unpin();
+    window = small.LoadWindow("g61", 0, WINDOW, &total);
+    TEST_ASSERT_NOT_NULL(window);
+    TEST_ASSERT_EQUAL(other->Count(), total);
+    assertSameItem(other, 0, window, 0);
+    window->Release();
+    page->Release();
+    other->Release();
+}
+
+// bytes of the pages in flash, those written aside included
+static size_t stored()
+{
+    size_t used = 0;
+    fs::File files = SPIFFS.open(FLASH_CACHE_DIR);
+    for (fs::File file = files.openNextFile(); file; file = files.openNextFile())
+        used += file.size();
+    return used;
+}
+
+static void test_pinned_page_counts_against_the_budget(void)
+{
+    UIMenuList *page = parse("g61");
+    UIMenuList *other = parse("g2748");
+    TEST_ASSERT_TRUE(flash.Store("g61", page));
+    size_t pinned = stored();
+    TEST_ASSERT_TRUE(flash.Store("a", other));
+    size_t one = stored() - pinned;
+    flash.Clear();
+
+    // the pinned page and one and a half of the others
+    size_t budget = pinned + one + one / 2;
+    FlashCache small(SPIFFS, budget, 64, 24 * 60 * 60);
+    TEST_ASSERT_TRUE(small.Store("g61", page));
+    small.Pin("g61");
+    const char *keys[] = {"a", "b", "c", "d"};
+    for (int i = 0; i < 4; i++)
+    {
+        TEST_ASSERT_TRUE(small.Store(keys[i], other));
+        TEST_ASSERT_TRUE(stored() <= budget);
+    }
+    uint16_t total = 0;
+    UIMenuList *window = small.LoadWindow("g61", 0, WINDOW, &total);
+    TEST_ASSERT_NOT_NULL(window);
+    TEST_ASSERT_EQUAL(page->Count(), total);
+    window->Release();
+
+    // a newer copy written aside counts as well
+    TEST_ASSERT_TRUE(small.Store("g61", other));
+    TEST_ASSERT_TRUE(stored() <= budget);
+    // and with nothing left to evict but the pinned page, it does not fit
+    TEST_ASSERT_FALSE(small.Store("g61", page));
+    TEST_ASSERT_TRUE(stored() <= budget);
+
+    small.Unpin();
+    small.Clear();
+    page->Release();
+    other->Release();
+}
+
+int main(int, char **)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_windows_of_a_sorted_page);
+    RUN_TEST(test_windows_of_a_sectioned_page);
+    RUN_TEST(test_windows_of_items_moved_backwards);
+    RUN_TEST(test_stored_page_loads_whole);
+    RUN_TEST(test_items_around_collapsed_sections);
+    RUN_TEST(test_pinned_page_stays_until_unpinned);
+    RUN_TEST(test_pinned_page_counts_against_the_budget);
+    return UNITY_END();
+}
@@ -0,0 +1,126 @@
+/*
+ * The resolver cache of the API host: addresses are kept for the time to
+ * live, and a failing resolver is given a rest of an eighth of it, the
+ * last known address standing in meanwhile.
+ */
+
+#include <unity.h>
+
+#include "api/hostcache.h"
+
+#define TTL 80000
+#define HOST "opml.radiotime.com"
+
+static bool resolving = true;
+static uint32_t next_address = 1;
+static int asked = 0;
+
+static bool resolve(const char *, uint32_t *address)
+{
+    asked++;
+    if (!resolving)
+        return false;
+    *address = next_address++;
+    return true;
+}
+
+void setUp(void)
+{
+    resolving = true;
+    next_address = 1;
+    asked = 0;
+}
+
+void tearDown(void)
+{
+}
+
+static void test_address_is_kept_for_its_ttl(void)
+{
+    HostCache hosts(resolve, TTL);
+    uint32_t address = 0;
+    TEST_ASSERT_TRUE(hosts.Lookup(HOST, &address, 1000));
+    TEST_ASSERT_EQUAL(1, address);
+    TEST_ASSERT_TRUE(hosts.Lookup(HOST, &address, 1000 + TTL - 1));
+    TEST_ASSERT_EQUAL(1, address);
+    TEST_ASSERT_EQUAL(1, asked);
+
+    TEST_ASSERT_TRUE(hosts.Lookup(HOST, &address, 1000 + TTL));
+    TEST_ASSERT_EQUAL(2, address);
+    TEST_ASSERT_EQUAL(2, asked);
+}
+
+static void test_failing_resolver_is_retried_after_an_eighth_of_the_ttl(void)
+{
+    HostCache hosts(resolve, TTL);
+    uint32_t address = 0;
+    hosts.Lookup(HOST, &address, 1000);
+
+    resolving = false;
+    uint32_t failed_at = 1000 + TTL;
+    TEST_ASSERT_TRUE(hosts.Lookup(HOST, &address, failed_at));
+    TEST_ASSERT_EQUAL(1, address);
+    TEST_ASSERT_EQUAL(2, asked);
+
+    // the last known address, without asking, until the retry is due
+    for (uint32_t t = failed_at; t < failed_at + TTL / 8; t += TTL / 64)
+    {
+        TEST_ASSERT_TRUE(hosts.Lookup(HOST, &address, t));
+        TEST_ASSERT_EQUAL(1, address);
+    }
+    TEST_ASSERT_EQUAL(2, asked);
+    TEST_ASSERT_EQUAL(9, hosts.fallbacks);
+
+    resolving = true;
+    TEST_ASSERT_TRUE(hosts.Lookup(HOST, &address, failed_at + TTL / 8));
+    TEST_ASSERT_EQUAL(3, asked);
+    TEST_ASSERT_EQUAL(2, address);
+}
+
+static void test_expired_address_is_resolved_again_right_away(void)
+{
+    HostCache hosts(resolve, TTL);
+    uint32_t address = 0;
+    hosts.Lookup(HOST, &address, 1000);
+
+    // connecting failed, the resolver itself did not
+    hosts.Expire(HOST);
+    TEST_ASSERT_TRUE(hosts.Lookup(HOST, &address, 1001));
+    TEST_ASSERT_EQUAL(2, asked);
+    TEST_ASSERT_EQUAL(2, address);
+}
+
+static void test_unknown_host_fails_without_an_address(void)
+{
+    HostCache hosts(resolve, TTL);
+    resolving = false;
+    uint32_t address = 0;
+    TEST_ASSERT_FALSE(hosts.Lookup(HOST, &address, 1000));
+    TEST_ASSERT_FALSE(hosts.Lookup(HOST, &address, 1001));
+    TEST_ASSERT_EQUAL(2, asked);
+}
+
+static void test_refresh_renews_in_the_last_quarter(void)
+{
+    HostCache hosts(resolve, TTL);
+    uint32_t address = 0;
+    hosts.Lookup(HOST, &address, 0);
+    TEST_ASSERT_EQUAL(TTL - TTL / 4, hosts.RefreshIn(0));
+
+    hosts.Refresh(TTL - TTL / 4);
+    TEST_ASSERT_EQUAL(1, hosts.refreshes);
+    TEST_ASSERT_TRUE(hosts.Lookup(HOST, &address, TTL + 1));
+    TEST_ASSERT_EQUAL(2, address);
+    TEST_ASSERT_EQUAL(2, asked);
+}
+
+int main(int, char **)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_address_is_kept_for_its_ttl);
+    RUN_TEST(test_failing_resolver_is_retried_after_an_eighth_of_the_ttl);
+    RUN_TEST(test_expired_address_is_resolved_again_right_away);
+    RUN_TEST(test_unknown_host_fails_without_an_address);
+    RUN_TEST(test_refresh_renews_in_the_last_quarter);
+    return UNITY_END();
+}
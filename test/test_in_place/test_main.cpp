@@ -0,0 +1,178 @@
+/*
+ * OPMLDocument::ParseInPlace: the DOM of a caller buffer holds its strings
+ * in that buffer rather than in a copy, is the DOM Parse() makes of the same
+ * document, and the buffer's deleter runs once, when the document is
+ * cleared, parsed again or deleted, whether parsing failed or not.
+ *
+ *     pio test -e native -f test_in_place -v
+ */
+
+#include <unity.h>
+#include <tinyopml.h>
+
+#include "../corpus.h"
+
+using namespace tinyopml;
+
+static std::vector<CorpusPage> corpus;
+static int deleted = 0;
+static char *last_deleted = NULL;
+
+static void deleteBuffer(char *buffer)
+{
+    deleted++;
+    last_deleted = buffer;
+    free(buffer);
+}
+
+// a copy of the document with room for the terminator, as a response buffer
+static char *buffer(const std::string &body)
+{
+    char *p = (char *)malloc(body.size() + 1);
+    memcpy(p, body.data(), body.size());
+    return p;
+}
+
+static bool within(const char *p, const char *start, size_t size)
+{
+    return p >= start && p <= start + size;
+}
+
+// every name and attribute value of the subtree lies within the buffer
+static void assertWithin(const OPMLElement *element, const char *start, size_t size)
+{
+    TEST_ASSERT_TRUE(within(element->Name(), start, size));
+    for (const OPMLAttribute *a = element->FirstAttribute(); a != NULL; a = a->Next())
+    {
+        TEST_ASSERT_TRUE(within(a->Name(), start, size));
+        TEST_ASSERT_TRUE(within(a->Value(), start, size));
+    }
+    for (const OPMLElement *child = element->FirstChildElement(); child != NULL; child = child->NextSiblingElement())
+        assertWithin(child, start, size);
+}
+
+static std::string printed(const OPMLDocument &doc)
+{
+    OPMLPrinter printer;
+    doc.Print(&printer);
+    return printer.CStr();
+}
+
+void setUp(void)
+{
+    deleted = 0;
+    last_deleted = NULL;
+}
+
+void tearDown(void)
+{
+}
+
+static void test_strings_point_into_the_buffer(void)
+{
+    for (size_t i = 0; i < corpus.size(); i++)
+    {
+        const std::string &body = corpus[i].body;
+        OPMLDocument copied;
+        TEST_ASSERT_EQUAL(OPML_SUCCESS, copied.Parse(body.data(), body.size()));
+
+        OPMLDocument doc;
+        char *p = buffer(body);
+        TEST_ASSERT_EQUAL(OPML_SUCCESS, doc.ParseInPlace(p, body.size(), deleteBuffer));
+        TEST_ASSERT_NOT_NULL(doc.RootElement());
+        assertWithin(doc.RootElement(), p, body.size());
+        TEST_ASSERT_EQUAL_STRING_MESSAGE(printed(copied).c_str(), printed(doc).c_str(), corpus[i].id.c_str());
+        // only those of the documents gone before
+        TEST_ASSERT_EQUAL(i, deleted);
+    }
+    // each document let go of its buffer as it went
+    TEST_ASSERT_EQUAL(corpus.size(), deleted);
+}
+
+static void test_deleted_once_on_clear(void)
+{
+    const std::string &body = corpus[0].body;
+    OPMLDocument doc;
+    char *p = buffer(body);
+    TEST_ASSERT_EQUAL(OPML_SUCCESS, doc.ParseInPlace(p, body.size(), deleteBuffer));
+    doc.Clear();
+    TEST_ASSERT_EQUAL(1, deleted);
+    TEST_ASSERT_TRUE(last_deleted == p);
+    TEST_ASSERT_NULL(doc.RootElement());
+    doc.Clear();
+    TEST_ASSERT_EQUAL(1, deleted);
+
+    // a copy is the document's own again, freed without the deleter
+    TEST_ASSERT_EQUAL(OPML_SUCCESS, doc.Parse(body.data(), body.size()));
+    doc.Clear();
+    TEST_ASSERT_EQUAL(1, deleted);
+}
+
+static void test_deleted_once_on_destruction(void)
+{
+    const std::string &body = corpus[0].body;
+    OPMLDocument *doc = new OPMLDocument();
+    char *first = buffer(body);
+    char *second = buffer(body);
+    TEST_ASSERT_EQUAL(OPML_SUCCESS, doc->ParseInPlace(first, body.size(), deleteBuffer));
+    // parsing the next buffer lets go of the first
+    TEST_ASSERT_EQUAL(OPML_SUCCESS, doc->ParseInPlace(second, body.size(), deleteBuffer));
+    TEST_ASSERT_EQUAL(1, deleted);
+    TEST_ASSERT_TRUE(last_deleted == first);
+    delete doc;
+    TEST_ASSERT_EQUAL(2, deleted);
+    TEST_ASSERT_TRUE(last_deleted == second);
+}
+
+static void test_deleted_once_after_an_error(void)
+{
+    // an attribute without a value, the outline before it parsed already
+    const char broken[] = "<opml><body><outline text=\"a\"/><outline text></body></opml>";
+    OPMLDocument *doc = new OPMLDocument();
+    char *p = buffer(std::string(broken));
+    TEST_ASSERT_EQUAL(OPML_ERROR_PARSING_ATTRIBUTE, doc->ParseInPlace(p, sizeof(broken) - 1, deleteBuffer));
+    TEST_ASSERT_NULL(doc->RootElement());
+    TEST_ASSERT_EQUAL(0, deleted);
+    doc->Clear();
+    TEST_ASSERT_EQUAL(1, deleted);
+    TEST_ASSERT_TRUE(last_deleted == p);
+
+    p = buffer(std::string(broken));
+    TEST_ASSERT_EQUAL(OPML_ERROR_PARSING_ATTRIBUTE, doc->ParseInPlace(p, sizeof(broken) - 1, deleteBuffer));
+    delete doc;
+    TEST_ASSERT_EQUAL(2, deleted);
+    TEST_ASSERT_TRUE(last_deleted == p);
+
+    // an empty document is refused, the buffer still handed over
+    OPMLDocument empty;
+    p = buffer(std::string(""));
+    p[0] = 0;
+    TEST_ASSERT_EQUAL(OPML_ERROR_EMPTY_DOCUMENT, empty.ParseInPlace(p, 0, deleteBuffer));
+    empty.Clear();
+    TEST_ASSERT_EQUAL(3, deleted);
+}
+
+static void test_kept_by_the_caller_without_a_deleter(void)
+{
+    const std::string &body = corpus[0].body;
+    char *p = buffer(body);
+    {
+        OPMLDocument doc;
+        TEST_ASSERT_EQUAL(OPML_SUCCESS, doc.ParseInPlace(p, body.size(), NULL));
+        assertWithin(doc.RootElement(), p, body.size());
+    }
+    TEST_ASSERT_EQUAL(0, deleted);
+    free(p);
+}
+
+int main(int, char **)
+{
+    corpus = LoadCorpus();
+    UNITY_BEGIN();
+    RUN_TEST(test_strings_point_into_the_buffer);
+    RUN_TEST(test_deleted_once_on_clear);
+    RUN_TEST(test_deleted_once_on_destruction);
+    RUN_TEST(test_deleted_once_after_an_error);
+    RUN_TEST(test_kept_by_the_caller_without_a_deleter);
+    return UNITY_END();
+}
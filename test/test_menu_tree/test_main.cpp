@@ -0,0 +1,200 @@
+/*
+ * UIMenuTree over a page with sections nested in sections: the rows shown
+ * and the items on them as sections are collapsed and expanded, the row an
+ * item is on or hidden under, and the nesting depth.
+ *
+ *     pio test -e native -f test_menu_tree -v
+ */
+
+#include <unity.h>
+
+#include "api/menutree.h"
+
+static UIMenuList *page;
+
+/*
+ *  0 A         section of 1-5
+ *  1   a1
+ *  2   B       section of 3-4
+ *  3     b1
+ *  4     b2
+ *  5   a2
+ *  6 C
+ *  7 D         section of 8-9
+ *  8   d1
+ *  9   d2
+ * 10 E
+ */
+static UIMenuList *nested()
+{
+    const char *ids[] = {"A", "a1", "B", "b1", "b2", "a2", "C", "D", "d1", "d2", "E"};
+    UIMenuList *list = new UIMenuList();
+    for (size_t i = 0; i < sizeof(ids) / sizeof(ids[0]); i++)
+        TEST_ASSERT_TRUE(list->Append(LINK, ids[i], ids[i], ""));
+    TEST_ASSERT_TRUE(list->SetSection(2, 2));
+    TEST_ASSERT_TRUE(list->SetSection(0, 5));
+    TEST_ASSERT_TRUE(list->SetSection(7, 2));
+    return list;
+}
+
+// the items on the rows, and each of them back on its row
+static void assertRows(const UIMenuTree &tree, const uint16_t *items, uint16_t rows)
+{
+    TEST_ASSERT_EQUAL(rows, tree.Rows(page->Count()));
+    for (uint16_t row = 0; row < rows; row++)
+    {
+        TEST_ASSERT_EQUAL(items[row], tree.ItemAt(row));
+        TEST_ASSERT_EQUAL(row, tree.RowOf(items[row]));
+    }
+}
+
+void setUp(void)
+{
+    page = nested();
+}
+
+void tearDown(void)
+{
+    page->Release();
+}
+
+static void test_sections_start_collapsed(void)
+{
+    UIMenuTree tree;
+    TEST_ASSERT_TRUE(tree.Build(page));
+    TEST_ASSERT_EQUAL(3, tree.Sections());
+    TEST_ASSERT_TRUE(tree.IsSection(0));
+    TEST_ASSERT_TRUE(tree.IsSection(2));
+    TEST_ASSERT_TRUE(tree.IsSection(7));
+    TEST_ASSERT_FALSE(tree.IsSection(6));
+    TEST_ASSERT_FALSE(tree.Expanded(0));
+    TEST_ASSERT_FALSE(tree.Expanded(2));
+    TEST_ASSERT_FALSE(tree.Expanded(7));
+
+    const uint16_t rows[] = {0, 6, 7, 10};
+    assertRows(tree, rows, 4);
+    // hidden items are on the row of the outermost section hiding them
+    TEST_ASSERT_EQUAL(0, tree.RowOf(1));
+    TEST_ASSERT_EQUAL(0, tree.RowOf(3));
+    TEST_ASSERT_EQUAL(0, tree.RowOf(5));
+    TEST_ASSERT_EQUAL(2, tree.RowOf(9));
+}
+
+static void test_nested_section_stays_collapsed(void)
+{
+    UIMenuTree tree;
+    tree.Build(page);
+    TEST_ASSERT_TRUE(tree.Toggle(0));
+    TEST_ASSERT_TRUE(tree.Expanded(0));
+    TEST_ASSERT_FALSE(tree.Expanded(2));
+
+    const uint16_t rows[] = {0, 1, 2, 5, 6, 7, 10};
+    assertRows(tree, rows, 7);
+    TEST_ASSERT_EQUAL(2, tree.RowOf(3));
+    TEST_ASSERT_EQUAL(2, tree.RowOf(4));
+    TEST_ASSERT_EQUAL(5, tree.RowOf(8));
+}
+
+static void test_all_expanded(void)
+{
+    UIMenuTree tree;
+    tree.Build(page);
+    tree.Toggle(0);
+    tree.Toggle(2);
+    tree.Toggle(7);
+
+    const uint16_t rows[] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+    assertRows(tree, rows, 11);
+    TEST_ASSERT_EQUAL(0, tree.Depth(0));
+    TEST_ASSERT_EQUAL(1, tree.Depth(1));
+    TEST_ASSERT_EQUAL(1, tree.Depth(2));
+    TEST_ASSERT_EQUAL(2, tree.Depth(3));
+    TEST_ASSERT_EQUAL(2, tree.Depth(4));
+    TEST_ASSERT_EQUAL(1, tree.Depth(5));
+    TEST_ASSERT_EQUAL(0, tree.Depth(6));
+    TEST_ASSERT_EQUAL(1, tree.Depth(9));
+    TEST_ASSERT_EQUAL(0, tree.Depth(10));
+}
+
+static void test_collapsed_parent_hides_an_expanded_section(void)
+{
+    UIMenuTree tree;
+    tree.Build(page);
+    tree.Toggle(0);
+    tree.Toggle(2);
+    tree.Toggle(0);
+    // B keeps its state for when A is expanded again
+    TEST_ASSERT_FALSE(tree.Expanded(0));
+    TEST_ASSERT_TRUE(tree.Expanded(2));
+
+    const uint16_t rows[] = {0, 6, 7, 10};
+    assertRows(tree, rows, 4);
+    TEST_ASSERT_EQUAL(0, tree.RowOf(4));
+
+    tree.Toggle(0);
+    const uint16_t expanded[] = {0, 1, 2, 3, 4, 5, 6, 7, 10};
+    assertRows(tree, expanded, 9);
+}
+
+static void test_only_sections_toggle(void)
+{
+    UIMenuTree tree;
+    tree.Build(page);
+    TEST_ASSERT_FALSE(tree.Toggle(1));
+    TEST_ASSERT_FALSE(tree.Toggle(6));
+    TEST_ASSERT_FALSE(tree.Toggle(11));
+    TEST_ASSERT_EQUAL(4, tree.Rows(page->Count()));
+}
+
+static void test_rebuilt_page_keeps_sections_open(void)
+{
+    UIMenuTree tree;
+    tree.Build(page);
+    tree.Toggle(0);
+    tree.Toggle(7);
+
+    // the page continued: the same sections, one more item after them
+    page->Append(LINK, "F", "F", "");
+    TEST_ASSERT_TRUE(tree.Build(page, true));
+    TEST_ASSERT_TRUE(tree.Expanded(0));
+    TEST_ASSERT_FALSE(tree.Expanded(2));
+    TEST_ASSERT_TRUE(tree.Expanded(7));
+    const uint16_t rows[] = {0, 1, 2, 5, 6, 7, 8, 9, 10, 11};
+    assertRows(tree, rows, 10);
+
+    // another page starts collapsed
+    TEST_ASSERT_TRUE(tree.Build(page));
+    TEST_ASSERT_FALSE(tree.Expanded(0));
+    TEST_ASSERT_FALSE(tree.Expanded(7));
+}
+
+static void test_flat_page_has_a_row_per_item(void)
+{
+    UIMenuList *flat = new UIMenuList();
+    for (int i = 0; i < 5; i++)
+        flat->Append(AUDIO, "s", "station", "");
+    UIMenuTree tree;
+    TEST_ASSERT_TRUE(tree.Build(flat));
+    TEST_ASSERT_EQUAL(0, tree.Sections());
+    TEST_ASSERT_EQUAL(5, tree.Rows(5));
+    for (uint16_t row = 0; row < 5; row++)
+    {
+        TEST_ASSERT_EQUAL(row, tree.ItemAt(row));
+        TEST_ASSERT_EQUAL(row, tree.RowOf(row));
+        TEST_ASSERT_EQUAL(0, tree.Depth(row));
+    }
+    flat->Release();
+}
+
+int main(int, char **)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_sections_start_collapsed);
+    RUN_TEST(test_nested_section_stays_collapsed);
+    RUN_TEST(test_all_expanded);
+    RUN_TEST(test_collapsed_parent_hides_an_expanded_section);
+    RUN_TEST(test_only_sections_toggle);
+    RUN_TEST(test_rebuilt_page_keeps_sections_open);
+    RUN_TEST(test_flat_page_has_a_row_per_item);
+    return UNITY_END();
+}
@@ -0,0 +1,191 @@
+/*
+ * The cursor on a long page: the page is held as a window of rows around it,
+ * read again from the flash cache whenever the cursor gets near its edge or a
+ * section is expanded or collapsed, so every row reached holds the item of
+ * the whole page, and the category under the cursor is prefetched once it
+ * rested there.
+ *
+ *     pio test -e native -f test_menu_view -v
+ */
+
+#include <unity.h>
+#include <SPIFFS.h>
+
+#include "menuview.h"
+#include "../fake_transport.h"
+
+static TuneinApi api;
+static FakeTransport server;
+
+// polls long enough for the worker to be done with everything asked so far
+static void settle()
+{
+    uint32_t started = millis();
+    while (millis() - started < 300)
+    {
+        api.Poll();
+        delay(1);
+    }
+}
+
+// the item on a row is held and is the one of the whole page
+static void assertRow(const UIMenuView &view, const UIMenuList *whole, uint16_t row)
+{
+    uint16_t index;
+    TEST_ASSERT_TRUE(view.Held(row, &index));
+    TEST_ASSERT_EQUAL_STRING(whole->Id(view.Tree().ItemAt(row)), view.Items()->Id(index));
+}
+
+void setUp(void)
+{
+    SPIFFS.Clear();
+    api.ClearCache();
+    api.ClearFlashCache();
+    api.SetPrefetchDwell(0);
+    server.Reset();
+}
+
+void tearDown(void)
+{
+}
+
+static void test_cursor_moves_the_window(void)
+{
+    // stored in flash as it is loaded
+    UIMenuList *whole = api.LoadItems("g61");
+    TEST_ASSERT_NOT_NULL(whole);
+    uint16_t total = whole->Count();
+    TEST_ASSERT_TRUE(total > 4 * UI_MENU_WINDOW);
+    whole->Retain();
+
+    UIMenuView view(&api);
+    view.Show("g61", whole, 0, true);
+    TEST_ASSERT_EQUAL(total, view.Total());
+    TEST_ASSERT_EQUAL(UI_MENU_WINDOW, view.Items()->Count());
+    TEST_ASSERT_EQUAL(0, view.First());
+
+    // down to the last row, a window read again every so often
+    int windows = 0;
+    uint16_t first = view.First();
+    for (uint16_t row = 0; row < total; row++)
+    {
+        view.Select(row);
+        TEST_ASSERT_EQUAL(row, view.Selected());
+        TEST_ASSERT_TRUE(row >= view.Top() && row < view.Top() + UI_MENU_ROWS);
+        TEST_ASSERT_EQUAL(UI_MENU_WINDOW, view.Items()->Count());
+        for (uint16_t shown = view.Top(); shown < view.Top() + UI_MENU_ROWS; shown++)
+            assertRow(view, whole, shown);
+        if (view.First() != first)
+        {
+            TEST_ASSERT_TRUE(view.First() > first);
+            first = view.First();
+            windows++;
+        }
+    }
+    TEST_ASSERT_TRUE(windows >= total / UI_MENU_WINDOW);
+    TEST_ASSERT_EQUAL(total - UI_MENU_WINDOW, view.First());
+
+    // and straight back to the top
+    view.Select(0);
+    TEST_ASSERT_EQUAL(0, view.First());
+    TEST_ASSERT_EQUAL(0, view.Top());
+    assertRow(view, whole, 0);
+    // nothing of it was fetched again
+    TEST_ASSERT_EQUAL(1, server.Gets("g61"));
+    whole->Release();
+}
+
+static void test_short_page_is_held_whole(void)
+{
+    UIMenuList *page = api.LoadItems("c57920");
+    TEST_ASSERT_NOT_NULL(page);
+    UIMenuView view(&api);
+    view.Show("c57920", page, 0, true);
+    for (uint16_t row = 0; row < view.Rows(); row++)
+    {
+        view.Select(row);
+        TEST_ASSERT_TRUE(view.Items() == page);
+        assertRow(view, page, row);
+    }
+}
+
+static void test_sections_expand_within_the_window(void)
+{
+    UIMenuList *whole = api.LoadItems("l127");
+    TEST_ASSERT_NOT_NULL(whole);
+    uint16_t total = whole->Count();
+    whole->Retain();
+
+    // collapsed, the groups of the page fit on a screen or two
+    UIMenuView view(&api);
+    view.Show("l127", whole, 0, true);
+    TEST_ASSERT_TRUE(view.Rows() < UI_MENU_WINDOW);
+    uint16_t stations = UINT16_MAX;
+    for (uint16_t row = 0; row < view.Rows(); row++)
+    {
+        assertRow(view, whole, row);
+        uint16_t item = view.Tree().ItemAt(row);
+        if (stations == UINT16_MAX && view.Tree().IsSection(item) && whole->Children(item) > UI_MENU_WINDOW)
+            stations = row;
+    }
+    TEST_ASSERT_TRUE(stations != UINT16_MAX);
+
+    // expanded, its stations are read in windows as the cursor goes down
+    TEST_ASSERT_TRUE(view.Toggle(stations));
+    TEST_ASSERT_TRUE(view.Tree().Expanded(view.Tree().ItemAt(stations)));
+    TEST_ASSERT_TRUE(view.Rows() > UI_MENU_WINDOW);
+    TEST_ASSERT_TRUE(view.Rows() <= total);
+    for (uint16_t row = 0; row < view.Rows(); row++)
+    {
+        view.Select(row);
+        assertRow(view, whole, row);
+    }
+    TEST_ASSERT_TRUE(view.First() > 0);
+
+    // and collapsed again from the bottom
+    view.Select(stations);
+    TEST_ASSERT_TRUE(view.Toggle(stations));
+    TEST_ASSERT_TRUE(view.Rows() < UI_MENU_WINDOW);
+    for (uint16_t row = 0; row < view.Rows(); row++)
+    {
+        view.Select(row);
+        assertRow(view, whole, row);
+    }
+    TEST_ASSERT_EQUAL(1, server.Gets("l127"));
+    whole->Release();
+}
+
+static void test_cursor_prefetches_the_category_under_it(void)
+{
+    UIMenuList *page = api.LoadItems("c57925");
+    TEST_ASSERT_NOT_NULL(page);
+    page->Retain();
+    api.SetPrefetchDwell(1);
+    UIMenuView view(&api);
+    view.Show("c57925", page, 0, true);
+    settle();
+    TEST_ASSERT_EQUAL(1, server.Gets(page->Id(0)));
+
+    // from a window read on the way down
+    uint16_t row = page->Count() - 1;
+    view.Select(row);
+    TEST_ASSERT_TRUE(view.First() > 0);
+    settle();
+    TEST_ASSERT_EQUAL(1, server.Gets(page->Id(row)));
+    TEST_ASSERT_EQUAL(0, server.Gets(page->Id(1)));
+    page->Release();
+}
+
+int main(int, char **)
+{
+    server.ServeCorpus();
+    api.SetTransport(&server);
+    api.StartWorker();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_cursor_moves_the_window);
+    RUN_TEST(test_short_page_is_held_whole);
+    RUN_TEST(test_sections_expand_within_the_window);
+    RUN_TEST(test_cursor_prefetches_the_category_under_it);
+    return UNITY_END();
+}
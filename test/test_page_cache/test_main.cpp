@@ -0,0 +1,207 @@
+/*
+ * The memory cache of browsed pages: pages visited again are not fetched
+ * again, and the least recently used ones go once the byte budget is full.
+ * Pages older than the time to live come back flagged as stale.
+ */
+
+#include <unity.h>
+#include <SPIFFS.h>
+
+#include "tuneinapi.h"
+#include "api/pagecache.h"
+#include "../fake_transport.h"
+
+static TuneinApi api;
+static FakeTransport server;
+
+// a page of the given number of links, about 40 bytes each
+static UIMenuList *page(int links)
+{
+    UIMenuList *list = new UIMenuList();
+    for (int i = 0; i < links; i++)
+    {
+        char id[16];
+        snprintf(id, sizeof(id), "g%d", i);
+        list->Append(LINK, id, "A category", "http://opml.radiotime.com/Browse.ashx?id=g0");
+    }
+    return list;
+}
+
+void setUp(void)
+{
+    SPIFFS.Clear();
+    api.ClearCache();
+    server.Reset();
+}
+
+void tearDown(void)
+{
+}
+
+static void test_repeat_visit_is_not_fetched_again(void)
+{
+    UIMenuList *first = api.LoadItems("r0");
+    TEST_ASSERT_NOT_NULL(first);
+    TEST_ASSERT_EQUAL(1, server.Gets("r0"));
+
+    UIMenuList *again = api.LoadItems("r0");
+    TEST_ASSERT_TRUE(again == first);
+    TEST_ASSERT_EQUAL(1, server.Gets("r0"));
+    first->Release();
+    again->Release();
+}
+
+static void test_going_back_is_not_fetched_again(void)
+{
+    const char *path[] = {"r0", "c57943", "g2748", "c57943", "r0", "c57922", "r0"};
+    for (size_t i = 0; i < sizeof(path) / sizeof(path[0]); i++)
+    {
+        UIMenuList *items = api.LoadItems(path[i]);
+        TEST_ASSERT_NOT_NULL(items);
+        items->Release();
+    }
+    TEST_ASSERT_EQUAL(4, server.total);
+    TEST_ASSERT_EQUAL(1, server.Gets("r0"));
+    TEST_ASSERT_EQUAL(1, server.Gets("c57943"));
+}
+
+static void test_least_recently_used_goes_first(void)
+{
+    UIMenuList *probe = page(10);
+    size_t size = probe->MemoryUsage();
+    probe->Release();
+    PageCache cache(3 * size);
+
+    const char *keys[] = {"a", "b", "c"};
+    for (int i = 0; i < 3; i++)
+    {
+        UIMenuList *p = page(10);
+        cache.Put(keys[i], p);
+        p->Release();
+    }
+    // "a" is used, so "b" is now the least recently used
+    UIMenuList *a = cache.Get("a");
+    TEST_ASSERT_NOT_NULL(a);
+    a->Release();
+
+    UIMenuList *d = page(10);
+    cache.Put("d", d);
+    d->Release();
+    TEST_ASSERT_EQUAL(1, cache.evictions);
+    TEST_ASSERT_TRUE(cache.Contains("a"));
+    TEST_ASSERT_FALSE(cache.Contains("b"));
+    TEST_ASSERT_TRUE(cache.Contains("c"));
+    TEST_ASSERT_TRUE(cache.Contains("d"));
+}
+
+static void test_size_stays_within_budget(void)
+{
+    PageCache cache(16 * 1024);
+    uint32_t state = 7;
+    for (int i = 0; i < 2000; i++)
+    {
+        state = state * 1103515245 + 12345;
+        char key[16];
+        snprintf(key, sizeof(key), "g%u", (unsigned)(state >> 16) % 64);
+        if ((state >> 8) % 3 == 0)
+        {
+            UIMenuList *hit = cache.Get(key);
+            if (hit != NULL)
+                hit->Release();
+            continue;
+        }
+        UIMenuList *p = page(1 + (state >> 4) % 120);
+        cache.Put(key, p);
+        p->Release();
+        TEST_ASSERT_LESS_OR_EQUAL(cache.Budget(), cache.Size());
+    }
+    TEST_ASSERT_GREATER_THAN(0, cache.evictions);
+    TEST_ASSERT_GREATER_THAN(0, cache.hits);
+}
+
+static void test_page_over_budget_is_not_kept(void)
+{
+    PageCache cache(256);
+    UIMenuList *p = page(50);
+    cache.Put("big", p);
+    TEST_ASSERT_FALSE(cache.Contains("big"));
+    TEST_ASSERT_EQUAL(0, cache.Size());
+    p->Release();
+}
+
+static void test_evicted_page_stays_valid_for_its_holder(void)
+{
+    UIMenuList *probe = page(10);
+    PageCache cache(probe->MemoryUsage());
+    cache.Put("shown", probe);
+    UIMenuList *other = page(10);
+    cache.Put("other", other);
+    other->Release();
+    TEST_ASSERT_FALSE(cache.Contains("shown"));
+    // the UI still holds the first page
+    TEST_ASSERT_EQUAL(10, probe->Count());
+    TEST_ASSERT_EQUAL_STRING("g9", probe->Id(9));
+    probe->Release();
+}
+
+static void test_old_page_is_returned_as_stale(void)
+{
+    PageCache cache(16 * 1024, 1000);
+    UIMenuList *p = page(10);
+    cache.Put("a", p, 5000);
+    p->Release();
+
+    bool stale = true;
+    UIMenuList *hit = cache.Get("a", 6000, &stale);
+    TEST_ASSERT_NOT_NULL(hit);
+    TEST_ASSERT_FALSE(stale);
+    hit->Release();
+    hit = cache.Get("a", 6001, &stale);
+    TEST_ASSERT_NOT_NULL(hit);
+    TEST_ASSERT_TRUE(stale);
+    TEST_ASSERT_EQUAL(1, cache.stale);
+    TEST_ASSERT_EQUAL(2, cache.hits);
+
+    // put again once revalidated, it is fresh for another time to live
+    cache.Put("a", hit, 6001);
+    hit->Release();
+    hit = cache.Get("a", 7000, &stale);
+    TEST_ASSERT_FALSE(stale);
+    hit->Release();
+
+    // across the wrap of the millisecond counter
+    p = page(10);
+    cache.Put("b", p, UINT32_MAX - 100);
+    p->Release();
+    hit = cache.Get("b", 500, &stale);
+    TEST_ASSERT_FALSE(stale);
+    hit->Release();
+    hit = cache.Get("b", 1000, &stale);
+    TEST_ASSERT_TRUE(stale);
+    hit->Release();
+
+    // without a time to live pages are never stale
+    PageCache forever(16 * 1024);
+    p = page(10);
+    forever.Put("a", p, 0);
+    p->Release();
+    hit = forever.Get("a", UINT32_MAX / 2, &stale);
+    TEST_ASSERT_FALSE(stale);
+    hit->Release();
+}
+
+int main(int, char **)
+{
+    server.ServeCorpus();
+    api.SetTransport(&server);
+
+    UNITY_BEGIN();
+    RUN_TEST(test_repeat_visit_is_not_fetched_again);
+    RUN_TEST(test_going_back_is_not_fetched_again);
+    RUN_TEST(test_least_recently_used_goes_first);
+    RUN_TEST(test_size_stays_within_budget);
+    RUN_TEST(test_page_over_budget_is_not_kept);
+    RUN_TEST(test_evicted_page_stays_valid_for_its_holder);
+    RUN_TEST(test_old_page_is_returned_as_stale);
+    return UNITY_END();
+}
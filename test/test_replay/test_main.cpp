@@ -0,0 +1,133 @@
+/*
+ * Recording the corpus as served, replaying it, and the navigation benchmark
+ * over the replay, which prints the time to menu per profile. The benchmark
+ * has to leave the player's flash cache as it was.
+ */
+
+#include <unity.h>
+#include <SPIFFS.h>
+
+#include "tuneinapi.h"
+#include "benchmark.h"
+#include "api/replay.h"
+#include "../fake_transport.h"
+
+static TuneinApi api;
+static FakeTransport server;
+static std::vector<CorpusPage> corpus;
+
+// the benchmark's report, echoed to stdout as it comes
+class Capture : public Print
+{
+public:
+    std::string text;
+
+    size_t write(uint8_t c) override
+    {
+        text += (char)c;
+        putchar(c);
+        return 1;
+    }
+};
+
+static std::string stored(const char *name)
+{
+    std::string bytes;
+    fs::File file = SPIFFS.open(name, FILE_READ);
+    for (int c = file ? file.read() : -1; c >= 0; c = file.read())
+        bytes += (char)c;
+    return bytes;
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+static void test_corpus_is_recorded(void)
+{
+    RecordingTransport recorder(&server, SPIFFS);
+    api.SetTransport(&recorder);
+    for (size_t i = 0; i < corpus.size(); i++)
+    {
+        UIMenuList *page = api.LoadItems(corpus[i].id.c_str());
+        TEST_ASSERT_NOT_NULL(page);
+        page->Release();
+    }
+    api.SetTransport(NULL);
+    TEST_ASSERT_EQUAL(corpus.size(), recorder.recorded);
+
+    ReplayTransport replay(SPIFFS, &replay_profiles[0]);
+    char url[API_MAX_URL_LEN];
+    for (size_t i = 0; i < corpus.size(); i++)
+    {
+        TuneinApi::BrowseUrl(corpus[i].id.c_str(), url, sizeof(url));
+        TEST_ASSERT_TRUE(replay.Has(url));
+    }
+    TuneinApi::BrowseUrl("nowhere", url, sizeof(url));
+    TEST_ASSERT_FALSE(replay.Has(url));
+}
+
+static void test_replayed_page_is_the_served_one(void)
+{
+    TuneinApi replayed("/replayed");
+    ReplayTransport replay(SPIFFS, &replay_profiles[0]);
+    replayed.SetTransport(&replay);
+    api.ClearCache();
+    for (size_t i = 0; i < corpus.size(); i++)
+    {
+        const char *id = corpus[i].id.c_str();
+        UIMenuList *expected = api.LoadItems(id);
+        UIMenuList *actual = replayed.LoadItems(id);
+        TEST_ASSERT_NOT_NULL(expected);
+        TEST_ASSERT_NOT_NULL(actual);
+        TEST_ASSERT_EQUAL(expected->Count(), actual->Count());
+        for (uint16_t j = 0; j < expected->Count(); j++)
+            TEST_ASSERT_EQUAL_STRING(expected->Id(j), actual->Id(j));
+        expected->Release();
+        actual->Release();
+    }
+    replayed.ClearFlashCache();
+}
+
+static void test_benchmark_leaves_the_flash_cache_alone(void)
+{
+    std::string before = stored(FLASH_CACHE_DIR "/g61.pg");
+    TEST_ASSERT_TRUE(before.size() > 0);
+    int gets = server.total;
+
+    Capture out;
+    NavigationBenchmark(SPIFFS).Run(out);
+
+    // every step found its page in the recording
+    for (uint8_t i = 0; i < REPLAY_PROFILES; i++)
+    {
+        char line[64];
+        snprintf(line, sizeof(line), "%s: %u menus", replay_profiles[i].name, BENCHMARK_STEPS);
+        TEST_ASSERT_TRUE(out.text.find(line) != std::string::npos);
+    }
+    TEST_ASSERT_TRUE(out.text.find("failed, 0 not recorded") != std::string::npos);
+    TEST_ASSERT_EQUAL(gets, server.total);
+
+    // the player's pages are still there, its own and nothing of the benchmark's
+    TEST_ASSERT_TRUE(stored(FLASH_CACHE_DIR "/g61.pg") == before);
+    fs::File bench = SPIFFS.open(BENCHMARK_CACHE_DIR);
+    TEST_ASSERT_FALSE(bench && bench.openNextFile());
+}
+
+int main(int, char **)
+{
+    corpus = LoadCorpus();
+    SPIFFS.Clear();
+    server.ServeCorpus();
+    api.SetTransport(&server);
+
+    UNITY_BEGIN();
+    RUN_TEST(test_corpus_is_recorded);
+    RUN_TEST(test_replayed_page_is_the_served_one);
+    RUN_TEST(test_benchmark_leaves_the_flash_cache_alone);
+    return UNITY_END();
+}
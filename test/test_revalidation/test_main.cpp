@@ -0,0 +1,246 @@
+/*
+ * Pages stored in flash, and pages in memory past their time to live, are
+ * revalidated with the validators they were served with: a 304 keeps the
+ * stored copy, a 200 replaces it along with its validators.
+ */
+
+#include <unity.h>
+#include <SPIFFS.h>
+
+#include "tuneinapi.h"
+#include "../fake_transport.h"
+
+#define PAGE "g100"
+#define MONDAY "Mon, 05 Oct 2026 08:00:00 GMT"
+#define TUESDAY "Tue, 06 Oct 2026 08:00:00 GMT"
+
+static TuneinApi api;
+static FakeTransport server;
+
+// a page of categories, named after the given version
+static std::string opml(const char *version, int links)
+{
+    std::string body = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<opml version=\"1\"><head><title>Test</title></head><body>\n";
+    for (int i = 0; i < links; i++)
+    {
+        char line[192];
+        snprintf(line, sizeof(line), "<outline type=\"link\" text=\"%s %d\" URL=\"http://opml.radiotime.com/Browse.ashx?id=g%d\" guide_id=\"g%d\"/>\n",
+                 version, i, i, i);
+        body += line;
+    }
+    return body + "</body></opml>\n";
+}
+
+// loads the page as the UI would after a restart, with nothing in memory
+static UIMenuList *visit()
+{
+    api.ClearCache();
+    return api.LoadItems(PAGE);
+}
+
+void setUp(void)
+{
+    SPIFFS.Clear();
+    api.ClearCache();
+    server.Reset();
+}
+
+void tearDown(void)
+{
+}
+
+static void test_unchanged_page_is_confirmed_with_its_etag(void)
+{
+    server.Serve(PAGE, opml("first", 3), "\"v1\"", MONDAY);
+    UIMenuList *page = visit();
+    TEST_ASSERT_NOT_NULL(page);
+    TEST_ASSERT_EQUAL_STRING("", server.SentEtag(PAGE).c_str());
+    page->Release();
+
+    uint32_t not_modified = api.not_modified;
+    page = visit();
+    TEST_ASSERT_NOT_NULL(page);
+    TEST_ASSERT_EQUAL(2, server.Gets(PAGE));
+    TEST_ASSERT_EQUAL_STRING("\"v1\"", server.SentEtag(PAGE).c_str());
+    TEST_ASSERT_EQUAL_STRING(MONDAY, server.SentModifiedSince(PAGE).c_str());
+    TEST_ASSERT_EQUAL(1, server.not_modified);
+    TEST_ASSERT_EQUAL(not_modified + 1, api.not_modified);
+    // the stored copy, as it was served the first time
+    TEST_ASSERT_EQUAL(3, page->Count());
+    TEST_ASSERT_EQUAL_STRING("first 2", page->Text(2));
+    page->Release();
+}
+
+static void test_changed_page_replaces_the_stored_one(void)
+{
+    server.Serve(PAGE, opml("first", 3), "\"v1\"", MONDAY);
+    visit()->Release();
+
+    server.Serve(PAGE, opml("second", 5), "\"v2\"", TUESDAY);
+    UIMenuList *page = visit();
+    TEST_ASSERT_NOT_NULL(page);
+    TEST_ASSERT_EQUAL_STRING("\"v1\"", server.SentEtag(PAGE).c_str());
+    TEST_ASSERT_EQUAL(0, server.not_modified);
+    TEST_ASSERT_EQUAL(5, page->Count());
+    TEST_ASSERT_EQUAL_STRING("second 4", page->Text(4));
+    page->Release();
+
+    // stored with the new validators, which the next visit sends
+    page = visit();
+    TEST_ASSERT_EQUAL_STRING("\"v2\"", server.SentEtag(PAGE).c_str());
+    TEST_ASSERT_EQUAL_STRING(TUESDAY, server.SentModifiedSince(PAGE).c_str());
+    TEST_ASSERT_EQUAL(1, server.not_modified);
+    TEST_ASSERT_EQUAL(5, page->Count());
+    TEST_ASSERT_EQUAL_STRING("second 4", page->Text(4));
+    page->Release();
+}
+
+static void test_last_modified_alone_is_enough(void)
+{
+    server.Serve(PAGE, opml("first", 3), "", MONDAY);
+    visit()->Release();
+
+    UIMenuList *page = visit();
+    TEST_ASSERT_NOT_NULL(page);
+    TEST_ASSERT_EQUAL_STRING("", server.SentEtag(PAGE).c_str());
+    TEST_ASSERT_EQUAL_STRING(MONDAY, server.SentModifiedSince(PAGE).c_str());
+    TEST_ASSERT_EQUAL(1, server.not_modified);
+    TEST_ASSERT_EQUAL(3, page->Count());
+    page->Release();
+}
+
+static void test_page_without_validators_is_fetched_in_full(void)
+{
+    server.Serve(PAGE, opml("first", 3));
+    visit()->Release();
+    visit()->Release();
+    TEST_ASSERT_EQUAL(2, server.Gets(PAGE));
+    TEST_ASSERT_EQUAL_STRING("", server.SentEtag(PAGE).c_str());
+    TEST_ASSERT_EQUAL_STRING("", server.SentModifiedSince(PAGE).c_str());
+    TEST_ASSERT_EQUAL(0, server.not_modified);
+}
+
+// what a request was handed, in order
+struct Deliveries
+{
+    client_result results[4];
+    int counts[4];
+    int count;
+};
+
+static void onPage(request_handle, client_result result, UIMenuList *page, void *arg)
+{
+    Deliveries *deliveries = (Deliveries *)arg;
+    if (deliveries->count < 4)
+    {
+        deliveries->results[deliveries->count] = result;
+        deliveries->counts[deliveries->count] = page != NULL ? page->Count() : -1;
+        deliveries->count++;
+    }
+    if (page != NULL)
+        page->Release();
+}
+
+static void wait(Deliveries *deliveries)
+{
+    uint32_t started = millis();
+    while (millis() - started < 1000 && (deliveries->count == 0 || deliveries->results[deliveries->count - 1] == OPML_STALE))
+    {
+        api.Poll();
+        delay(1);
+    }
+}
+
+static void test_stored_page_is_shown_while_revalidated(void)
+{
+    server.Serve(PAGE, opml("first", 3), "\"v1\"");
+    visit()->Release();
+    api.ClearCache();
+
+    // 304: the stored page first, then again as current
+    Deliveries confirmed = {};
+    api.LoadItemsAsync(PAGE, onPage, &confirmed);
+    wait(&confirmed);
+    TEST_ASSERT_EQUAL(2, confirmed.count);
+    TEST_ASSERT_EQUAL(OPML_STALE, confirmed.results[0]);
+    TEST_ASSERT_EQUAL(3, confirmed.counts[0]);
+    TEST_ASSERT_EQUAL(OPML_OK, confirmed.results[1]);
+    TEST_ASSERT_EQUAL(3, confirmed.counts[1]);
+
+    // 200: the stored page first, then the new one
+    server.Serve(PAGE, opml("second", 5), "\"v2\"");
+    api.ClearCache();
+    Deliveries changed = {};
+    api.LoadItemsAsync(PAGE, onPage, &changed);
+    wait(&changed);
+    TEST_ASSERT_EQUAL(2, changed.count);
+    TEST_ASSERT_EQUAL(OPML_STALE, changed.results[0]);
+    TEST_ASSERT_EQUAL(3, changed.counts[0]);
+    TEST_ASSERT_EQUAL(OPML_OK, changed.results[1]);
+    TEST_ASSERT_EQUAL(5, changed.counts[1]);
+}
+
+static void test_page_in_memory_is_revalidated_once_old(void)
+{
+    server.Serve(PAGE, opml("first", 3), "\"v1\"");
+    visit()->Release();
+    // within the time to live it is served from memory
+    api.LoadItems(PAGE)->Release();
+    TEST_ASSERT_EQUAL(1, server.Gets(PAGE));
+
+    // past it: shown, then confirmed by a 304
+    api.SetCacheTtl(50);
+    delay(60);
+    Deliveries confirmed = {};
+    api.LoadItemsAsync(PAGE, onPage, &confirmed);
+    wait(&confirmed);
+    TEST_ASSERT_EQUAL(2, server.Gets(PAGE));
+    TEST_ASSERT_EQUAL_STRING("\"v1\"", server.SentEtag(PAGE).c_str());
+    TEST_ASSERT_EQUAL(1, server.not_modified);
+    TEST_ASSERT_EQUAL(2, confirmed.count);
+    TEST_ASSERT_EQUAL(OPML_STALE, confirmed.results[0]);
+    TEST_ASSERT_EQUAL(3, confirmed.counts[0]);
+    TEST_ASSERT_EQUAL(OPML_OK, confirmed.results[1]);
+    TEST_ASSERT_EQUAL(3, confirmed.counts[1]);
+    // confirmed, it is fresh again
+    api.LoadItems(PAGE)->Release();
+    TEST_ASSERT_EQUAL(2, server.Gets(PAGE));
+
+    // past it again, the page changed meanwhile
+    server.Serve(PAGE, opml("second", 5), "\"v2\"");
+    delay(60);
+    Deliveries changed = {};
+    api.LoadItemsAsync(PAGE, onPage, &changed);
+    wait(&changed);
+    TEST_ASSERT_EQUAL(3, server.Gets(PAGE));
+    TEST_ASSERT_EQUAL(2, changed.count);
+    TEST_ASSERT_EQUAL(OPML_STALE, changed.results[0]);
+    TEST_ASSERT_EQUAL(3, changed.counts[0]);
+    TEST_ASSERT_EQUAL(OPML_OK, changed.results[1]);
+    TEST_ASSERT_EQUAL(5, changed.counts[1]);
+
+    // a caller that waits for the page gets the current one, without the stale one first
+    delay(60);
+    UIMenuList *page = api.LoadItems(PAGE);
+    TEST_ASSERT_EQUAL(4, server.Gets(PAGE));
+    TEST_ASSERT_EQUAL_STRING("\"v2\"", server.SentEtag(PAGE).c_str());
+    TEST_ASSERT_EQUAL(5, page->Count());
+    page->Release();
+    api.SetCacheTtl(API_CACHE_TTL_MS);
+}
+
+int main(int, char **)
+{
+    api.SetTransport(&server);
+    api.SetPrefetchDwell(0);
+    api.StartWorker();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_unchanged_page_is_confirmed_with_its_etag);
+    RUN_TEST(test_changed_page_replaces_the_stored_one);
+    RUN_TEST(test_last_modified_alone_is_enough);
+    RUN_TEST(test_page_without_validators_is_fetched_in_full);
+    RUN_TEST(test_stored_page_is_shown_while_revalidated);
+    RUN_TEST(test_page_in_memory_is_revalidated_once_old);
+    return UNITY_END();
+}
@@ -0,0 +1,302 @@
+/*
+ * OPMLStreamParser against OPMLDocument: the same documents, the corpus and
+ * random ones, fed in random chunks of 1 to 13 bytes, must give the same
+ * elements, depths and attribute values in the same order.
+ */
+
+#include <unity.h>
+#include <tinyopml.h>
+
+#include "../corpus.h"
+
+using namespace tinyopml;
+
+#define RANDOM_DOCUMENTS 500
+#define MAX_CHUNK 13
+
+static uint32_t state = 1;
+
+// xorshift32, the same documents and chunks on every run
+static uint32_t random(uint32_t bound)
+{
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state % bound;
+}
+
+static void logStart(std::string *log, const char *name, int depth)
+{
+    char line[32];
+    snprintf(line, sizeof(line), "<%d ", depth);
+    *log += line;
+    *log += name;
+}
+
+static void logAttribute(std::string *log, const char *name, const char *value, int id)
+{
+    char line[16];
+    snprintf(line, sizeof(line), " #%d ", id);
+    *log += line;
+    *log += name;
+    *log += "=[";
+    *log += value;
+    *log += "]";
+}
+
+static void logEnd(std::string *log, const char *name, int depth)
+{
+    char line[32];
+    snprintf(line, sizeof(line), "\n>%d ", depth);
+    *log += line;
+    *log += name;
+    *log += "\n";
+}
+
+class LogHandler : public OPMLStreamHandler
+{
+public:
+    std::string log;
+
+    bool StartElement(const char *name, const OPMLStreamAttribute *attributes, int count, int depth) override
+    {
+        logStart(&log, name, depth);
+        for (int i = 0; i < count; i++)
+            logAttribute(&log, attributes[i].name, attributes[i].value, attributes[i].id);
+        log += "\n";
+        return true;
+    }
+
+    bool EndElement(const char *name, int depth) override
+    {
+        logEnd(&log, name, depth);
+        return true;
+    }
+};
+
+static void logElement(std::string *log, const OPMLElement *element, int depth)
+{
+    logStart(log, element->Name(), depth);
+    for (const OPMLAttribute *a = element->FirstAttribute(); a != NULL; a = a->Next())
+        logAttribute(log, a->Name(), a->Value(), a->Id());
+    *log += "\n";
+    for (const OPMLElement *child = element->FirstChildElement(); child != NULL; child = child->NextSiblingElement())
+        logElement(log, child, depth + 1);
+    logEnd(log, element->Name(), depth);
+}
+
+static std::string domLog(const std::string &document)
+{
+    OPMLDocument doc;
+    TEST_ASSERT_EQUAL(OPML_SUCCESS, doc.Parse(document.data(), document.size()));
+    std::string log;
+    logElement(&log, doc.RootElement(), 0);
+    return log;
+}
+
+static std::string streamLog(const std::string &document)
+{
+    LogHandler handler;
+    OPMLStreamParser parser(&handler);
+    size_t at = 0;
+    while (at < document.size())
+    {
+        size_t n = 1 + random(MAX_CHUNK);
+        if (n > document.size() - at)
+            n = document.size() - at;
+        TEST_ASSERT_EQUAL(OPML_SUCCESS, parser.Feed(document.data() + at, n));
+        at += n;
+    }
+    TEST_ASSERT_EQUAL(OPML_SUCCESS, parser.Finish());
+    TEST_ASSERT_EQUAL(document.size(), parser.BytesFed());
+    return handler.log;
+}
+
+static const char *const names[] = {"type", "text", "URL", "guide_id", "key", "bitrate", "x-custom", "a", "_b.c"};
+static const char *const values[] = {
+    "", "link", "audio", "Rock &amp; Roll", "&lt;tag&gt;", "caf&#233;", "&#x41;&#66;", "it&apos;s", "&quot;quoted&quot;",
+    "line\nbreak", "crlf\r\nbreak", "lone\rcr", "  spaced  ", "http://opml.radiotime.com/Browse.ashx?id=g61&amp;filter=s",
+    "K\xc3\xb6nigs", "tab\there", "gt > in value"};
+static const char *const fillers[] = {
+    "", "\n", "  ", "\r\n\t", "<!-- a comment > with a bracket -->", "text &amp; more", "<![CDATA[ <outline/> ]]>", "\n<!---->\n"};
+
+static void addElement(std::string *doc, int depth)
+{
+    static const char *const elements[] = {"outline", "outline", "outline", "item", "x:ns"};
+    const char *name = elements[random(5)];
+    *doc += "<";
+    *doc += name;
+    uint32_t count = random(6);
+    bool used[sizeof(names) / sizeof(names[0])] = {false};
+    for (uint32_t i = 0; i < count; i++)
+    {
+        uint32_t n = random(sizeof(names) / sizeof(names[0]));
+        if (used[n])
+            continue;
+        used[n] = true;
+        char quote = random(4) == 0 ? '\'' : '"';
+        const char *value = values[random(sizeof(values) / sizeof(values[0]))];
+        // the other quote may appear as is inside a value
+        std::string v(value);
+        if (quote == '\'' && v.find('\'') != std::string::npos)
+            v = "single";
+        *doc += random(3) == 0 ? "\n  " : " ";
+        *doc += names[n];
+        *doc += random(5) == 0 ? " = " : "=";
+        *doc += quote;
+        *doc += v;
+        *doc += quote;
+    }
+
+    if (depth >= 4 || random(3) != 0)
+    {
+        *doc += random(2) ? "/>" : " />";
+    }
+    else
+    {
+        *doc += ">";
+        uint32_t children = random(4);
+        for (uint32_t i = 0; i < children; i++)
+        {
+            *doc += fillers[random(sizeof(fillers) / sizeof(fillers[0]))];
+            addElement(doc, depth + 1);
+        }
+        *doc += fillers[random(sizeof(fillers) / sizeof(fillers[0]))];
+        *doc += "</";
+        *doc += name;
+        *doc += random(4) == 0 ? " >" : ">";
+    }
+}
+
+static std::string randomDocument()
+{
+    std::string doc;
+    if (random(2))
+        doc += "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n";
+    if (random(4) == 0)
+        doc += "<!-- saved from opml.radiotime.com -->";
+    doc += "<opml version=\"1\">\n<head><title>Browse &amp; more</title><status>200</status></head>\n<body>";
+    uint32_t outlines = random(12);
+    for (uint32_t i = 0; i < outlines; i++)
+    {
+        doc += fillers[random(sizeof(fillers) / sizeof(fillers[0]))];
+        addElement(&doc, 2);
+    }
+    doc += "</body>\n</opml>\n";
+    return doc;
+}
+
+void setUp(void)
+{
+    state = 0x2545f491;
+}
+
+void tearDown(void)
+{
+}
+
+static void test_corpus_in_random_chunks(void)
+{
+    std::vector<CorpusPage> corpus = LoadCorpus();
+    TEST_ASSERT_TRUE_MESSAGE(!corpus.empty(), "test/corpus not found, run from the project directory");
+    for (size_t i = 0; i < corpus.size(); i++)
+        TEST_ASSERT_EQUAL_STRING_MESSAGE(domLog(corpus[i].body).c_str(), streamLog(corpus[i].body).c_str(), corpus[i].id.c_str());
+}
+
+static void test_random_documents_in_random_chunks(void)
+{
+    for (int i = 0; i < RANDOM_DOCUMENTS; i++)
+    {
+        std::string doc = randomDocument();
+        std::string expected = domLog(doc);
+        if (expected != streamLog(doc))
+        {
+            printf("document %d:\n%s\n", i, doc.c_str());
+            TEST_ASSERT_EQUAL_STRING(expected.c_str(), streamLog(doc).c_str());
+        }
+    }
+}
+
+static void test_each_chunk_size_alike(void)
+{
+    std::string doc = randomDocument();
+    while (doc.size() < 2000)
+        doc = randomDocument();
+    std::string expected = domLog(doc);
+    for (size_t chunk = 1; chunk <= MAX_CHUNK; chunk++)
+    {
+        LogHandler handler;
+        OPMLStreamParser parser(&handler);
+        for (size_t at = 0; at < doc.size(); at += chunk)
+            TEST_ASSERT_EQUAL(OPML_SUCCESS, parser.Feed(doc.data() + at, std::min(chunk, doc.size() - at)));
+        TEST_ASSERT_EQUAL(OPML_SUCCESS, parser.Finish());
+        TEST_ASSERT_EQUAL_STRING(expected.c_str(), handler.log.c_str());
+    }
+}
+
+static void test_truncated_document_fails(void)
+{
+    std::string doc = randomDocument();
+    LogHandler handler;
+    OPMLStreamParser parser(&handler);
+    TEST_ASSERT_EQUAL(OPML_SUCCESS, parser.Feed(doc.data(), doc.size() / 2));
+    TEST_ASSERT_TRUE(parser.Finish() != OPML_SUCCESS);
+}
+
+// stops at the element it is given, the parser is left within its tag
+class StopHandler : public LogHandler
+{
+public:
+    int stopAt = 0;
+
+    bool StartElement(const char *name, const OPMLStreamAttribute *attributes, int count, int depth) override
+    {
+        LogHandler::StartElement(name, attributes, count, depth);
+        return --stopAt != 0;
+    }
+};
+
+static void test_reset_after_an_error_or_a_stop(void)
+{
+    std::string doc = randomDocument();
+    while (doc.size() < 500)
+        doc = randomDocument();
+    std::string expected = domLog(doc);
+
+    StopHandler handler;
+    OPMLStreamParser parser(&handler);
+    // fails within an attribute list, with spans taken
+    const char broken[] = "<opml><body><outline type=\"link\" text=\"a\" URL>";
+    TEST_ASSERT_TRUE(parser.Feed(broken, sizeof(broken) - 1) != OPML_SUCCESS);
+    parser.Reset();
+    handler.log.clear();
+    for (size_t at = 0; at < doc.size(); at += MAX_CHUNK)
+        TEST_ASSERT_EQUAL(OPML_SUCCESS, parser.Feed(doc.data() + at, std::min((size_t)MAX_CHUNK, doc.size() - at)));
+    TEST_ASSERT_EQUAL(OPML_SUCCESS, parser.Finish());
+    TEST_ASSERT_EQUAL_STRING(expected.c_str(), handler.log.c_str());
+
+    // stopped on the first element in the body, its attributes taken
+    parser.Reset();
+    handler.log.clear();
+    handler.stopAt = 6;
+    TEST_ASSERT_EQUAL(OPML_SUCCESS, parser.Feed(doc.data(), doc.size() / 2));
+    TEST_ASSERT_EQUAL(0, handler.stopAt);
+    parser.Reset();
+    handler.log.clear();
+    handler.stopAt = 0;
+    for (size_t at = 0; at < doc.size(); at += MAX_CHUNK)
+        TEST_ASSERT_EQUAL(OPML_SUCCESS, parser.Feed(doc.data() + at, std::min((size_t)MAX_CHUNK, doc.size() - at)));
+    TEST_ASSERT_EQUAL(OPML_SUCCESS, parser.Finish());
+    TEST_ASSERT_EQUAL_STRING(expected.c_str(), handler.log.c_str());
+}
+
+int main(int, char **)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_corpus_in_random_chunks);
+    RUN_TEST(test_random_documents_in_random_chunks);
+    RUN_TEST(test_each_chunk_size_alike);
+    RUN_TEST(test_truncated_document_fails);
+    RUN_TEST(test_reset_after_an_error_or_a_stop);
+    return UNITY_END();
+}
@@ -0,0 +1,258 @@
+/*
+ * The word at a time scans of the tokenizer (TINYOPML2_SWAR) against the
+ * byte loops they stand for. The scans are held to the byte loops at every
+ * offset of the corpus. What the parsers make of the corpus, printed DOMs,
+ * stream events and the errors of every truncated page, is digested and
+ * held to the digest taken with TINYOPML2_SWAR at 0, the default, so the
+ * suite passing in both envs means the output is the same byte for byte.
+ * Prints the throughput of the build, to compare:
+ *
+ *     pio test -e native -f test_swar -v
+ *     pio test -e native-swar -f test_swar -v
+ */
+
+#include <unity.h>
+#include <tinyopml.h>
+#include <chrono>
+
+#include "../corpus.h"
+
+using namespace tinyopml;
+
+// FNV-1a of the corpus output with TINYOPML2_SWAR at 0
+#define CORPUS_DIGEST 0xf0d8afb7fea20ccfULL
+#define TRUNCATE_EVERY 211
+#define MAX_CHUNK 13
+#define BENCHMARK_MIN_US 1000000
+
+static std::vector<CorpusPage> corpus;
+static uint32_t state = 1;
+
+// xorshift32, the same chunks on every run
+static uint32_t random(uint32_t bound)
+{
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state % bound;
+}
+
+static uint64_t now_us()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct Digest
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+
+    void Add(const char *p, size_t size)
+    {
+        for (size_t i = 0; i < size; i++)
+            hash = (hash ^ (uint8_t)p[i]) * 0x100000001b3ULL;
+    }
+
+    void Add(const char *s)
+    {
+        Add(s, strlen(s) + 1);
+    }
+
+    void Add(int v)
+    {
+        Add((const char *)&v, sizeof(v));
+    }
+};
+
+class DigestHandler : public OPMLStreamHandler
+{
+public:
+    Digest *digest;
+
+    bool StartElement(const char *name, const OPMLStreamAttribute *attributes, int count, int depth) override
+    {
+        digest->Add(name);
+        digest->Add(depth);
+        for (int i = 0; i < count; i++)
+        {
+            digest->Add(attributes[i].name);
+            digest->Add(attributes[i].value);
+            digest->Add(attributes[i].id);
+        }
+        return true;
+    }
+
+    bool EndElement(const char *name, int depth) override
+    {
+        digest->Add(name);
+        digest->Add(-depth);
+        return true;
+    }
+};
+
+// the document as OPMLDocument prints it, or its error and the line of it
+static void digestDom(Digest *digest, const char *p, size_t size)
+{
+    OPMLDocument doc;
+    OPMLError error = doc.Parse(p, size);
+    digest->Add(error);
+    if (error != OPML_SUCCESS)
+    {
+        digest->Add(doc.ErrorLineNum());
+        return;
+    }
+    OPMLPrinter printer;
+    doc.Print(&printer);
+    digest->Add(printer.CStr(), printer.CStrSize());
+}
+
+// the events of the stream parser fed in random chunks, and how it ended
+static void digestStream(Digest *digest, const char *p, size_t size)
+{
+    DigestHandler handler;
+    handler.digest = digest;
+    OPMLStreamParser parser(&handler);
+    OPMLError error = OPML_SUCCESS;
+    for (size_t at = 0; error == OPML_SUCCESS && at < size;)
+    {
+        size_t n = 1 + random(MAX_CHUNK);
+        if (n > size - at)
+            n = size - at;
+        error = parser.Feed(p + at, n);
+        at += n;
+    }
+    if (error == OPML_SUCCESS)
+        error = parser.Finish();
+    digest->Add(error);
+}
+
+void setUp(void)
+{
+    state = 1;
+}
+
+void tearDown(void)
+{
+}
+
+static void test_find_any_of_is_the_byte_loop(void)
+{
+    for (size_t i = 0; i < corpus.size(); i++)
+    {
+        const char *body = corpus[i].body.c_str();
+        const char *end = body + corpus[i].body.size();
+        for (const char *p = body; p < end; p++)
+        {
+            const char *expected = p;
+            while (expected < end && *expected != '>' && *expected != '"' && *expected != '\'')
+                expected++;
+            TEST_ASSERT_TRUE(OPMLUtil::FindAnyOf(p, end, '>', '"', '\'') == expected);
+            // a short range ends within the word
+            const char *near = (end - p > 5) ? p + 5 : end;
+            const char *found = OPMLUtil::FindAnyOf(p, near, '>', '"', '\'');
+            TEST_ASSERT_TRUE(found == (expected < near ? expected : near));
+        }
+    }
+}
+
+static void test_skip_words_and_white_space_are_the_byte_loops(void)
+{
+    for (size_t i = 0; i < corpus.size(); i++)
+    {
+        std::string copy = corpus[i].body;
+        char *body = &copy[0];
+        for (char *p = body; *p; p++)
+        {
+            // whole words without the end character, a newline or the terminator
+            char *skipped = OPMLUtil::SkipWordsWithout(p, '"', '\n');
+            TEST_ASSERT_TRUE(skipped >= p);
+            TEST_ASSERT_EQUAL(0, (skipped - p) % sizeof(uintptr_t));
+            for (char *q = p; q < skipped; q++)
+                TEST_ASSERT_TRUE(*q != '"' && *q != '\n' && *q != 0);
+
+            int line = 0;
+            int expected_line = 0;
+            const char *expected = p;
+            while (OPMLUtil::IsWhiteSpace(*expected))
+            {
+                if (*expected == '\n')
+                    expected_line++;
+                expected++;
+            }
+            TEST_ASSERT_TRUE(OPMLUtil::SkipWhiteSpace(p, &line) == expected);
+            TEST_ASSERT_EQUAL(expected_line, line);
+        }
+    }
+}
+
+static void test_corpus_output_is_the_scalar_one(void)
+{
+    Digest digest;
+    for (size_t i = 0; i < corpus.size(); i++)
+    {
+        const std::string &body = corpus[i].body;
+        digestDom(&digest, body.data(), body.size());
+        digestStream(&digest, body.data(), body.size());
+        // cut anywhere, in a name, a value, between tags
+        for (size_t cut = 1; cut < body.size(); cut += TRUNCATE_EVERY)
+        {
+            digestDom(&digest, body.data(), cut);
+            digestStream(&digest, body.data(), cut);
+        }
+    }
+    printf("TINYOPML2_SWAR=%d: corpus digest 0x%016llx\n", TINYOPML2_SWAR, (unsigned long long)digest.hash);
+    TEST_ASSERT_TRUE(digest.hash == CORPUS_DIGEST);
+}
+
+static void test_throughput(void)
+{
+    size_t bytes = 0;
+    for (size_t i = 0; i < corpus.size(); i++)
+        bytes += corpus[i].body.size();
+
+    // the best round rather than the mean, the host shares its cores
+    double mb_per_s[2];
+    for (int stream = 0; stream < 2; stream++)
+    {
+        uint64_t started = now_us();
+        uint64_t best = UINT64_MAX;
+        uint64_t round;
+        do
+        {
+            round = now_us();
+            for (size_t i = 0; i < corpus.size(); i++)
+            {
+                const std::string &body = corpus[i].body;
+                if (stream)
+                {
+                    OPMLStreamHandler ignore;
+                    OPMLStreamParser parser(&ignore);
+                    for (size_t at = 0; at < body.size(); at += 1460)
+                        parser.Feed(body.data() + at, std::min((size_t)1460, body.size() - at));
+                    parser.Finish();
+                }
+                else
+                {
+                    OPMLDocument doc;
+                    doc.Parse(body.data(), body.size());
+                }
+            }
+            round = now_us() - round;
+            if (round < best)
+                best = round;
+        } while (now_us() - started < BENCHMARK_MIN_US);
+        mb_per_s[stream] = (double)bytes / best;
+    }
+    printf("TINYOPML2_SWAR=%d: dom %.1f MB/s, stream %.1f MB/s over %u bytes\n", TINYOPML2_SWAR, mb_per_s[0], mb_per_s[1],
+           (unsigned)bytes);
+}
+
+int main(int, char **)
+{
+    corpus = LoadCorpus();
+    UNITY_BEGIN();
+    RUN_TEST(test_find_any_of_is_the_byte_loop);
+    RUN_TEST(test_skip_words_and_white_space_are_the_byte_loops);
+    RUN_TEST(test_corpus_output_is_the_scalar_one);
+    RUN_TEST(test_throughput);
+    return UNITY_END();
+}